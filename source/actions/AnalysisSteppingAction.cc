@@ -67,8 +67,8 @@ void AnalysisSteppingAction::UserSteppingAction(const G4Step* step)
   */
 
   // Retrieve the pointer to the optical boundary process.
-  // We do this only once per run defining our local pointer as static.
-  static G4OpBoundaryProcess* boundary = 0;
+  // We do this only once per thread defining our local pointer as static.
+  static G4ThreadLocal G4OpBoundaryProcess* boundary = 0;
 
   if (!boundary) { // the pointer is not defined yet
     // Get the list of processes defined for the optical photon
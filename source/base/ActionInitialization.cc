@@ -0,0 +1,102 @@
+// ----------------------------------------------------------------------------
+// nexus | ActionInitialization.cc
+//
+// This class creates the primary generator and the user actions chosen
+// by the user, once for every thread that processes events.
+//
+// The NEXT Collaboration
+// ----------------------------------------------------------------------------
+
+#include "ActionInitialization.h"
+
+#include "GeneratorFactory.h"
+#include "ActionsFactory.h"
+#include "PrimaryGeneration.h"
+#include "PersistencyManager.h"
+
+#include <G4UImanager.hh>
+#include <G4Threading.hh>
+#include <G4VPrimaryGenerator.hh>
+#include <G4UserRunAction.hh>
+#include <G4UserEventAction.hh>
+#include <G4UserStackingAction.hh>
+#include <G4UserTrackingAction.hh>
+#include <G4UserSteppingAction.hh>
+
+using namespace nexus;
+
+
+
+ActionInitialization::ActionInitialization(GeneratorFactory* genfctr,
+                                           ActionsFactory* actfctr):
+  G4VUserActionInitialization(), genfctr_(genfctr), actfctr_(actfctr),
+  master_generator_(0), master_evtact_(0), master_stkact_(0),
+  master_trkact_(0), master_stpact_(0)
+{
+  // The registration commands exist only in the thread that executed
+  // the configuration macro, so they are looked up once here
+  G4UImanager* UI = G4UImanager::GetUIpointer();
+
+  run_action_      = UI->GetCurrentValues("/Actions/RegisterRunAction") != "";
+  event_action_    = UI->GetCurrentValues("/Actions/RegisterEventAction") != "";
+  stacking_action_ = UI->GetCurrentValues("/Actions/RegisterStackingAction") != "";
+  tracking_action_ = UI->GetCurrentValues("/Actions/RegisterTrackingAction") != "";
+  stepping_action_ = UI->GetCurrentValues("/Actions/RegisterSteppingAction") != "";
+}
+
+
+
+ActionInitialization::~ActionInitialization()
+{
+  delete master_generator_;
+  delete master_evtact_;
+  delete master_stkact_;
+  delete master_trkact_;
+  delete master_stpact_;
+}
+
+
+
+void ActionInitialization::BuildForMaster() const
+{
+  if (run_action_)
+    SetUserAction(actfctr_->CreateRunAction());
+
+  // The master thread executes the configuration macros before the
+  // workers replay them, so the commands of the generator and actions
+  // must be defined there as well. These instances process no events.
+  master_generator_ = genfctr_->CreateGenerator();
+  if (event_action_)    master_evtact_ = actfctr_->CreateEventAction();
+  if (stacking_action_) master_stkact_ = actfctr_->CreateStackingAction();
+  if (tracking_action_) master_trkact_ = actfctr_->CreateTrackingAction();
+  if (stepping_action_) master_stpact_ = actfctr_->CreateSteppingAction();
+}
+
+
+
+void ActionInitialization::Build() const
+{
+  // Worker threads store their events through their own
+  // persistency manager, which is needed by some of the actions
+  if (G4Threading::IsWorkerThread())
+    PersistencyManager::InitializeWorker();
+
+  PrimaryGeneration* pg = new PrimaryGeneration();
+  pg->SetGenerator(genfctr_->CreateGenerator());
+  SetUserAction(pg);
+
+  if (run_action_)
+    SetUserAction(actfctr_->CreateRunAction());
+
+  if (event_action_)
+    SetUserAction(actfctr_->CreateEventAction());
+
+  if (stacking_action_)
+    SetUserAction(actfctr_->CreateStackingAction());
+
+  if (tracking_action_)
+    SetUserAction(actfctr_->CreateTrackingAction());
+
+  if (stepping_action_)
+    SetUserAction(actfctr_->CreateSteppingAction());
+}
@@ -0,0 +1,65 @@
+// ----------------------------------------------------------------------------
+// nexus | ActionInitialization.h
+//
+// This class creates the primary generator and the user actions chosen
+// by the user, once for every thread that processes events.
+//
+// The NEXT Collaboration
+// ----------------------------------------------------------------------------
+
+#ifndef ACTION_INITIALIZATION_H
+#define ACTION_INITIALIZATION_H
+
+#include <G4VUserActionInitialization.hh>
+
+class G4VPrimaryGenerator;
+class G4UserEventAction;
+class G4UserStackingAction;
+class G4UserTrackingAction;
+class G4UserSteppingAction;
+
+
+namespace nexus {
+
+  class GeneratorFactory;
+  class ActionsFactory;
+
+  /// Builds the primary generation and user actions with the factories.
+  /// In sequential mode, Build() is invoked once, for the only thread.
+  /// In multithreaded mode, it is invoked in every worker thread, and
+  /// BuildForMaster() in the master thread.
+
+  class ActionInitialization: public G4VUserActionInitialization
+  {
+  public:
+    /// Constructor. The actions registered by the user (in the
+    /// configuration macro already executed) are checked here.
+    ActionInitialization(GeneratorFactory*, ActionsFactory*);
+    /// Destructor
+    ~ActionInitialization();
+
+    /// Set the run action of the master thread
+    void BuildForMaster() const;
+
+    /// Set the generator and the user actions of the calling thread
+    void Build() const;
+
+  private:
+    GeneratorFactory* genfctr_;
+    ActionsFactory* actfctr_;
+
+    G4bool run_action_, event_action_, stacking_action_,
+      tracking_action_, stepping_action_; ///< Actions registered by the user
+
+    // Instances built in the master thread, which processes no events,
+    // only so that their configuration commands are defined there too
+    mutable G4VPrimaryGenerator* master_generator_;
+    mutable G4UserEventAction* master_evtact_;
+    mutable G4UserStackingAction* master_stkact_;
+    mutable G4UserTrackingAction* master_trkact_;
+    mutable G4UserSteppingAction* master_stpact_;
+  };
+
+} // end namespace nexus
+
+#endif
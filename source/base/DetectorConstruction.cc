@@ -16,6 +16,12 @@
 #include <G4LogicalVolume.hh>
 #include <G4VisAttributes.hh>
 #include <G4PVPlacement.hh>
+#include <G4LogicalVolumeStore.hh>
+#include <G4VSensitiveDetector.hh>
+#include <G4SDManager.hh>
+#include <G4Threading.hh>
+
+#include <map>
 
 
 using namespace nexus;
@@ -73,5 +79,36 @@ G4VPhysicalVolume* DetectorConstruction::Construct()
   new G4PVPlacement(0, G4ThreeVector(0,0,0),
 		    geometry_logic, geometry_logic->GetName(), world_logic, false, 0);
 
+  // Remember which volumes were made sensitive, and by which sensitive
+  // detector, so that worker threads can attach their own copies
+  sensdets_.clear();
+  G4LogicalVolumeStore* lvstore = G4LogicalVolumeStore::GetInstance();
+  for (size_t i=0; i<lvstore->size(); i++) {
+    G4LogicalVolume* lv = (*lvstore)[i];
+    if (lv->GetSensitiveDetector())
+      sensdets_.push_back(std::make_pair(lv, lv->GetSensitiveDetector()));
+  }
+
   return world_physi;
 }
+
+
+
+void DetectorConstruction::ConstructSDandField()
+{
+  // The master thread (or the only one, in sequential mode) already
+  // has the sensitive detectors created by the geometry
+  if (!G4Threading::IsWorkerThread()) return;
+
+  // Sensitive detectors shared by several volumes are cloned only once
+  std::map<G4VSensitiveDetector*, G4VSensitiveDetector*> clones;
+
+  for (size_t i=0; i<sensdets_.size(); i++) {
+    G4VSensitiveDetector*& clone = clones[sensdets_[i].second];
+    if (!clone) {
+      clone = sensdets_[i].second->Clone();
+      G4SDManager::GetSDMpointer()->AddNewDetector(clone);
+    }
+    SetSensitiveDetector(sensdets_[i].first, clone);
+  }
+}
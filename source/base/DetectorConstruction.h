@@ -10,8 +10,12 @@
 #define DETECTOR_CONSTRUCTION_H
 
 #include <G4VUserDetectorConstruction.hh>
+#include <vector>
+#include <utility>
 
 class G4GenericMessenger;
+class G4LogicalVolume;
+class G4VSensitiveDetector;
 
 
 namespace nexus {
@@ -30,6 +34,11 @@ namespace nexus {
     /// It returns the physical volume that represents the world.
     virtual G4VPhysicalVolume* Construct();
 
+    /// Invoked by the run manager in every thread after the geometry
+    /// is built. Worker threads get here their own copies of the
+    /// sensitive detectors attached by the geometry in Construct().
+    virtual void ConstructSDandField();
+
     /// Set a detector geometry
     void SetGeometry(BaseGeometry*);
     /// Get the detector geometry
@@ -37,6 +46,9 @@ namespace nexus {
 
   private:
     BaseGeometry* geometry_;
+
+    /// Sensitive detectors attached to the logical volumes by the geometry
+    std::vector<std::pair<G4LogicalVolume*, G4VSensitiveDetector*> > sensdets_;
   };
 
 
@@ -1,9 +1,10 @@
 // ----------------------------------------------------------------------------
 // nexus | NexusApp.cc
 //
-// This class is the run manager of the nexus simulation. It takes care of
-// setting up the simulation (geometry, physics lists, generators, actions),
-// so that it is ready to be run.
+// This class is the application of the nexus simulation. It creates the
+// run manager, sequential or multithreaded, and takes care of setting up
+// the simulation (geometry, physics lists, generators, actions), so that
+// it is ready to be run.
 //
 // The NEXT Collaboration
 // ----------------------------------------------------------------------------
@@ -14,20 +15,65 @@
 #include "GeneratorFactory.h"
 #include "ActionsFactory.h"
 #include "DetectorConstruction.h"
-#include "PrimaryGeneration.h"
+#include "ActionInitialization.h"
 #include "PersistencyManager.h"
 #include "BatchSession.h"
+#include "RandomUtils.h"
 
+#include <G4RunManager.hh>
 #include <G4GenericPhysicsList.hh>
 #include <G4UImanager.hh>
 #include <G4StateManager.hh>
+#include <G4Event.hh>
+
+#include <algorithm>
+#include <iostream>
+#include <cstdio>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#ifdef G4MULTITHREADED
+#include <G4MTRunManager.hh>
+#endif
 
 using namespace nexus;
 
 
+NexusApp* NexusApp::instance_ = 0;
+
+
 
-NexusApp::NexusApp(G4String init_macro): G4RunManager()
+NexusApp::NexusApp(G4String init_macro, G4int nthreads, G4int nprocesses):
+  msg_(0), seed_(0), event_seeding_(false),
+  runmgr_(0), nprocesses_(nprocesses), genfctr_(0), actfctr_(0)
 {
+  instance_ = this;
+
+  // Forked processes cannot share a multithreaded run manager
+  if (nprocesses_ > 1 && nthreads > 0) {
+    G4Exception("[NexusApp]", "NexusApp()", JustWarning,
+                "Threads cannot be combined with processes. "
+                "Every process will run sequentially.");
+    nthreads = 0;
+  }
+
+  // The run manager is created first, since in multithreaded mode it
+  // sets up the UI manager of the master thread to record the commands
+  // that the worker threads will replay
+#ifdef G4MULTITHREADED
+  if (nthreads > 0) {
+    G4MTRunManager* mtrunmgr = new G4MTRunManager();
+    mtrunmgr->SetNumberOfThreads(nthreads);
+    runmgr_ = mtrunmgr;
+  }
+#else
+  if (nthreads > 0)
+    G4Exception("[NexusApp]", "NexusApp()", JustWarning,
+                "Geant4 was built without multithreading support. "
+                "Events will be processed sequentially.");
+#endif
+  if (!runmgr_) runmgr_ = new G4RunManager();
+
   // Create and configure a generic messenger for the app
   msg_ = new G4GenericMessenger(this, "/nexus/", "Nexus control commands.");
 
@@ -45,6 +91,13 @@ NexusApp::NexusApp(G4String init_macro): G4RunManager()
   msg_->DeclareMethod("random_seed", &NexusApp::SetRandomSeed,
                       "Set a seed for the random number generator.");
 
+  // Define a command to derive the random state of every event from
+  // the seed and the absolute event number (the event ID in the run
+  // plus /nexus/persistency/start_id), instead of from the previous events
+  msg_->DeclareProperty("event_seeding", event_seeding_,
+                        "Reseed the random number generator at the start of "
+                        "every event from the seed and the event number.");
+
   /////////////////////////////////////////////////////////
 
   // We will set now the user initialization class instances
@@ -53,50 +106,37 @@ NexusApp::NexusApp(G4String init_macro): G4RunManager()
   // to user's input) so that the messenger commands are already defined
   // by the time we process the initialization macro.
 
+  // The generator and action factories are kept, since in multithreaded
+  // mode every worker thread builds its own instances with them.
+
   GeometryFactory  geomfctr;
-  GeneratorFactory genfctr;
-  ActionsFactory   actfctr;
+  genfctr_ = new GeneratorFactory();
+  actfctr_ = new ActionsFactory();
 
   // The physics lists are handled with Geant4's own 'factory'
-  physicsList = new G4GenericPhysicsList();
+  G4GenericPhysicsList* physicsList = new G4GenericPhysicsList();
 
   BatchSession* batch = new BatchSession(init_macro.c_str());
   batch->SessionStart();
 
   // Set the physics list in the run manager
-  this->SetUserInitialization(physicsList);
+  runmgr_->SetUserInitialization(physicsList);
 
   // Set the detector construction instance in the run manager
   DetectorConstruction* dc = new DetectorConstruction();
   dc->SetGeometry(geomfctr.CreateGeometry());
-  this->SetUserInitialization(dc);
-
-  // Set the primary generation instance in the run manager
-  PrimaryGeneration* pg = new PrimaryGeneration();
-  pg->SetGenerator(genfctr.CreateGenerator());
-  this->SetUserAction(pg);
-
-  // User interface
-  G4UImanager* UI = G4UImanager::GetUIpointer();
+  runmgr_->SetUserInitialization(dc);
 
   PersistencyManager::Initialize(init_macro, macros_, delayed_);
 
-  // Set the user action instances, if any, in the run manager
-
-  if (UI->GetCurrentValues("/Actions/RegisterRunAction") != "")
-    this->SetUserAction(actfctr.CreateRunAction());
-
-  if (UI->GetCurrentValues("/Actions/RegisterEventAction") != "")
-    this->SetUserAction(actfctr.CreateEventAction());
-
-  if (UI->GetCurrentValues("/Actions/RegisterStackingAction") != "")
-    this->SetUserAction(actfctr.CreateStackingAction());
-
-  if (UI->GetCurrentValues("/Actions/RegisterTrackingAction") != "")
-    this->SetUserAction(actfctr.CreateTrackingAction());
+  // The output file is opened by every process, once they are forked
+  PersistencyManager* pm = dynamic_cast<PersistencyManager*>
+    (G4VPersistencyManager::GetPersistencyManager());
+  pm->SetProcesses(nprocesses_);
 
-  if (UI->GetCurrentValues("/Actions/RegisterSteppingAction") != "")
-    this->SetUserAction(actfctr.CreateSteppingAction());
+  // Set the primary generation and the user actions, if any,
+  // of every thread in the run manager
+  runmgr_->SetUserInitialization(new ActionInitialization(genfctr_, actfctr_));
 
   /////////////////////////////////////////////////////////
 
@@ -115,7 +155,12 @@ NexusApp::~NexusApp()
     (G4VPersistencyManager::GetPersistencyManager());
   current->CloseFile();
 
+  delete runmgr_;
+  delete genfctr_;
+  delete actfctr_;
   delete msg_;
+
+  instance_ = 0;
 }
 
 
@@ -146,7 +191,7 @@ void NexusApp::Initialize()
     ExecuteMacroFile(macros_[i].data());
   }
 
-  G4RunManager::Initialize();
+  runmgr_->Initialize();
 
   for (unsigned int j=0; j<delayed_.size(); j++) {
     ExecuteMacroFile(delayed_[j].data());
@@ -155,6 +200,88 @@ void NexusApp::Initialize()
 
 
 
+void NexusApp::BeamOn(G4int nevents)
+{
+  if (nprocesses_ > 1)
+    BeamOnProcesses(nevents);
+  else
+    runmgr_->BeamOn(nevents);
+}
+
+
+
+void NexusApp::BeamOnProcesses(G4int nevents)
+{
+  // A run with no events builds the physics tables,
+  // which the processes then inherit instead of building them again
+  runmgr_->BeamOn(0);
+
+  PersistencyManager* pm = dynamic_cast<PersistencyManager*>
+    (G4VPersistencyManager::GetPersistencyManager());
+
+  G4int nprocesses = std::max(1, std::min(nprocesses_, nevents));
+  pm->SetProcesses(nprocesses);
+
+  // Anything buffered would otherwise be printed by every process
+  std::cout.flush();
+  G4cout.flush();
+  fflush(stdout);
+
+  std::vector<pid_t> pids;
+  for (G4int i=0; i<nprocesses; i++) {
+    // Every process gets a consecutive slice of the events
+    G4int first = (G4long) nevents * i / nprocesses;
+    G4int count = (G4long) nevents * (i+1) / nprocesses - first;
+
+    pid_t pid = fork();
+    if (pid < 0) {
+      G4Exception("[NexusApp]", "BeamOnProcesses()", FatalException,
+                  "Cannot fork a new process.");
+    }
+    else if (pid == 0) {
+      // Processes get different random sequences, unless every event
+      // is reseeded anyway from its absolute number
+      long seeds[3];
+      EventSeeds(seed_, -1 - i, seeds);
+      CLHEP::HepRandom::setTheSeeds(seeds);
+
+      pm->OpenProcessFile(i, first);
+      runmgr_->BeamOn(count);
+      pm->CloseFile();
+
+      // Leave without running the destructors of the parent's objects
+      std::cout.flush();
+      G4cout.flush();
+      fflush(stdout);
+      _exit(EXIT_SUCCESS);
+    }
+    pids.push_back(pid);
+  }
+
+  G4bool failed = false;
+  for (unsigned int i=0; i<pids.size(); i++) {
+    int status;
+    if (waitpid(pids[i], &status, 0) < 0 ||
+        !WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS)
+      failed = true;
+  }
+
+  if (failed)
+    G4Exception("[NexusApp]", "BeamOnProcesses()", FatalException,
+                "A process failed. Its output is kept unmerged.");
+
+  pm->MergeProcessFiles();
+}
+
+
+
+G4int NexusApp::GetNumberOfEventsToBeProcessed() const
+{
+  return runmgr_->GetNumberOfEventsToBeProcessed();
+}
+
+
+
 void NexusApp::ExecuteMacroFile(const char* filename)
 {
   G4UImanager* UI = G4UImanager::GetUIpointer();
@@ -172,6 +299,21 @@ void NexusApp::SetRandomSeed(G4int seed)
   // Set the seed chosen by the user for the pseudo-random number
   // generator unless a negative number was provided, in which case
   // we will set as seed the system time.
-  if (seed < 0) CLHEP::HepRandom::setTheSeed(time(0));
-  else CLHEP::HepRandom::setTheSeed(seed);
+  seed_ = (seed < 0) ? time(0) : seed;
+  CLHEP::HepRandom::setTheSeed(seed_);
+}
+
+
+
+void NexusApp::SeedEvent(const G4Event* event) const
+{
+  if (!event_seeding_) return;
+
+  PersistencyManager* pm = dynamic_cast<PersistencyManager*>
+    (G4VPersistencyManager::GetPersistencyManager());
+  G4long number = event->GetEventID() + (pm ? pm->GetStartID() : 0);
+
+  long seeds[3];
+  EventSeeds(seed_, number, seeds);
+  CLHEP::HepRandom::setTheSeeds(seeds);
 }
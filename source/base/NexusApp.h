@@ -1,9 +1,10 @@
 // ----------------------------------------------------------------------------
 // nexus | NexusApp.h
 //
-// This class is the run manager of the nexus simulation. It takes care of
-// setting up the simulation (geometry, physics lists, generators, actions),
-// so that it is ready to be run.
+// This class is the application of the nexus simulation. It creates the
+// run manager, sequential or multithreaded, and takes care of setting up
+// the simulation (geometry, physics lists, generators, actions), so that
+// it is ready to be run.
 //
 // The NEXT Collaboration
 // ----------------------------------------------------------------------------
@@ -11,9 +12,12 @@
 #ifndef NEXUS_APP_H
 #define NEXUS_APP_H
 
-#include <G4RunManager.hh>
+#include <G4String.hh>
+#include <vector>
 
 class G4GenericMessenger;
+class G4RunManager;
+class G4Event;
 
 
 namespace nexus {
@@ -23,21 +27,43 @@ namespace nexus {
   class ActionsFactory;
 
 
-  /// TODO. CLASS DESCRIPTION
+  /// Sets up the simulation on a run manager. With nthreads > 0, events
+  /// are processed by that number of worker threads, which share the
+  /// geometry and physics tables built once by the master thread.
+  /// With nprocesses > 1, the events are split instead among that number
+  /// of processes forked once the physics tables are built, each writing
+  /// its own output file, and the files are merged at the end.
 
-  class NexusApp: public G4RunManager
+  class NexusApp
   {
   public:
     /// Constructor
-    NexusApp(G4String init_macro);
+    NexusApp(G4String init_macro, G4int nthreads=0, G4int nprocesses=1);
     /// Destructor
     ~NexusApp();
 
-    virtual void Initialize();
+    /// Return the application, or null if none was created
+    static NexusApp* GetInstance();
+
+    void Initialize();
+
+    /// Process the given number of events
+    void BeamOn(G4int nevents);
 
     /// Returns the number of events to be processed in the current run
     G4int GetNumberOfEventsToBeProcessed() const;
 
+    /// Returns the seed of the random number generator
+    G4long GetRandomSeed() const;
+    /// Is the random engine reseeded at the start of every event?
+    G4bool GetEventSeeding() const;
+
+    /// With event seeding, reseed the random engine of the calling
+    /// thread from the seed of the run and the absolute number of the
+    /// event, so that the event is the same whatever thread or job
+    /// simulates it, and whatever events were simulated before
+    void SeedEvent(const G4Event*) const;
+
   private:
     void RegisterMacro(G4String);
 
@@ -45,6 +71,9 @@ namespace nexus {
 
     void ExecuteMacroFile(const char*);
 
+    /// Split the events among forked processes and merge their output
+    void BeamOnProcesses(G4int nevents);
+
     /// Set a seed for the G4 random number generator.
     /// If a negative value is chosen, the system time is set as seed.
     void SetRandomSeed(G4int);
@@ -54,12 +83,24 @@ namespace nexus {
     std::vector<G4String> macros_;
     std::vector<G4String> delayed_;
 
+    G4long seed_;          ///< Seed of the random number generator
+    G4bool event_seeding_; ///< Reseed the random engine every event?
+
+    G4RunManager* runmgr_; ///< Sequential or multithreaded run manager
+    G4int nprocesses_;     ///< Number of processes the events are split into
+    GeneratorFactory* genfctr_;
+    ActionsFactory* actfctr_;
+
+    static NexusApp* instance_;
   };
 
   // INLINE DEFINITIONS ////////////////////////////////////
 
-  inline G4int NexusApp::GetNumberOfEventsToBeProcessed() const
-  { return numberOfEventToBeProcessed; }
+  inline NexusApp* NexusApp::GetInstance() { return instance_; }
+
+  inline G4long NexusApp::GetRandomSeed() const { return seed_; }
+
+  inline G4bool NexusApp::GetEventSeeding() const { return event_seeding_; }
 
 } // namespace nexus
 
@@ -9,6 +9,8 @@
 
 #include "PrimaryGeneration.h"
 
+#include "NexusApp.h"
+
 #include <G4VPrimaryGenerator.hh>
 #include <G4Event.hh>
 
@@ -36,5 +38,9 @@ void PrimaryGeneration::GeneratePrimaries(G4Event* event)
     G4Exception("[PrimaryGeneration]", "GeneratePrimaries()",
                 FatalException, "Generator not set!");
 
+  // The primaries are the first random numbers drawn in the event
+  NexusApp* app = NexusApp::GetInstance();
+  if (app) app->SeedEvent(event);
+
   generator_->GeneratePrimaryVertex(event);
 }
@@ -20,7 +20,7 @@
 using namespace nexus;
 
 
-G4Allocator<Trajectory> TrjAllocator;
+G4ThreadLocal G4Allocator<Trajectory>* TrjAllocator = 0;
 
 
 Trajectory::Trajectory(const G4Track* track):
@@ -53,7 +53,7 @@ namespace nexus {
     G4int GetPDGEncoding () const;
 
     // Return name of the track creator process
-    G4String GetCreatorProcess() const;
+    const G4String& GetCreatorProcess() const;
 
     /// Return id number of the associated track
     G4int GetTrackID() const;
@@ -84,13 +84,13 @@ namespace nexus {
     G4double GetEnergyDeposit() const;
     void SetEnergyDeposit(G4double);
 
-    G4String GetInitialVolume() const;
+    const G4String& GetInitialVolume() const;
 
-    G4String GetFinalVolume() const;
+    const G4String& GetFinalVolume() const;
     void SetFinalVolume(G4String);
 
     // Return name of the track killer process
-    G4String GetFinalProcess() const;
+    const G4String& GetFinalProcess() const;
     void SetFinalProcess(G4String);
 
 
@@ -149,19 +149,22 @@ namespace nexus {
 
 
 #if defined G4TRACKING_ALLOC_EXPORT
-extern G4DLLEXPORT G4Allocator<nexus::Trajectory> TrjAllocator;
+extern G4DLLEXPORT G4ThreadLocal G4Allocator<nexus::Trajectory>* TrjAllocator;
 #else
-extern G4DLLIMPORT G4Allocator<nexus::Trajectory> TrjAllocator;
+extern G4DLLIMPORT G4ThreadLocal G4Allocator<nexus::Trajectory>* TrjAllocator;
 #endif
 
 
 // INLINE DEFINITIONS //////////////////////////////////////////////
 
 inline void* nexus::Trajectory::operator new(size_t)
-{ return ((void*) TrjAllocator.MallocSingle()); }
+{
+  if (!TrjAllocator) TrjAllocator = new G4Allocator<nexus::Trajectory>;
+  return ((void*) TrjAllocator->MallocSingle());
+}
 
 inline void nexus::Trajectory::operator delete(void* trj)
-{ TrjAllocator.FreeSingle((nexus::Trajectory*) trj); }
+{ TrjAllocator->FreeSingle((nexus::Trajectory*) trj); }
 
 inline G4ParticleDefinition* nexus::Trajectory::GetParticleDefinition()
 { return pdef_; }
@@ -213,19 +216,19 @@ inline G4double nexus::Trajectory::GetEnergyDeposit() const { return edep_; }
 
 inline void nexus::Trajectory::SetEnergyDeposit(G4double e) { edep_ = e; }
 
-inline G4String nexus::Trajectory::GetCreatorProcess() const
+inline const G4String& nexus::Trajectory::GetCreatorProcess() const
 { return creator_process_; }
 
-inline G4String nexus::Trajectory::GetFinalProcess() const
+inline const G4String& nexus::Trajectory::GetFinalProcess() const
 { return final_process_; }
 
 inline void nexus::Trajectory::SetFinalProcess(G4String fp)
 { final_process_ = fp; }
 
-inline G4String nexus::Trajectory::GetInitialVolume() const
+inline const G4String& nexus::Trajectory::GetInitialVolume() const
 { return initial_volume_; }
 
-inline G4String nexus::Trajectory::GetFinalVolume() const
+inline const G4String& nexus::Trajectory::GetFinalVolume() const
 { return final_volume_; }
 
 inline void nexus::Trajectory::SetFinalVolume(G4String fv)
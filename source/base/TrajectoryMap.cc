@@ -1,7 +1,8 @@
 // ----------------------------------------------------------------------------
 // nexus | TrajectoryMap.cc
 //
-// This class is a container of particle trajectories.
+// This class is a container of particle trajectories. Every thread
+// has its own map, holding the trajectories of the event it processes.
 //
 // The NEXT Collaboration
 // ----------------------------------------------------------------------------
@@ -11,7 +12,7 @@
 #include <G4VTrajectory.hh>
 
 
-std::map<int, G4VTrajectory*> nexus::TrajectoryMap::map_;
+G4ThreadLocal std::map<int, G4VTrajectory*>* nexus::TrajectoryMap::map_ = 0;
 
 
 namespace nexus {
@@ -24,22 +25,30 @@ namespace nexus {
 
   TrajectoryMap::~TrajectoryMap()
   {
-    map_.clear();
+    Map().clear();
+  }
+
+
+
+  std::map<int, G4VTrajectory*>& TrajectoryMap::Map()
+  {
+    if (!map_) map_ = new std::map<int, G4VTrajectory*>;
+    return *map_;
   }
 
 
 
   void TrajectoryMap::Clear()
   {
-    map_.clear();
+    Map().clear();
   }
 
 
 
   G4VTrajectory* TrajectoryMap::Get(int trackId)
   {
-    std::map<int, G4VTrajectory*>::iterator it = map_.find(trackId);
-    if (it == map_.end()) return 0;
+    std::map<int, G4VTrajectory*>::iterator it = Map().find(trackId);
+    if (it == Map().end()) return 0;
     else return it->second;
   }
 
@@ -47,7 +56,7 @@ namespace nexus {
 
   void TrajectoryMap::Add(G4VTrajectory* trj)
   {
-    map_[trj->GetTrackID()] = trj;
+    Map()[trj->GetTrackID()] = trj;
   }
 
 } // namespace nexus
@@ -1,7 +1,8 @@
 // ----------------------------------------------------------------------------
 // nexus | TrajectoryMap.h
 //
-// This class is a container of particle trajectories.
+// This class is a container of particle trajectories. Every thread
+// has its own map, holding the trajectories of the event it processes.
 //
 // The NEXT Collaboration
 // ----------------------------------------------------------------------------
@@ -9,6 +10,7 @@
 #ifndef TRAJECTORY_MAP_H
 #define TRAJECTORY_MAP_H
 
+#include <G4Types.hh>
 #include <map>
 
 class G4VTrajectory;
@@ -33,8 +35,11 @@ namespace nexus {
     TrajectoryMap(const TrajectoryMap&);
     ~TrajectoryMap();
 
+    /// Return the map of the calling thread
+    static std::map<int, G4VTrajectory*>& Map();
+
   private:
-    static std::map<int, G4VTrajectory*> map_;
+    static G4ThreadLocal std::map<int, G4VTrajectory*>* map_;
   };
 
 } // namespace nexus
@@ -0,0 +1,323 @@
+// ----------------------------------------------------------------------------
+// nexus | nexus-eltable.cc
+//
+// This program converts EL lookup tables to the binary table format.
+//
+// The NEXT Collaboration
+// ----------------------------------------------------------------------------
+
+#include "ELTableFile.h"
+#include "hdf5_functions.h"
+
+#include <hdf5.h>
+
+#include <algorithm>
+#include <iostream>
+#include <fstream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <getopt.h>
+
+using namespace nexus;
+
+
+
+void PrintUsage()
+{
+  std::cerr << "\nUsage: ./nexus-eltable [-r radius] [-b binning] [-l list] "
+            << "-o <output> <input> ...\n" << std::endl;
+  std::cerr << "Converts an EL lookup table in the text format, or the nexus h5\n"
+            << "files of a table production (one file per point of the EL gap),\n"
+            << "to the binary table format.\n" << std::endl;
+  std::cerr << "Available options:" << std::endl;
+  std::cerr << "   -o, --output          : Binary table\n"
+            << "   -r, --radius          : Radius of the circle of points, "
+            << "in mm (default: 92.5)\n"
+            << "   -b, --binning         : Size of the bins of the grid of "
+            << "points, in mm (default: 5)\n"
+            << "   -l, --list            : File with the names of the input "
+            << "files, one per line"
+            << std::endl;
+  exit(EXIT_FAILURE);
+}
+
+
+
+/// Value of the first configuration entry whose key ends with the
+/// given suffix, or an empty string
+std::string FindSetting(const std::map<std::string, std::string>& config,
+                        const std::string& suffix)
+{
+  std::map<std::string, std::string>::const_iterator it;
+  for (it = config.begin(); it != config.end(); ++it) {
+    const std::string& key = it->first;
+    if (key.size() >= suffix.size() &&
+        key.compare(key.size() - suffix.size(), suffix.size(), suffix) == 0)
+      return it->second;
+  }
+  return "";
+}
+
+
+
+/// Convert a length setting ("value unit") to mm
+bool ParseLength(const std::string& setting, double& length)
+{
+  char unit[16] = "mm";
+  if (std::sscanf(setting.c_str(), "%lf %15s", &length, unit) < 1) return false;
+
+  if      (std::strcmp(unit, "mm") == 0) length *= 1.;
+  else if (std::strcmp(unit, "cm") == 0) length *= 10.;
+  else if (std::strcmp(unit, "m")  == 0) length *= 1000.;
+  else if (std::strcmp(unit, "um") == 0) length *= 0.001;
+  else return false;
+
+  return true;
+}
+
+
+
+/// Add the detection probabilities of the sensors for the point of
+/// a nexus h5 file of a table production, in a single time bin:
+/// the charge of every sensor over the photons generated.
+bool AppendProductionFile(const std::string& filename, ELTableFile& table,
+                          std::vector<bool>& seen, std::string& error)
+{
+  hid_t file;
+  H5E_BEGIN_TRY {
+    file = H5Fopen(filename.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
+  } H5E_END_TRY;
+
+  if (file < 0) {
+    error = "cannot open " + filename;
+    return false;
+  }
+
+  if (H5Lexists(file, "/MC", H5P_DEFAULT) <= 0 ||
+      H5Lexists(file, "/MC/configuration", H5P_DEFAULT) <= 0) {
+    error = filename + " is not a nexus file";
+    H5Fclose(file);
+    return false;
+  }
+
+  // Position of the point and photons generated, from the configuration
+  std::map<std::string, std::string> config;
+  {
+    hid_t dataset = H5Dopen2(file, "/MC/configuration", H5P_DEFAULT);
+    hid_t memtype = createRunType();
+    std::vector<run_info_t> rows(numRows(dataset));
+    readRows(rows.data(), rows.size(), dataset, memtype, 0);
+    for (size_t i=0; i<rows.size(); i++)
+      config[std::string(rows[i].param_key, strnlen(rows[i].param_key, CONFLEN))] =
+        std::string(rows[i].param_value, strnlen(rows[i].param_value, CONFLEN));
+    H5Tclose(memtype);
+    H5Dclose(dataset);
+  }
+
+  double x, y;
+  if (!ParseLength(FindSetting(config, "specific_vertex_X"), x) ||
+      !ParseLength(FindSetting(config, "specific_vertex_Y"), y)) {
+    error = filename + " has no specific_vertex_X and specific_vertex_Y settings";
+    H5Fclose(file);
+    return false;
+  }
+
+  double photons = std::atof(FindSetting(config, "/nphotons").c_str()) *
+    std::atof(FindSetting(config, "num_events").c_str());
+  if (!(photons > 0.)) {
+    error = filename + " has no nphotons and num_events settings";
+    H5Fclose(file);
+    return false;
+  }
+
+  int point = table.FindPoint(x, y);
+  if (point < 0) {
+    error = "the grid of points is not defined";
+    H5Fclose(file);
+    return false;
+  }
+  if ((size_t) point >= seen.size()) seen.resize(point + 1, false);
+  if (seen[point]) {
+    char msg[128];
+    std::snprintf(msg, sizeof(msg), " is the second file of point %d (%g, %g) mm",
+                  point, x, y);
+    error = filename + msg;
+    H5Fclose(file);
+    return false;
+  }
+  seen[point] = true;
+
+  // Charge of every sensor, from the plain or the compact sensor response
+  std::map<unsigned int, double> charges;
+
+  if (H5Lexists(file, "/MC/sns_response", H5P_DEFAULT) > 0) {
+    hid_t dataset = H5Dopen2(file, "/MC/sns_response", H5P_DEFAULT);
+    hid_t memtype = createSensorDataType();
+    std::vector<sns_data_t> rows(numRows(dataset));
+    readRows(rows.data(), rows.size(), dataset, memtype, 0);
+    for (size_t i=0; i<rows.size(); i++)
+      charges[rows[i].sensor_id] += rows[i].charge;
+    H5Tclose(memtype);
+    H5Dclose(dataset);
+  }
+  else if (H5Lexists(file, "/MC/sns_waveforms", H5P_DEFAULT) > 0 &&
+           H5Lexists(file, "/MC/sns_samples", H5P_DEFAULT) > 0) {
+    hid_t dataset = H5Dopen2(file, "/MC/sns_waveforms", H5P_DEFAULT);
+    hid_t memtype = createSensorWaveformType();
+    std::vector<sns_waveform_t> waveforms(numRows(dataset));
+    readRows(waveforms.data(), waveforms.size(), dataset, memtype, 0);
+    H5Tclose(memtype);
+    H5Dclose(dataset);
+
+    dataset = H5Dopen2(file, "/MC/sns_samples", H5P_DEFAULT);
+    memtype = createSensorSampleType();
+    std::vector<sns_sample_t> samples(numRows(dataset));
+    readRows(samples.data(), samples.size(), dataset, memtype, 0);
+    H5Tclose(memtype);
+    H5Dclose(dataset);
+
+    for (size_t i=0; i<waveforms.size(); i++) {
+      uint64_t last = std::min<uint64_t>(waveforms[i].last, samples.size());
+      for (uint64_t s=waveforms[i].first; s<last; s++)
+        charges[waveforms[i].sensor_id] += samples[s].charge;
+    }
+  }
+
+  H5Fclose(file);
+
+  std::vector<float> probs(1);
+  std::map<unsigned int, double>::const_iterator it;
+  for (it = charges.begin(); it != charges.end(); ++it) {
+    if (it->second <= 0.) continue;
+    probs[0] = it->second / photons;
+    if (!table.AddEntry(point, it->first, probs)) {
+      error = filename + ": " + table.Error();
+      return false;
+    }
+  }
+
+  return true;
+}
+
+
+
+int main(int argc, char** argv)
+{
+  ////////////////////////////////////////////////////////////////////
+  // PARSE COMMAND-LINE OPTIONS
+
+  std::string output;
+  std::vector<std::string> inputs;
+  double radius = 92.5;
+  double binning = 5.;
+
+  static struct option long_options[] =
+  {
+    {"output",  required_argument, 0, 'o'},
+    {"radius",  required_argument, 0, 'r'},
+    {"binning", required_argument, 0, 'b'},
+    {"list",    required_argument, 0, 'l'},
+    {0, 0, 0, 0}
+  };
+
+  int c;
+
+  while (true) {
+
+    opterr = 0;
+    c = getopt_long(argc, argv, "o:r:b:l:", long_options, 0);
+
+    if (c==-1) break; // Exit if we are done reading options
+
+    switch (c) {
+
+      case 'o':
+        output = optarg;
+        break;
+
+      case 'r':
+        radius = atof(optarg);
+        break;
+
+      case 'b':
+        binning = atof(optarg);
+        break;
+
+      case 'l': {
+        // Productions may have more files than fit in a command line
+        std::ifstream list(optarg);
+        if (!list) {
+          std::cerr << "Cannot read the list of files " << optarg << std::endl;
+          return EXIT_FAILURE;
+        }
+        std::string name;
+        while (list >> name) inputs.push_back(name);
+        break;
+      }
+
+      case '?':
+        PrintUsage();
+        break;
+
+      default:
+        abort();
+    }
+  }
+
+  for (int i=optind; i<argc; i++)
+    inputs.push_back(argv[i]);
+
+  if (output == "" || inputs.empty()) PrintUsage();
+
+  ////////////////////////////////////////////////////////////////////
+
+  ELTableFile table;
+  std::string error;
+  bool ok;
+
+  htri_t is_hdf5;
+  H5E_BEGIN_TRY {
+    is_hdf5 = H5Fis_hdf5(inputs[0].c_str());
+  } H5E_END_TRY;
+
+  if (is_hdf5 > 0) {
+    ok = table.Reset(radius, binning);
+    if (!ok) error = table.Error();
+    std::vector<bool> seen;
+    for (size_t i=0; ok && i<inputs.size(); i++)
+      ok = AppendProductionFile(inputs[i], table, seen, error);
+    if (ok) table.Finish();
+  }
+  else if (inputs.size() == 1) {
+    ok = table.ReadText(inputs[0], radius, binning);
+    if (!ok) error = table.Error();
+  }
+  else {
+    ok = false;
+    error = "a text table is converted on its own";
+  }
+
+  if (ok) {
+    ok = table.Write(output);
+    if (!ok) {
+      error = table.Error();
+      std::remove(output.c_str());
+    }
+  }
+
+  if (!ok) {
+    std::cerr << "nexus-eltable: " << error << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  std::cout << "Wrote " << table.GetNumberOfEntries() << " entries of "
+            << table.GetNumberOfPoints() << " points with "
+            << table.GetNumberOfTimeBins() << " time bins to "
+            << output << std::endl;
+  return EXIT_SUCCESS;
+}
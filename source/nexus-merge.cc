@@ -0,0 +1,132 @@
+// ----------------------------------------------------------------------------
+// nexus | nexus-merge.cc
+//
+// This program merges nexus h5 output files into one.
+//
+// The NEXT Collaboration
+// ----------------------------------------------------------------------------
+
+#include "HDF5Merger.h"
+
+#include <iostream>
+#include <fstream>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include <getopt.h>
+
+using namespace nexus;
+
+
+
+void PrintUsage()
+{
+  std::cerr << "\nUsage: ./nexus-merge [-r] [-f] [-l list] -o <output> <input> ...\n"
+            << std::endl;
+  std::cerr << "Available options:" << std::endl;
+  std::cerr << "   -o, --output          : Merged output file\n"
+            << "   -l, --list            : File with the names of the input "
+            << "files, one per line\n"
+            << "   -r, --rebase-ids      : Shift the event ids of every file "
+            << "to follow those of the previous files\n"
+            << "   -f, --force           : Merge files with different "
+            << "configurations"
+            << std::endl;
+  exit(EXIT_FAILURE);
+}
+
+
+
+int main(int argc, char** argv)
+{
+  ////////////////////////////////////////////////////////////////////
+  // PARSE COMMAND-LINE OPTIONS
+
+  std::string output;
+  std::vector<std::string> inputs;
+  bool rebase_ids = false;
+  bool force = false;
+
+  static struct option long_options[] =
+  {
+    {"output",     required_argument, 0, 'o'},
+    {"list",       required_argument, 0, 'l'},
+    {"rebase-ids", no_argument,       0, 'r'},
+    {"force",      no_argument,       0, 'f'},
+    {0, 0, 0, 0}
+  };
+
+  int c;
+
+  while (true) {
+
+    opterr = 0;
+    c = getopt_long(argc, argv, "o:l:rf", long_options, 0);
+
+    if (c==-1) break; // Exit if we are done reading options
+
+    switch (c) {
+
+      case 'o':
+        output = optarg;
+        break;
+
+      case 'l': {
+        // Productions may have more files than fit in a command line
+        std::ifstream list(optarg);
+        if (!list) {
+          std::cerr << "Cannot read the list of files " << optarg << std::endl;
+          return EXIT_FAILURE;
+        }
+        std::string name;
+        while (list >> name) inputs.push_back(name);
+        break;
+      }
+
+      case 'r':
+        rebase_ids = true;
+        break;
+
+      case 'f':
+        force = true;
+        break;
+
+      case '?':
+        PrintUsage();
+        break;
+
+      default:
+        abort();
+    }
+  }
+
+  for (int i=optind; i<argc; i++)
+    inputs.push_back(argv[i]);
+
+  if (output == "" || inputs.empty()) PrintUsage();
+
+  ////////////////////////////////////////////////////////////////////
+
+  HDF5Merger merger;
+  merger.SetRebaseEventIds(rebase_ids);
+  merger.SetCheckConfiguration(!force);
+
+  bool opened = merger.Open(output);
+  bool ok = opened;
+  for (size_t i=0; ok && i<inputs.size(); i++)
+    ok = merger.Append(inputs[i]);
+  merger.Close();
+
+  // An incomplete output is of no use
+  if (!ok) {
+    std::cerr << "nexus-merge: " << merger.Error() << std::endl;
+    if (opened) std::remove(output.c_str());
+    return EXIT_FAILURE;
+  }
+
+  std::cout << "Merged " << inputs.size() << " files into "
+            << output << std::endl;
+  return EXIT_SUCCESS;
+}
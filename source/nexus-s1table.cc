@@ -0,0 +1,331 @@
+// ----------------------------------------------------------------------------
+// nexus | nexus-s1table.cc
+//
+// This program builds S1 light tables from nexus table productions.
+//
+// The NEXT Collaboration
+// ----------------------------------------------------------------------------
+
+#include "S1TableFile.h"
+#include "S1TableBuilder.h"
+#include "hdf5_functions.h"
+
+#include <hdf5.h>
+
+#include <algorithm>
+#include <iostream>
+#include <fstream>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <getopt.h>
+
+using namespace nexus;
+
+
+
+void PrintUsage()
+{
+  std::cerr << "\nUsage: ./nexus-s1table --min x,y,z --max x,y,z "
+            << "--voxel dx,dy,dz [-l list] -o <output> <input> ...\n" << std::endl;
+  std::cerr << "Builds an S1 light table from the nexus h5 files of a table\n"
+            << "production with scintillation vertices spread over the\n"
+            << "active volume (see the *_S1_table macros).\n" << std::endl;
+  std::cerr << "Available options:" << std::endl;
+  std::cerr << "   -o, --output          : S1 light table\n"
+            << "   -m, --min             : Lowest corner of the box of "
+            << "voxels, in mm\n"
+            << "   -M, --max             : Highest corner of the box of "
+            << "voxels, in mm\n"
+            << "   -v, --voxel           : Size of the voxels, in mm\n"
+            << "   -l, --list            : File with the names of the input "
+            << "files, one per line"
+            << std::endl;
+  exit(EXIT_FAILURE);
+}
+
+
+
+/// Parse a triplet of comma-separated numbers
+bool ParseTriplet(const char* text, double values[3])
+{
+  return std::sscanf(text, "%lf,%lf,%lf", &values[0], &values[1], &values[2]) == 3;
+}
+
+
+
+/// Reads the vertex and the detected charge of every sensor of the
+/// events of the table production into an S1TableBuilder
+class S1Accumulator {
+
+public:
+  S1Accumulator(const S1TableFile& table): table_(table),
+    builder_(table.GetNumberOfVoxels()), photons_(0.) {}
+
+  /// Add the events of a file. Returns false on error.
+  bool Append(const std::string& filename);
+
+  /// Fill the table being accumulated with the detection probabilities
+  bool Fill(S1TableFile& table);
+
+  /// Number of voxels without any event
+  uint64_t EmptyVoxels() const { return builder_.EmptyVoxels(); }
+
+  const std::string& Error() const { return error_; }
+
+private:
+  const S1TableFile& table_;
+  S1TableBuilder builder_;
+  double photons_;  ///< photons generated per event
+  std::string error_;
+};
+
+
+
+bool S1Accumulator::Append(const std::string& filename)
+{
+  hid_t file;
+  H5E_BEGIN_TRY {
+    file = H5Fopen(filename.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
+  } H5E_END_TRY;
+
+  if (file < 0) {
+    error_ = "cannot open " + filename;
+    return false;
+  }
+
+  if (H5Lexists(file, "/MC", H5P_DEFAULT) <= 0 ||
+      H5Lexists(file, "/MC/configuration", H5P_DEFAULT) <= 0 ||
+      H5Lexists(file, "/MC/particles", H5P_DEFAULT) <= 0) {
+    error_ = filename + " is not a nexus file with particles";
+    H5Fclose(file);
+    return false;
+  }
+
+  // Photons generated per event, the same for all the files
+  double photons = 0.;
+  {
+    hid_t dataset = H5Dopen2(file, "/MC/configuration", H5P_DEFAULT);
+    hid_t memtype = createRunType();
+    std::vector<run_info_t> rows(numRows(dataset));
+    readRows(rows.data(), rows.size(), dataset, memtype, 0);
+    for (size_t i=0; i<rows.size(); i++) {
+      std::string key(rows[i].param_key, strnlen(rows[i].param_key, CONFLEN));
+      if (key.size() >= 9 && key.compare(key.size() - 9, 9, "/nphotons") == 0)
+        photons = std::atof(rows[i].param_value);
+    }
+    H5Tclose(memtype);
+    H5Dclose(dataset);
+  }
+
+  if (!(photons > 0.) || (photons_ > 0. && photons != photons_)) {
+    error_ = filename + " has no nphotons setting, or one different from "
+      "that of the other files";
+    H5Fclose(file);
+    return false;
+  }
+  photons_ = photons;
+
+  // Voxel of the vertex of every event, from the first photon,
+  // whatever the layout of the rest of the particle columns
+  std::map<int32_t, int64_t> voxels;
+  {
+    struct vertex_t { int32_t event_id; int32_t particle_id; float x, y, z; };
+    hid_t memtype = H5Tcreate(H5T_COMPOUND, sizeof(vertex_t));
+    H5Tinsert(memtype, "event_id",    HOFFSET(vertex_t, event_id),    H5T_NATIVE_INT32);
+    H5Tinsert(memtype, "particle_id", HOFFSET(vertex_t, particle_id), H5T_NATIVE_INT32);
+    H5Tinsert(memtype, "initial_x",   HOFFSET(vertex_t, x),           H5T_NATIVE_FLOAT);
+    H5Tinsert(memtype, "initial_y",   HOFFSET(vertex_t, y),           H5T_NATIVE_FLOAT);
+    H5Tinsert(memtype, "initial_z",   HOFFSET(vertex_t, z),           H5T_NATIVE_FLOAT);
+
+    hid_t dataset = H5Dopen2(file, "/MC/particles", H5P_DEFAULT);
+    std::vector<vertex_t> rows(numRows(dataset));
+    readRows(rows.data(), rows.size(), dataset, memtype, 0);
+    H5Dclose(dataset);
+    H5Tclose(memtype);
+
+    for (size_t i=0; i<rows.size(); i++) {
+      if (rows[i].particle_id != 1) continue;
+      int64_t voxel = table_.FindVoxel(rows[i].x, rows[i].y, rows[i].z);
+      voxels[rows[i].event_id] = voxel;
+      builder_.AddEvent(voxel);
+    }
+  }
+
+  // Charge of every sensor, from the plain or the compact sensor response
+  if (H5Lexists(file, "/MC/sns_response", H5P_DEFAULT) > 0) {
+    hid_t dataset = H5Dopen2(file, "/MC/sns_response", H5P_DEFAULT);
+    hid_t memtype = createSensorDataType();
+    std::vector<sns_data_t> rows(numRows(dataset));
+    readRows(rows.data(), rows.size(), dataset, memtype, 0);
+    for (size_t i=0; i<rows.size(); i++) {
+      std::map<int32_t, int64_t>::const_iterator it = voxels.find(rows[i].event_id);
+      if (it == voxels.end() || it->second < 0) continue;
+      builder_.AddCharge(it->second, rows[i].sensor_id, rows[i].charge);
+    }
+    H5Tclose(memtype);
+    H5Dclose(dataset);
+  }
+  else if (H5Lexists(file, "/MC/sns_waveforms", H5P_DEFAULT) > 0 &&
+           H5Lexists(file, "/MC/sns_samples", H5P_DEFAULT) > 0) {
+    hid_t dataset = H5Dopen2(file, "/MC/sns_waveforms", H5P_DEFAULT);
+    hid_t memtype = createSensorWaveformType();
+    std::vector<sns_waveform_t> waveforms(numRows(dataset));
+    readRows(waveforms.data(), waveforms.size(), dataset, memtype, 0);
+    H5Tclose(memtype);
+    H5Dclose(dataset);
+
+    dataset = H5Dopen2(file, "/MC/sns_samples", H5P_DEFAULT);
+    memtype = createSensorSampleType();
+    std::vector<sns_sample_t> samples(numRows(dataset));
+    readRows(samples.data(), samples.size(), dataset, memtype, 0);
+    H5Tclose(memtype);
+    H5Dclose(dataset);
+
+    for (size_t i=0; i<waveforms.size(); i++) {
+      std::map<int32_t, int64_t>::const_iterator it = voxels.find(waveforms[i].event_id);
+      if (it == voxels.end() || it->second < 0) continue;
+      double charge = 0.;
+      uint64_t last = std::min<uint64_t>(waveforms[i].last, samples.size());
+      for (uint64_t s=waveforms[i].first; s<last; s++)
+        charge += samples[s].charge;
+      builder_.AddCharge(it->second, waveforms[i].sensor_id, charge);
+    }
+  }
+
+  H5Fclose(file);
+  return true;
+}
+
+
+
+bool S1Accumulator::Fill(S1TableFile& table)
+{
+  if (!builder_.Fill(table, photons_)) {
+    error_ = builder_.Error();
+    return false;
+  }
+  return true;
+}
+
+
+
+int main(int argc, char** argv)
+{
+  ////////////////////////////////////////////////////////////////////
+  // PARSE COMMAND-LINE OPTIONS
+
+  std::string output;
+  std::vector<std::string> inputs;
+  double lower[3], upper[3], voxel[3];
+  bool has_lower = false, has_upper = false, has_voxel = false;
+
+  static struct option long_options[] =
+  {
+    {"output", required_argument, 0, 'o'},
+    {"min",    required_argument, 0, 'm'},
+    {"max",    required_argument, 0, 'M'},
+    {"voxel",  required_argument, 0, 'v'},
+    {"list",   required_argument, 0, 'l'},
+    {0, 0, 0, 0}
+  };
+
+  int c;
+
+  while (true) {
+
+    opterr = 0;
+    c = getopt_long(argc, argv, "o:m:M:v:l:", long_options, 0);
+
+    if (c==-1) break; // Exit if we are done reading options
+
+    switch (c) {
+
+      case 'o':
+        output = optarg;
+        break;
+
+      case 'm':
+        has_lower = ParseTriplet(optarg, lower);
+        break;
+
+      case 'M':
+        has_upper = ParseTriplet(optarg, upper);
+        break;
+
+      case 'v':
+        has_voxel = ParseTriplet(optarg, voxel);
+        break;
+
+      case 'l': {
+        // Productions may have more files than fit in a command line
+        std::ifstream list(optarg);
+        if (!list) {
+          std::cerr << "Cannot read the list of files " << optarg << std::endl;
+          return EXIT_FAILURE;
+        }
+        std::string name;
+        while (list >> name) inputs.push_back(name);
+        break;
+      }
+
+      case '?':
+        PrintUsage();
+        break;
+
+      default:
+        abort();
+    }
+  }
+
+  for (int i=optind; i<argc; i++)
+    inputs.push_back(argv[i]);
+
+  if (output == "" || inputs.empty() || !has_lower || !has_upper || !has_voxel)
+    PrintUsage();
+
+  ////////////////////////////////////////////////////////////////////
+
+  uint32_t nvoxels[3];
+  for (int i=0; i<3; i++)
+    nvoxels[i] = (voxel[i] > 0. && upper[i] > lower[i]) ?
+      (uint32_t) std::ceil((upper[i] - lower[i]) / voxel[i] - 1.e-9) : 0;
+
+  S1TableFile table;
+  if (!table.Reset(lower, voxel, nvoxels)) {
+    std::cerr << "nexus-s1table: " << table.Error() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  S1Accumulator accumulator(table);
+
+  bool ok = true;
+  for (size_t i=0; ok && i<inputs.size(); i++)
+    ok = accumulator.Append(inputs[i]);
+
+  if (ok) ok = accumulator.Fill(table);
+  if (ok) ok = table.Write(output);
+
+  if (!ok) {
+    std::string error = accumulator.Error();
+    if (error == "") error = table.Error();
+    std::cerr << "nexus-s1table: " << error << std::endl;
+    std::remove(output.c_str());
+    return EXIT_FAILURE;
+  }
+
+  std::cout << "Wrote " << table.GetNumberOfEntries() << " entries of "
+            << table.GetNumberOfVoxels() << " voxels to " << output << std::endl;
+
+  uint64_t empty = accumulator.EmptyVoxels();
+  if (empty)
+    std::cout << empty << " voxels have no events: no light is "
+              << "detected from them" << std::endl;
+
+  return EXIT_SUCCESS;
+}
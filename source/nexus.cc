@@ -23,11 +23,15 @@ using namespace nexus;
 
 void PrintUsage()
 {
-  G4cerr  << "\nUsage: ./nexus [-b|i] [-n number] <init_macro>\n" << G4endl;
+  G4cerr  << "\nUsage: ./nexus [-b|i] [-n number] [-t threads] [-p processes] <init_macro>\n" << G4endl;
   G4cerr  << "Available options:" << G4endl;
   G4cerr  << "   -b, --batch           : Run in batch mode (default)\n"
           << "   -i, --interactive     : Run in interactive mode\n"
-          << "   -n, --nevents         : Number of events to simulate"
+          << "   -n, --nevents         : Number of events to simulate\n"
+          << "   -t, --threads         : Number of worker threads "
+          << "(default: 0, sequential mode)\n"
+          << "   -p, --processes       : Number of processes the events are "
+          << "split into, merging their output (batch mode only)"
           << G4endl;
   exit(EXIT_FAILURE);
 }
@@ -45,12 +49,16 @@ G4int main(int argc, char** argv)
 
   G4bool batch = true;
   G4int nevents = 0;
+  G4int nthreads = 0;
+  G4int nprocesses = 1;
 
   static struct option long_options[] =
   {
     {"batch",       no_argument,       0, 'b'},
     {"interactive", no_argument,       0, 'i'},
     {"nevents",       required_argument, 0, 'n'},
+    {"threads",     required_argument, 0, 't'},
+    {"processes",   required_argument, 0, 'p'},
     {0, 0, 0, 0}
   };
 
@@ -60,7 +68,7 @@ G4int main(int argc, char** argv)
 
     //  int option_index = 0;
     opterr = 0;
-    c = getopt_long(argc, argv, "bin:", long_options, 0);
+    c = getopt_long(argc, argv, "bin:t:p:", long_options, 0);
     
     if (c==-1) break; // Exit if we are done reading options
 
@@ -78,6 +86,14 @@ G4int main(int argc, char** argv)
         nevents = atoi(optarg);
         break;
 
+      case 't':
+        nthreads = atoi(optarg);
+        break;
+
+      case 'p':
+        nprocesses = atoi(optarg);
+        break;
+
       case '?':
         break;
 
@@ -102,10 +118,16 @@ G4int main(int argc, char** argv)
     
 
 
+  // Events are only split among processes by a batch run
+  if (!batch && nprocesses > 1) {
+    G4cerr << "Processes are ignored in interactive mode." << G4endl;
+    nprocesses = 1;
+  }
+
   ////////////////////////////////////////////////////////////////////
 
   
-  NexusApp* app = new NexusApp(macro_filename);
+  NexusApp* app = new NexusApp(macro_filename, nthreads, nprocesses);
   app->Initialize();
 
   G4UImanager* UI = G4UImanager::GetUIpointer();
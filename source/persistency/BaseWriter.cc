@@ -0,0 +1,393 @@
+// ----------------------------------------------------------------------------
+// nexus | BaseWriter.cc
+//
+// This is an abstract base class for the writers of the output file.
+//
+// The NEXT Collaboration
+// ----------------------------------------------------------------------------
+
+#include "BaseWriter.h"
+
+#include <cstring>
+#include <algorithm>
+
+using namespace nexus;
+
+
+BaseWriter::BaseWriter(): isOpen_(false), compactSns_(false), digitSns_(false)
+{
+  ResetRows();
+}
+
+BaseWriter::~BaseWriter()
+{
+}
+
+void BaseWriter::FlushFile()
+{
+  Flush();
+}
+
+void BaseWriter::SetCompactSensorResponse(bool compact)
+{
+  if (isOpen_) return;
+  compactSns_ = compact;
+}
+
+void BaseWriter::SetDigitizedSensorResponse(bool digitized)
+{
+  if (isOpen_) return;
+  digitSns_ = digitized;
+}
+
+void BaseWriter::ResetRows()
+{
+  for (int i=0; i<NUM_TABLES; ++i) {
+    rows_[i]       = 0;
+    eventFirst_[i] = 0;
+  }
+}
+
+void BaseWriter::WriteRunInfo(const char* param_key, const char* param_value)
+{
+  run_info_t& runData = NewRow<run_info_t>(RUN_TABLE);
+  memset(runData.param_key,   0, CONFLEN);
+  memset(runData.param_value, 0, CONFLEN);
+  strcpy(runData.param_key, param_key);
+  strcpy(runData.param_value, param_value);
+}
+
+
+void BaseWriter::WriteSensorDataInfo(int evt_number, unsigned int sensor_id, unsigned int time_bin, unsigned int charge)
+{
+  sns_data_t& snsData = NewRow<sns_data_t>(SNS_DATA_TABLE);
+  snsData.event_id = evt_number;
+  snsData.sensor_id = sensor_id;
+  snsData.time_bin = time_bin;
+  snsData.charge = charge;
+}
+
+void BaseWriter::WriteSensorData(int evt_number, unsigned int sensor_id,
+                                 const std::vector<std::pair<unsigned int, unsigned int> >& samples)
+{
+  if (samples.empty()) return;
+
+  sns_data_t* rows = NewRows<sns_data_t>(SNS_DATA_TABLE, samples.size());
+  for (size_t i=0; i<samples.size(); ++i) {
+    rows[i].event_id  = evt_number;
+    rows[i].sensor_id = sensor_id;
+    rows[i].time_bin  = samples[i].first;
+    rows[i].charge    = samples[i].second;
+  }
+}
+
+void BaseWriter::WriteSensorWaveform(int evt_number, unsigned int sensor_id,
+                                     const std::vector<std::pair<unsigned int, unsigned int> >& samples)
+{
+  if (samples.empty()) return;
+
+  sns_waveform_t& waveform = NewRow<sns_waveform_t>(SNS_WAVEFORM_TABLE);
+  waveform.event_id  = evt_number;
+  waveform.sensor_id = sensor_id;
+  waveform.first_bin = samples.front().first;
+  waveform.first     = rows_[SNS_SAMPLE_TABLE];
+
+  const unsigned int max_sample = 0xFFFF;
+  unsigned int previous = samples.front().first;
+
+  for (size_t i=0; i<samples.size(); ++i) {
+    unsigned int delta  = samples[i].first - previous;
+    unsigned int charge = samples[i].second;
+    previous = samples[i].first;
+
+    // Pad gaps that do not fit in a sample with empty samples
+    while (delta > max_sample) {
+      WriteSensorSample(max_sample, 0);
+      delta -= max_sample;
+    }
+    // Split charges that do not fit in a sample over the same bin
+    while (charge > max_sample) {
+      WriteSensorSample(delta, max_sample);
+      charge -= max_sample;
+      delta = 0;
+    }
+    WriteSensorSample(delta, charge);
+  }
+
+  waveform.last = rows_[SNS_SAMPLE_TABLE];
+}
+
+void BaseWriter::WriteSensorSample(unsigned int bin_delta, unsigned int charge)
+{
+  sns_sample_t& sample = NewRow<sns_sample_t>(SNS_SAMPLE_TABLE);
+  sample.bin_delta = bin_delta;
+  sample.charge    = charge;
+}
+
+void BaseWriter::WriteSensorDigit(int evt_number, unsigned int sensor_id,
+                                  unsigned int sample, unsigned int adc)
+{
+  sns_digit_t& digit = NewRow<sns_digit_t>(SNS_DIGIT_TABLE);
+  digit.event_id  = evt_number;
+  digit.sensor_id = sensor_id;
+  digit.sample    = sample;
+  digit.adc       = adc;
+}
+
+void BaseWriter::WriteSensorDigits(int evt_number, unsigned int sensor_id,
+                                   const std::vector<std::pair<unsigned int, unsigned int> >& samples)
+{
+  if (samples.empty()) return;
+
+  sns_digit_t* rows = NewRows<sns_digit_t>(SNS_DIGIT_TABLE, samples.size());
+  for (size_t i=0; i<samples.size(); ++i) {
+    rows[i].event_id  = evt_number;
+    rows[i].sensor_id = sensor_id;
+    rows[i].sample    = samples[i].first;
+    rows[i].adc       = samples[i].second;
+  }
+}
+
+void BaseWriter::WriteHitInfo(int evt_number, int particle_indx, int hit_indx, float hit_position_x, float hit_position_y, float hit_position_z, float hit_time, float hit_energy, const char* label)
+{
+  hit_info_t& trueInfo = NewRow<hit_info_t>(HIT_TABLE);
+  trueInfo.event_id = evt_number;
+  trueInfo.x = hit_position_x;
+  trueInfo.y = hit_position_y;
+  trueInfo.z = hit_position_z;
+  trueInfo.time = hit_time;
+  trueInfo.energy = hit_energy;
+  memset(trueInfo.label, 0, STRLEN);
+  strcpy(trueInfo.label, label);
+  trueInfo.particle_id = particle_indx;
+  trueInfo.hit_id = hit_indx;
+}
+
+void BaseWriter::WriteHits(int evt_number, size_t nhits,
+                           const int* particle_ids, const int* hit_ids,
+                           const double* x, const double* y, const double* z,
+                           const double* time, const double* energy,
+                           const char* label)
+{
+  if (nhits == 0) return;
+
+  // Rows are zero-initialized, so the label needs no padding
+  size_t length = std::min(strlen(label), size_t(STRLEN - 1));
+
+  hit_info_t* rows = NewRows<hit_info_t>(HIT_TABLE, nhits);
+  for (size_t i=0; i<nhits; ++i) {
+    rows[i].event_id    = evt_number;
+    rows[i].x           = x[i];
+    rows[i].y           = y[i];
+    rows[i].z           = z[i];
+    rows[i].time        = time[i];
+    rows[i].energy      = energy[i];
+    memcpy(rows[i].label, label, length);
+    rows[i].particle_id = particle_ids[i];
+    rows[i].hit_id      = hit_ids[i];
+  }
+}
+
+void BaseWriter::WriteParticleInfo(int evt_number, int particle_indx, const char* particle_name, char primary, int mother_id, float initial_vertex_x, float initial_vertex_y, float initial_vertex_z, float initial_vertex_t, float final_vertex_x, float final_vertex_y, float final_vertex_z, float final_vertex_t, const char* initial_volume, const char* final_volume, float ini_momentum_x, float ini_momentum_y, float ini_momentum_z, float final_momentum_x, float final_momentum_y, float final_momentum_z, float kin_energy, float length, const char* creator_proc, const char* final_proc)
+{
+  particle_info_t& trueInfo = NewRow<particle_info_t>(PARTICLE_TABLE);
+  trueInfo.event_id = evt_number;
+  trueInfo.particle_id = particle_indx;
+  memset(trueInfo.particle_name, 0, STRLEN);
+  strcpy(trueInfo.particle_name, particle_name);
+  trueInfo.primary = primary;
+  trueInfo.mother_id = mother_id;
+  trueInfo.initial_x = initial_vertex_x;
+  trueInfo.initial_y = initial_vertex_y;
+  trueInfo.initial_z = initial_vertex_z;
+  trueInfo.initial_t = initial_vertex_t;
+  trueInfo.final_x = final_vertex_x;
+  trueInfo.final_y = final_vertex_y;
+  trueInfo.final_z = final_vertex_z;
+  trueInfo.final_t = final_vertex_t;
+  memset(trueInfo.initial_volume, 0, STRLEN);
+  strcpy(trueInfo.initial_volume, initial_volume);
+  memset(trueInfo.final_volume, 0, STRLEN);
+  strcpy(trueInfo.final_volume, final_volume);
+  trueInfo.initial_momentum_x = ini_momentum_x;
+  trueInfo.initial_momentum_y = ini_momentum_y;
+  trueInfo.initial_momentum_z = ini_momentum_z;
+  trueInfo.final_momentum_x = final_momentum_x;
+  trueInfo.final_momentum_y = final_momentum_y;
+  trueInfo.final_momentum_z = final_momentum_z;
+  trueInfo.kin_energy = kin_energy;
+  trueInfo.length = length;
+  memset(trueInfo.creator_proc, 0, STRLEN);
+  strcpy(trueInfo.creator_proc, creator_proc);
+  memset(trueInfo.final_proc, 0, STRLEN);
+  strcpy(trueInfo.final_proc, final_proc);
+}
+
+void BaseWriter::WriteSensorPosInfo(unsigned int sensor_id, const char* sensor_name, float x, float y, float z)
+{
+  sns_pos_t& snsPos = NewRow<sns_pos_t>(SNS_POS_TABLE);
+  snsPos.sensor_id = sensor_id;
+  memset(snsPos.sensor_name, 0, STRLEN);
+  strcpy(snsPos.sensor_name, sensor_name);
+  snsPos.x = x;
+  snsPos.y = y;
+  snsPos.z = z;
+}
+
+void BaseWriter::WriteEventIndex(int evt_number)
+{
+  // With the compact sensor response the range refers to sns_waveforms
+  OutputTable sns = compactSns_ ? SNS_WAVEFORM_TABLE : SNS_DATA_TABLE;
+  OutputTable tables[] = {HIT_TABLE, PARTICLE_TABLE, sns, SNS_DIGIT_TABLE};
+
+  if (!digitSns_)
+    FillEventIndex(NewRow<event_index_t>(EVENT_INDEX_TABLE), evt_number, sns);
+  else {
+    event_index_digits_t& index =
+      NewRow<event_index_digits_t>(EVENT_INDEX_TABLE);
+    FillEventIndex(index, evt_number, sns);
+    index.sns_digits_first = eventFirst_[SNS_DIGIT_TABLE];
+    index.sns_digits_last  = rows_[SNS_DIGIT_TABLE];
+  }
+
+  for (OutputTable table: tables)
+    eventFirst_[table] = rows_[table];
+}
+
+void BaseWriter::WriteStep(int evt_number,
+                           int particle_id, const char* particle_name,
+                           int step_id,
+                           const char* initial_volume,
+                           const char*   final_volume,
+                           const char*      proc_name,
+                           float initial_x, float initial_y, float initial_z,
+                           float   final_x, float   final_y, float   final_z)
+{
+  step_info_t& step = NewRow<step_info_t>(STEP_TABLE);
+  step.event_id    = evt_number;
+  step.particle_id = particle_id;
+  memset(step.particle_name , 0,  STRLEN);
+  strcpy(step.particle_name ,  particle_name);
+  step.step_id    = step_id;
+  memset(step.initial_volume, 0, STRLEN);
+  strcpy(step.initial_volume, initial_volume);
+  memset(step.  final_volume, 0, STRLEN);
+  strcpy(step.  final_volume,   final_volume);
+  memset(step.     proc_name, 0, STRLEN);
+  strcpy(step.     proc_name,      proc_name);
+  step.initial_x   = initial_x;
+  step.initial_y   = initial_y;
+  step.initial_z   = initial_z;
+  step.  final_x   =   final_x;
+  step.  final_y   =   final_y;
+  step.  final_z   =   final_z;
+}
+
+void BaseWriter::WriteString(int id, const char* value)
+{
+  string_info_t& str = NewRow<string_info_t>(STRING_TABLE);
+  str.id = id;
+  strncpy(str.value, value, STRLEN - 1);
+  str.value[STRLEN - 1] = '\0';
+}
+
+void BaseWriter::WriteHitInfo(int evt_number, int particle_indx, int hit_indx, float hit_position_x, float hit_position_y, float hit_position_z, float hit_time, float hit_energy, int label_id)
+{
+  hit_info_ids_t& trueInfo = NewRow<hit_info_ids_t>(HIT_TABLE);
+  trueInfo.event_id = evt_number;
+  trueInfo.x = hit_position_x;
+  trueInfo.y = hit_position_y;
+  trueInfo.z = hit_position_z;
+  trueInfo.time = hit_time;
+  trueInfo.energy = hit_energy;
+  trueInfo.label = label_id;
+  trueInfo.particle_id = particle_indx;
+  trueInfo.hit_id = hit_indx;
+}
+
+void BaseWriter::WriteHits(int evt_number, size_t nhits,
+                           const int* particle_ids, const int* hit_ids,
+                           const double* x, const double* y, const double* z,
+                           const double* time, const double* energy,
+                           int label_id)
+{
+  if (nhits == 0) return;
+
+  hit_info_ids_t* rows = NewRows<hit_info_ids_t>(HIT_TABLE, nhits);
+  for (size_t i=0; i<nhits; ++i) {
+    rows[i].event_id    = evt_number;
+    rows[i].x           = x[i];
+    rows[i].y           = y[i];
+    rows[i].z           = z[i];
+    rows[i].time        = time[i];
+    rows[i].energy      = energy[i];
+    rows[i].label       = label_id;
+    rows[i].particle_id = particle_ids[i];
+    rows[i].hit_id      = hit_ids[i];
+  }
+}
+
+void BaseWriter::WriteParticleInfo(int evt_number, int particle_indx, int particle_name_id, char primary, int mother_id, float initial_vertex_x, float initial_vertex_y, float initial_vertex_z, float initial_vertex_t, float final_vertex_x, float final_vertex_y, float final_vertex_z, float final_vertex_t, int initial_volume_id, int final_volume_id, float ini_momentum_x, float ini_momentum_y, float ini_momentum_z, float final_momentum_x, float final_momentum_y, float final_momentum_z, float kin_energy, float length, int creator_proc_id, int final_proc_id)
+{
+  particle_info_ids_t& trueInfo = NewRow<particle_info_ids_t>(PARTICLE_TABLE);
+  trueInfo.event_id = evt_number;
+  trueInfo.particle_id = particle_indx;
+  trueInfo.particle_name = particle_name_id;
+  trueInfo.primary = primary;
+  trueInfo.mother_id = mother_id;
+  trueInfo.initial_x = initial_vertex_x;
+  trueInfo.initial_y = initial_vertex_y;
+  trueInfo.initial_z = initial_vertex_z;
+  trueInfo.initial_t = initial_vertex_t;
+  trueInfo.final_x = final_vertex_x;
+  trueInfo.final_y = final_vertex_y;
+  trueInfo.final_z = final_vertex_z;
+  trueInfo.final_t = final_vertex_t;
+  trueInfo.initial_volume = initial_volume_id;
+  trueInfo.final_volume = final_volume_id;
+  trueInfo.initial_momentum_x = ini_momentum_x;
+  trueInfo.initial_momentum_y = ini_momentum_y;
+  trueInfo.initial_momentum_z = ini_momentum_z;
+  trueInfo.final_momentum_x = final_momentum_x;
+  trueInfo.final_momentum_y = final_momentum_y;
+  trueInfo.final_momentum_z = final_momentum_z;
+  trueInfo.kin_energy = kin_energy;
+  trueInfo.length = length;
+  trueInfo.creator_proc = creator_proc_id;
+  trueInfo.final_proc = final_proc_id;
+}
+
+void BaseWriter::WriteSensorPosInfo(unsigned int sensor_id, int sensor_name_id, float x, float y, float z)
+{
+  sns_pos_ids_t& snsPos = NewRow<sns_pos_ids_t>(SNS_POS_TABLE);
+  snsPos.sensor_id = sensor_id;
+  snsPos.sensor_name = sensor_name_id;
+  snsPos.x = x;
+  snsPos.y = y;
+  snsPos.z = z;
+}
+
+void BaseWriter::WriteStep(int evt_number,
+                           int particle_id, int particle_name_id,
+                           int step_id,
+                           int initial_volume_id,
+                           int   final_volume_id,
+                           int      proc_name_id,
+                           float initial_x, float initial_y, float initial_z,
+                           float   final_x, float   final_y, float   final_z)
+{
+  step_info_ids_t& step = NewRow<step_info_ids_t>(STEP_TABLE);
+  step.event_id       = evt_number;
+  step.particle_id    = particle_id;
+  step.particle_name  = particle_name_id;
+  step.step_id        = step_id;
+  step.initial_volume = initial_volume_id;
+  step.  final_volume =   final_volume_id;
+  step.     proc_name =      proc_name_id;
+  step.initial_x      = initial_x;
+  step.initial_y      = initial_y;
+  step.initial_z      = initial_z;
+  step.  final_x      =   final_x;
+  step.  final_y      =   final_y;
+  step.  final_z      =   final_z;
+}
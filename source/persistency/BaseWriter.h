@@ -0,0 +1,203 @@
+// ----------------------------------------------------------------------------
+// nexus | BaseWriter.h
+//
+// This is an abstract base class for the writers of the output file.
+//
+// The NEXT Collaboration
+// ----------------------------------------------------------------------------
+
+#ifndef BASE_WRITER_H
+#define BASE_WRITER_H
+
+#include "hdf5_functions.h"
+
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace nexus {
+
+  /// Abstract base class of the output writers. The rows of the output
+  /// tables are filled here; derived classes provide the memory of every
+  /// new row and decide where and when the rows are written.
+
+  class BaseWriter
+  {
+  public:
+    /// Output tables
+    enum OutputTable { RUN_TABLE, SNS_DATA_TABLE, HIT_TABLE, PARTICLE_TABLE,
+                       SNS_POS_TABLE, STEP_TABLE, STRING_TABLE,
+                       EVENT_INDEX_TABLE, SNS_WAVEFORM_TABLE, SNS_SAMPLE_TABLE,
+                       SNS_DIGIT_TABLE, NUM_TABLES };
+
+    /// Destructor
+    virtual ~BaseWriter();
+
+    /// open file. If string_ids is true, the string columns of
+    /// the tables hold ids of the entries of the string table.
+    virtual void Open(std::string filename, bool debug, bool string_ids=false) = 0;
+
+    /// close file
+    virtual void Close() = 0;
+
+    /// write all buffered rows to file
+    virtual void Flush() = 0;
+
+    /// write all buffered rows and flush the file to disk
+    virtual void FlushFile();
+
+    /// size in bytes of the file as of the last write
+    virtual size_t FileSize() const = 0;
+
+    /// is the file open?
+    bool IsOpen() const;
+
+    /// Store the sensor response as delta-encoded waveforms
+    /// (see sns_waveform_t) instead of one row per time bin.
+    /// It must be set before Open().
+    void SetCompactSensorResponse(bool compact);
+
+    /// Create the table of the digitized sensor response (see
+    /// sns_digit_t). It must be set before Open().
+    void SetDigitizedSensorResponse(bool digitized);
+
+    void WriteRunInfo(const char* param_key, const char* param_value);
+    void WriteSensorDataInfo(int evt_number, unsigned int sensor_id, unsigned int time_bin, unsigned int charge);
+    void WriteHitInfo(int evt_number, int particle_indx, int hit_indx, float hit_position_x, float hit_position_y, float hit_position_z, float hit_time, float hit_energy, const char* label);
+    void WriteParticleInfo(int evt_number, int particle_indx, const char* particle_name, char primary, int mother_id, float initial_vertex_x, float initial_vertex_y, float initial_vertex_z, float initial_vertex_t, float final_vertex_x, float final_vertex_y, float final_vertex_z, float final_vertex_t, const char* initial_volume, const char* final_volume, float ini_momentum_x, float ini_momentum_y, float ini_momentum_z, float final_momentum_x, float final_momentum_y, float final_momentum_z, float kin_energy, float length, const char* creator_proc, const char* final_proc);
+    void WriteSensorPosInfo(unsigned int sensor_id, const char* sensor_name, float x, float y, float z);
+    void WriteStep(int evt_number,
+                   int particle_id, const char* particle_name,
+                   int step_id,
+                   const char* initial_volume,
+                   const char*   final_volume,
+                   const char*      proc_name,
+                   float initial_x, float initial_y, float initial_z,
+                   float   final_x, float   final_y, float   final_z);
+
+    /// Write the (time bin, charge) samples of a sensor, sorted by time
+    /// bin, as one waveform of the compact sensor response
+    void WriteSensorWaveform(int evt_number, unsigned int sensor_id,
+                             const std::vector<std::pair<unsigned int, unsigned int> >& samples);
+
+    /// Write the (time bin, charge) samples of a sensor, one row each
+    void WriteSensorData(int evt_number, unsigned int sensor_id,
+                         const std::vector<std::pair<unsigned int, unsigned int> >& samples);
+
+    /// Write the hits of a sensitive detector at once, from arrays
+    /// with the value of every column for each hit
+    void WriteHits(int evt_number, size_t nhits,
+                   const int* particle_ids, const int* hit_ids,
+                   const double* x, const double* y, const double* z,
+                   const double* time, const double* energy,
+                   const char* label);
+
+    /// Write a sample of the digitized waveform of a sensor
+    void WriteSensorDigit(int evt_number, unsigned int sensor_id,
+                          unsigned int sample, unsigned int adc);
+
+    /// Write the (sample, ADC counts) pairs of the digitized
+    /// waveform of a sensor, one row each
+    void WriteSensorDigits(int evt_number, unsigned int sensor_id,
+                           const std::vector<std::pair<unsigned int, unsigned int> >& samples);
+
+    /// Close the current event in the event index: the rows of the
+    /// event tables written since the previous call belong to evt_number
+    void WriteEventIndex(int evt_number);
+
+    // Versions of the above for files opened with string ids,
+    // where every string is replaced by its id in the string table
+    void WriteString(int id, const char* value);
+    void WriteHitInfo(int evt_number, int particle_indx, int hit_indx, float hit_position_x, float hit_position_y, float hit_position_z, float hit_time, float hit_energy, int label_id);
+    void WriteHits(int evt_number, size_t nhits,
+                   const int* particle_ids, const int* hit_ids,
+                   const double* x, const double* y, const double* z,
+                   const double* time, const double* energy,
+                   int label_id);
+    void WriteParticleInfo(int evt_number, int particle_indx, int particle_name_id, char primary, int mother_id, float initial_vertex_x, float initial_vertex_y, float initial_vertex_z, float initial_vertex_t, float final_vertex_x, float final_vertex_y, float final_vertex_z, float final_vertex_t, int initial_volume_id, int final_volume_id, float ini_momentum_x, float ini_momentum_y, float ini_momentum_z, float final_momentum_x, float final_momentum_y, float final_momentum_z, float kin_energy, float length, int creator_proc_id, int final_proc_id);
+    void WriteSensorPosInfo(unsigned int sensor_id, int sensor_name_id, float x, float y, float z);
+    void WriteStep(int evt_number,
+                   int particle_id, int particle_name_id,
+                   int step_id,
+                   int initial_volume_id,
+                   int   final_volume_id,
+                   int      proc_name_id,
+                   float initial_x, float initial_y, float initial_z,
+                   float   final_x, float   final_y, float   final_z);
+
+  protected:
+    /// Default constructor defined as protected so no instance of
+    /// this base class can be created.
+    BaseWriter();
+
+    /// Return the memory of nrows new zero-initialized rows of a table,
+    /// contiguous and valid until the next rows of the same table are
+    /// requested
+    virtual void* AllocateRows(OutputTable table, size_t size, size_t nrows) = 0;
+
+    /// Start counting the rows of every table from zero
+    void ResetRows();
+
+  private:
+    /// Append a row to a table
+    template <typename T>
+    T& NewRow(OutputTable table);
+
+    /// Append nrows rows to a table at once
+    template <typename T>
+    T* NewRows(OutputTable table, size_t nrows);
+
+    /// Append a sample to the compact sensor response
+    void WriteSensorSample(unsigned int bin_delta, unsigned int charge);
+
+    /// Fill the row ranges of the current event common to every
+    /// layout of the event index
+    template <typename T>
+    void FillEventIndex(T& index, int evt_number, OutputTable sns) const;
+
+  protected:
+    bool isOpen_;     ///< is the file open?
+    bool compactSns_; ///< compact sensor response?
+    bool digitSns_;   ///< digitized sensor response?
+
+    size_t rows_[NUM_TABLES];       ///< rows appended to each table
+    size_t eventFirst_[NUM_TABLES]; ///< first row of the current event
+  };
+
+
+  // INLINE DEFINITIONS //////////////////////////////////////////////
+
+  inline bool BaseWriter::IsOpen() const { return isOpen_; }
+
+
+  // TEMPLATE DEFINITIONS ////////////////////////////////////////////
+
+  template <typename T>
+  T& BaseWriter::NewRow(OutputTable table)
+  {
+    rows_[table]++;
+    return *static_cast<T*>(AllocateRows(table, sizeof(T), 1));
+  }
+
+  template <typename T>
+  T* BaseWriter::NewRows(OutputTable table, size_t nrows)
+  {
+    rows_[table] += nrows;
+    return static_cast<T*>(AllocateRows(table, sizeof(T), nrows));
+  }
+
+  template <typename T>
+  void BaseWriter::FillEventIndex(T& index, int evt_number, OutputTable sns) const
+  {
+    index.event_id           = evt_number;
+    index.hits_first         = eventFirst_[HIT_TABLE];
+    index.hits_last          = rows_[HIT_TABLE];
+    index.particles_first    = eventFirst_[PARTICLE_TABLE];
+    index.particles_last     = rows_[PARTICLE_TABLE];
+    index.sns_response_first = eventFirst_[sns];
+    index.sns_response_last  = rows_[sns];
+  }
+
+} // namespace nexus
+
+#endif
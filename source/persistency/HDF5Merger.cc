@@ -0,0 +1,562 @@
+// ----------------------------------------------------------------------------
+// nexus | HDF5Merger.cc
+//
+// This class merges nexus h5 output files into one.
+//
+// The NEXT Collaboration
+// ----------------------------------------------------------------------------
+
+#include "HDF5Merger.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <stdint.h>
+
+using namespace nexus;
+
+
+namespace {
+
+  /// Rows read and written at a time
+  const hsize_t BLOCK_ROWS = 65536;
+
+  /// Groups of the output file holding tables
+  const char* GROUPS[] = {"/MC", "/DEBUG"};
+
+  /// Columns holding string ids in files written with string ids
+  const char* STRING_COLUMNS[] = {"label", "particle_name", "initial_volume",
+                                  "final_volume", "creator_proc", "final_proc",
+                                  "sensor_name", "proc_name"};
+
+  /// Configuration entries that count events, summed up over files
+  const char* COUNTERS[] = {"num_events", "saved_events", "interacting_events"};
+
+  /// Configuration entries that may differ between files of a production
+  const char* PER_FILE[] = {"num_events", "saved_events", "interacting_events",
+                            "random_seed", "/nexus/random_seed",
+                            "/nexus/persistency/outputFile",
+                            "/nexus/persistency/start_id"};
+
+  template <size_t N>
+  bool isOneOf(const std::string& key, const char* (&list)[N])
+  {
+    for (const char* entry: list)
+      if (key == entry) return true;
+    return false;
+  }
+
+  bool contains(const std::vector<std::string>& paths, const char* path)
+  {
+    return std::find(paths.begin(), paths.end(), path) != paths.end();
+  }
+
+  /// Paths of the tables of a file
+  std::vector<std::string> tablePaths(hid_t file)
+  {
+    std::vector<std::string> paths;
+    for (const char* group_name: GROUPS) {
+      if (H5Lexists(file, group_name, H5P_DEFAULT) <= 0) continue;
+      hid_t group = H5Gopen2(file, group_name, H5P_DEFAULT);
+      H5G_info_t info;
+      H5Gget_info(group, &info);
+      for (hsize_t i=0; i<info.nlinks; i++) {
+        ssize_t size = H5Lget_name_by_idx(group, ".", H5_INDEX_NAME, H5_ITER_INC,
+                                          i, NULL, 0, H5P_DEFAULT);
+        std::vector<char> name(size + 1);
+        H5Lget_name_by_idx(group, ".", H5_INDEX_NAME, H5_ITER_INC,
+                           i, name.data(), size + 1, H5P_DEFAULT);
+        paths.push_back(std::string(group_name) + "/" + name.data());
+      }
+      H5Gclose(group);
+    }
+    return paths;
+  }
+
+  /// Copy an attribute of fixed size (as those written by
+  /// writeStringAttribute) to the object passed as data
+  herr_t copyAttribute(hid_t object, const char* name, const H5A_info_t*, void* data)
+  {
+    hid_t target = *static_cast<hid_t*>(data);
+    hid_t attr  = H5Aopen(object, name, H5P_DEFAULT);
+    hid_t type  = H5Aget_type(attr);
+    hid_t space = H5Aget_space(attr);
+
+    if (H5Tdetect_class(type, H5T_VLEN) <= 0 && H5Tis_variable_str(type) <= 0) {
+      std::vector<char> value(H5Tget_size(type) * H5Sget_simple_extent_npoints(space));
+      H5Aread(attr, type, value.data());
+      hid_t copy = H5Acreate2(target, name, type, space, H5P_DEFAULT, H5P_DEFAULT);
+      H5Awrite(copy, type, value.data());
+      H5Aclose(copy);
+    }
+
+    H5Sclose(space);
+    H5Tclose(type);
+    H5Aclose(attr);
+    return 0;
+  }
+
+  /// Offset in the row of an integer column of the given size, or -1
+  long columnOffset(hid_t memtype, const char* name, size_t size)
+  {
+    int index = H5Tget_member_index(memtype, name);
+    if (index < 0 || H5Tget_member_class(memtype, index) != H5T_INTEGER)
+      return -1;
+    hid_t type = H5Tget_member_type(memtype, index);
+    bool same_size = H5Tget_size(type) == size;
+    H5Tclose(type);
+    return same_size ? (long) H5Tget_member_offset(memtype, index) : -1;
+  }
+
+  /// Smallest and largest event id of a table, reading only that column.
+  /// They are left untouched if the table has no event_id column.
+  void eventIdRange(hid_t dataset, long long& min, long long& max)
+  {
+    hid_t type = H5Dget_type(dataset);
+    bool has_ids = H5Tget_class(type) == H5T_COMPOUND &&
+      H5Tget_member_index(type, "event_id") >= 0;
+    H5Tclose(type);
+    if (!has_ids) return;
+
+    hid_t memtype = H5Tcreate(H5T_COMPOUND, sizeof(int32_t));
+    H5Tinsert(memtype, "event_id", 0, H5T_NATIVE_INT32);
+
+    hsize_t nrows = numRows(dataset);
+    std::vector<int32_t> ids(std::min(nrows, BLOCK_ROWS));
+    for (hsize_t first=0; first<nrows; first+=BLOCK_ROWS) {
+      hsize_t count = std::min(BLOCK_ROWS, nrows - first);
+      readRows(ids.data(), count, dataset, memtype, first);
+      for (hsize_t i=0; i<count; i++) {
+        min = std::min(min, (long long) ids[i]);
+        max = std::max(max, (long long) ids[i]);
+      }
+    }
+
+    H5Tclose(memtype);
+  }
+
+} // namespace
+
+HDF5Merger::HDF5Merger():
+  file_(-1), configType_(-1), configPlist_(-1), check_config_(true),
+  files_(0), event_index_(false), rebase_ids_(false), next_id_(-1), id_delta_(0)
+{
+}
+
+HDF5Merger::~HDF5Merger()
+{
+  Close();
+}
+
+bool HDF5Merger::Open(std::string filename)
+{
+  Close();
+
+  H5E_BEGIN_TRY {
+    file_ = H5Fcreate(filename.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
+  } H5E_END_TRY;
+
+  if (file_ < 0) {
+    error_ = "cannot create " + filename;
+    return false;
+  }
+
+  std::string group_name = "/MC";
+  H5Gclose(createGroup(file_, group_name));
+  return true;
+}
+
+bool HDF5Merger::Append(std::string filename)
+{
+  if (file_ < 0) {
+    error_ = "the merged file is not open";
+    return false;
+  }
+
+  filename_ = filename;
+
+  hid_t file;
+  H5E_BEGIN_TRY {
+    file = H5Fopen(filename.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
+  } H5E_END_TRY;
+
+  if (file < 0) {
+    error_ = "cannot open " + filename;
+    return false;
+  }
+
+  if (H5Lexists(file, "/MC", H5P_DEFAULT) <= 0) {
+    error_ = filename + " is not a nexus file";
+    H5Fclose(file);
+    return false;
+  }
+
+  std::vector<std::string> paths = tablePaths(file);
+  bool has_strings = contains(paths, "/MC/string_table");
+  bool compact     = contains(paths, "/MC/sns_waveforms");
+
+  // Files are checked before anything of them is written
+  bool ok = CheckLayout(paths);
+
+  if (ok && contains(paths, "/MC/configuration"))
+    ok = ReadConfiguration(file);
+
+  if (ok)
+    ok = EventIdDelta(file, paths);
+
+  // Rows of the merged tables before this file, to re-base row ranges
+  std::map<std::string, hsize_t> offsets;
+  for (auto& table: tables_)
+    offsets[table.first] = table.second.rows;
+
+  std::unordered_map<int, int> string_ids;
+  if (ok && has_strings)
+    ok = AppendStrings(file, string_ids);
+
+  for (size_t i=0; ok && i<paths.size(); i++) {
+    if (paths[i] == "/MC/string_table" || paths[i] == "/MC/configuration")
+      continue;
+    ok = AppendTable(file, paths[i], offsets,
+                     has_strings ? &string_ids : 0, compact);
+  }
+
+  H5Fclose(file);
+
+  files_++;
+  return ok;
+}
+
+bool HDF5Merger::CheckLayout(const std::vector<std::string>& paths)
+{
+  // Row ranges can only be re-based if every file has an event index
+  bool event_index = contains(paths, "/MC/event_index");
+  if (files_ == 0)
+    event_index_ = event_index;
+  else if (event_index != event_index_) {
+    error_ = filename_ + (event_index ? " has" : " has no") +
+      " event index, unlike the files before it";
+    return false;
+  }
+  return true;
+}
+
+bool HDF5Merger::EventIdDelta(hid_t file, const std::vector<std::string>& paths)
+{
+  id_delta_ = 0;
+  if (!rebase_ids_) return true;
+
+  // Every saved event is in the event index, if there is one
+  long long min = INT32_MAX, max = INT32_MIN;
+  for (size_t i=0; i<paths.size(); i++) {
+    if (event_index_ && paths[i] != "/MC/event_index") continue;
+    hid_t dataset = H5Dopen2(file, paths[i].c_str(), H5P_DEFAULT);
+    eventIdRange(dataset, min, max);
+    H5Dclose(dataset);
+  }
+
+  // No events in this file
+  if (min > max) return true;
+
+  // The first file with events keeps its ids
+  if (next_id_ >= 0) id_delta_ = next_id_ - min;
+  next_id_ = max + id_delta_ + 1;
+
+  if (next_id_ - 1 > INT32_MAX) {
+    error_ = "the event ids of " + filename_ + " cannot be re-based "
+      "beyond the largest 32-bit integer";
+    return false;
+  }
+  return true;
+}
+
+HDF5Merger::Table* HDF5Merger::OutputTable(std::string path, hid_t dataset)
+{
+  hid_t type = H5Dget_type(dataset);
+
+  std::map<std::string, Table>::iterator it = tables_.find(path);
+  if (it != tables_.end()) {
+    hid_t merged_type = H5Dget_type(it->second.dataset);
+    bool same = H5Tequal(merged_type, type) > 0;
+    H5Tclose(merged_type);
+    H5Tclose(type);
+    return same ? &it->second : 0;
+  }
+
+  std::string group_name = path.substr(0, path.rfind('/'));
+  if (H5Lexists(file_, group_name.c_str(), H5P_DEFAULT) <= 0)
+    H5Gclose(createGroup(file_, group_name));
+
+  // Same type, chunking and filters as in the input file
+  hid_t plist = H5Dget_create_plist(dataset);
+  hsize_t dims[1] = {0};
+  hsize_t max_dims[1] = {H5S_UNLIMITED};
+  hid_t space = H5Screate_simple(1, dims, max_dims);
+
+  Table table;
+  table.dataset = H5Dcreate2(file_, path.c_str(), type, space,
+                             H5P_DEFAULT, plist, H5P_DEFAULT);
+  table.memtype = H5Tget_native_type(type, H5T_DIR_DEFAULT);
+  table.rows = 0;
+
+  H5Aiterate2(dataset, H5_INDEX_NAME, H5_ITER_INC, NULL,
+              copyAttribute, &table.dataset);
+
+  H5Sclose(space);
+  H5Pclose(plist);
+  H5Tclose(type);
+
+  return &(tables_[path] = table);
+}
+
+bool HDF5Merger::AppendStrings(hid_t file, std::unordered_map<int, int>& ids)
+{
+  hid_t dataset = H5Dopen2(file, "/MC/string_table", H5P_DEFAULT);
+  Table* table = OutputTable("/MC/string_table", dataset);
+  if (!table) {
+    error_ = "/MC/string_table of " + filename_ + " has a different layout";
+    H5Dclose(dataset);
+    return false;
+  }
+
+  hid_t memtype = createStringType();
+  hsize_t nrows = numRows(dataset);
+  std::vector<string_info_t> rows(std::min(nrows, BLOCK_ROWS));
+
+  for (hsize_t first=0; first<nrows; first+=BLOCK_ROWS) {
+    hsize_t count = std::min(BLOCK_ROWS, nrows - first);
+    readRows(rows.data(), count, dataset, memtype, first);
+
+    // New strings get the next id and are kept, the others dropped
+    hsize_t kept = 0;
+    for (hsize_t i=0; i<count; i++) {
+      std::string value(rows[i].value, strnlen(rows[i].value, STRLEN));
+      std::unordered_map<std::string, int>::iterator it = strings_.find(value);
+      if (it != strings_.end()) {
+        ids[rows[i].id] = it->second;
+        continue;
+      }
+      int id = strings_.size();
+      strings_[value] = id;
+      ids[rows[i].id] = id;
+      rows[kept] = rows[i];
+      rows[kept].id = id;
+      kept++;
+    }
+
+    writeRows(rows.data(), kept, table->dataset, memtype, table->rows);
+    table->rows += kept;
+  }
+
+  H5Tclose(memtype);
+  H5Dclose(dataset);
+  return true;
+}
+
+bool HDF5Merger::AppendTable(hid_t file, std::string path,
+                             std::map<std::string, hsize_t>& offsets,
+                             const std::unordered_map<int, int>* string_ids,
+                             bool compact)
+{
+  hid_t dataset = H5Dopen2(file, path.c_str(), H5P_DEFAULT);
+  Table* table = OutputTable(path, dataset);
+  if (!table) {
+    error_ = path + " of " + filename_ + " has a different layout";
+    H5Dclose(dataset);
+    return false;
+  }
+
+  // Row ranges pointing to other tables
+  std::vector<std::pair<std::string, std::string> > ranges;
+  if (path == "/MC/event_index") {
+    std::string sns = compact ? "/MC/sns_waveforms" : "/MC/sns_response";
+    ranges = {{"hits_first", "/MC/hits"}, {"hits_last", "/MC/hits"},
+              {"particles_first", "/MC/particles"},
+              {"particles_last", "/MC/particles"},
+              {"sns_response_first", sns}, {"sns_response_last", sns}};
+    // Files with the digitized sensor response index sns_digits as well
+    if (columnOffset(table->memtype, "sns_digits_first", sizeof(uint64_t)) >= 0) {
+      ranges.push_back({"sns_digits_first", "/MC/sns_digits"});
+      ranges.push_back({"sns_digits_last" , "/MC/sns_digits"});
+    }
+  }
+  else if (path == "/MC/sns_waveforms") {
+    ranges = {{"first", "/MC/sns_samples"}, {"last", "/MC/sns_samples"}};
+  }
+
+  std::vector<Rebase> rebases;
+  for (size_t i=0; i<ranges.size(); i++) {
+    long offset = columnOffset(table->memtype, ranges[i].first.c_str(),
+                               sizeof(uint64_t));
+    if (offset < 0) {
+      error_ = path + " of " + filename_ + " has no column " + ranges[i].first;
+      H5Dclose(dataset);
+      return false;
+    }
+    Rebase rebase = {(size_t) offset, offsets[ranges[i].second]};
+    rebases.push_back(rebase);
+  }
+
+  long id_offset = -1;
+  if (id_delta_ != 0)
+    id_offset = columnOffset(table->memtype, "event_id", sizeof(int32_t));
+
+  std::vector<size_t> string_columns;
+  if (string_ids) {
+    for (const char* column: STRING_COLUMNS) {
+      long offset = columnOffset(table->memtype, column, sizeof(int32_t));
+      if (offset >= 0) string_columns.push_back(offset);
+    }
+  }
+
+  long sensor_offset = -1;
+  if (path == "/MC/sns_positions")
+    sensor_offset = columnOffset(table->memtype, "sensor_id", sizeof(uint32_t));
+
+  size_t rowsize = H5Tget_size(table->memtype);
+  hsize_t nrows = numRows(dataset);
+  std::vector<char> rows(std::min(nrows, BLOCK_ROWS) * rowsize);
+
+  for (hsize_t first=0; first<nrows; first+=BLOCK_ROWS) {
+    hsize_t count = std::min(BLOCK_ROWS, nrows - first);
+    readRows(rows.data(), count, dataset, table->memtype, first);
+
+    hsize_t kept = 0;
+    for (hsize_t i=0; i<count; i++) {
+      char* row = &rows[i * rowsize];
+
+      // Every sensor position is written once
+      if (sensor_offset >= 0) {
+        uint32_t sensor_id;
+        memcpy(&sensor_id, row + sensor_offset, sizeof(sensor_id));
+        if (!sensors_.insert(sensor_id).second) continue;
+      }
+
+      for (size_t j=0; j<rebases.size(); j++) {
+        uint64_t value;
+        memcpy(&value, row + rebases[j].offset, sizeof(value));
+        value += rebases[j].delta;
+        memcpy(row + rebases[j].offset, &value, sizeof(value));
+      }
+
+      if (id_offset >= 0) {
+        int32_t id;
+        memcpy(&id, row + id_offset, sizeof(id));
+        id += id_delta_;
+        memcpy(row + id_offset, &id, sizeof(id));
+      }
+
+      for (size_t j=0; j<string_columns.size(); j++) {
+        int32_t id;
+        memcpy(&id, row + string_columns[j], sizeof(id));
+        std::unordered_map<int, int>::const_iterator it = string_ids->find(id);
+        if (it != string_ids->end()) id = it->second;
+        memcpy(row + string_columns[j], &id, sizeof(id));
+      }
+
+      if (kept != i) memmove(&rows[kept * rowsize], row, rowsize);
+      kept++;
+    }
+
+    writeRows(rows.data(), kept, table->dataset, table->memtype, table->rows);
+    table->rows += kept;
+  }
+
+  H5Dclose(dataset);
+  return true;
+}
+
+bool HDF5Merger::ReadConfiguration(hid_t file)
+{
+  hid_t dataset = H5Dopen2(file, "/MC/configuration", H5P_DEFAULT);
+  hid_t memtype = createRunType();
+
+  std::vector<run_info_t> rows(numRows(dataset));
+  if (!rows.empty())
+    readRows(rows.data(), rows.size(), dataset, memtype, 0);
+
+  // Settings shared by all the files of a production, in a fixed order
+  std::vector<std::pair<std::string, std::string> > settings;
+  for (size_t i=0; i<rows.size(); i++) {
+    std::string key(rows[i].param_key, strnlen(rows[i].param_key, CONFLEN));
+    std::string value(rows[i].param_value, strnlen(rows[i].param_value, CONFLEN));
+    if (!isOneOf(key, PER_FILE))
+      settings.push_back(std::make_pair(key, value));
+  }
+  std::sort(settings.begin(), settings.end());
+
+  bool first = configType_ < 0;
+
+  if (!first && check_config_ && settings != settings_) {
+    size_t i = 0;
+    while (i < settings.size() && i < settings_.size() &&
+           settings[i] == settings_[i]) i++;
+    std::string key = (i < settings_.size()) ? settings_[i].first : settings[i].first;
+    error_ = "the configuration of " + filename_ +
+      " differs from that of the first file in " + key;
+    H5Tclose(memtype);
+    H5Dclose(dataset);
+    return false;
+  }
+
+  for (size_t i=0; i<rows.size(); i++) {
+    std::string key(rows[i].param_key, strnlen(rows[i].param_key, CONFLEN));
+    if (isOneOf(key, COUNTERS))
+      counters_[key] += strtoll(rows[i].param_value, NULL, 10);
+  }
+
+  if (first) {
+    config_ = rows;
+    settings_ = settings;
+    configType_  = H5Dget_type(dataset);
+    configPlist_ = H5Dget_create_plist(dataset);
+  }
+
+  H5Tclose(memtype);
+  H5Dclose(dataset);
+  return true;
+}
+
+void HDF5Merger::Close()
+{
+  if (file_ < 0) return;
+
+  // The configuration of the first file, with the counters of all
+  if (configType_ >= 0) {
+    for (size_t i=0; i<config_.size(); i++) {
+      std::string key(config_[i].param_key, strnlen(config_[i].param_key, CONFLEN));
+      if (isOneOf(key, COUNTERS))
+        snprintf(config_[i].param_value, CONFLEN, "%lld", counters_[key]);
+    }
+
+    hsize_t dims[1] = {0};
+    hsize_t max_dims[1] = {H5S_UNLIMITED};
+    hid_t space = H5Screate_simple(1, dims, max_dims);
+    hid_t dataset = H5Dcreate2(file_, "/MC/configuration", configType_, space,
+                               H5P_DEFAULT, configPlist_, H5P_DEFAULT);
+    hid_t memtype = createRunType();
+    writeRows(config_.data(), config_.size(), dataset, memtype, 0);
+    H5Tclose(memtype);
+    H5Dclose(dataset);
+    H5Sclose(space);
+    H5Tclose(configType_);
+    H5Pclose(configPlist_);
+  }
+
+  for (auto& table: tables_) {
+    H5Tclose(table.second.memtype);
+    H5Dclose(table.second.dataset);
+  }
+
+  H5Fclose(file_);
+
+  file_ = configType_ = configPlist_ = -1;
+  tables_.clear();
+  strings_.clear();
+  sensors_.clear();
+  config_.clear();
+  settings_.clear();
+  counters_.clear();
+  files_ = 0;
+  next_id_ = -1;
+  id_delta_ = 0;
+}
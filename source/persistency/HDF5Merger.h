@@ -0,0 +1,138 @@
+// ----------------------------------------------------------------------------
+// nexus | HDF5Merger.h
+//
+// This class merges nexus h5 output files into one.
+//
+// The NEXT Collaboration
+// ----------------------------------------------------------------------------
+
+#ifndef HDF5MERGER_H
+#define HDF5MERGER_H
+
+#include "hdf5_functions.h"
+
+#include <hdf5.h>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace nexus {
+
+  /// Merges nexus h5 files by appending the rows of every table of each
+  /// file, a block at a time, so that tables of any size are never held
+  /// in memory. Row ranges pointing to other tables (event index and
+  /// compact sensor waveforms) are re-based, string ids are translated
+  /// to those of the merged string table, every sensor position is
+  /// written once and the event counters of the configuration are
+  /// summed up. Files whose configuration differs from that of the
+  /// first one (other than in counters, seeds and output names) are
+  /// refused, and event ids can be re-based so that the events of
+  /// every file follow those of the previous ones.
+
+  class HDF5Merger {
+
+  public:
+    /// constructor
+    HDF5Merger();
+    /// destructor
+    ~HDF5Merger();
+
+    /// create the merged file. Returns false on error.
+    bool Open(std::string filename);
+
+    /// append the tables of a file to the merged one.
+    /// Returns false on error, leaving the merged file incomplete.
+    bool Append(std::string filename);
+
+    /// write the configuration and close the merged file
+    void Close();
+
+    /// shift the event ids of every file to follow those of the
+    /// files appended before it (default: false)
+    void SetRebaseEventIds(bool);
+    /// refuse files whose configuration differs from that of the
+    /// first file (default: true)
+    void SetCheckConfiguration(bool);
+
+    /// description of the last error
+    const std::string& Error() const;
+
+  private:
+    /// A table of the merged file
+    struct Table {
+      hid_t dataset;  ///< HDF5 dataset
+      hid_t memtype;  ///< native type of the rows
+      hsize_t rows;   ///< rows written so far
+    };
+
+    /// A column of 64-bit row numbers and the rows to add to it
+    struct Rebase {
+      size_t offset;  ///< offset of the column in the row
+      hsize_t delta;  ///< rows of the pointed table before this file
+    };
+
+    /// Is the file layout consistent with that of the merged file?
+    bool CheckLayout(const std::vector<std::string>& paths);
+
+    /// Compute the shift of the event ids of a file
+    bool EventIdDelta(hid_t file, const std::vector<std::string>& paths);
+
+    /// Return the merged table with the layout of a table of an input
+    /// file, creating it if needed. Null if the layouts differ.
+    Table* OutputTable(std::string path, hid_t dataset);
+
+    /// Append the strings of a file not seen before to the string
+    /// table, and map their ids in the file to those in the merged one
+    bool AppendStrings(hid_t file, std::unordered_map<int, int>& ids);
+
+    /// Append the rows of a table of a file, translating their row
+    /// ranges, string ids and event ids
+    bool AppendTable(hid_t file, std::string path,
+                     std::map<std::string, hsize_t>& offsets,
+                     const std::unordered_map<int, int>* string_ids,
+                     bool compact);
+
+    /// Keep the configuration of the first file and add up the counters.
+    /// Returns false if the configuration is not compatible.
+    bool ReadConfiguration(hid_t file);
+
+  private:
+    hid_t file_;  ///< merged file
+
+    std::string filename_; ///< file being appended
+    std::string error_;    ///< last error
+
+    std::map<std::string, Table> tables_; ///< merged tables, by path
+
+    std::unordered_map<std::string, int> strings_; ///< string -> merged id
+    std::unordered_set<unsigned int> sensors_;     ///< sensors with position
+
+    std::vector<run_info_t> config_;         ///< configuration of the first file
+    hid_t configType_;                       ///< its type on file
+    hid_t configPlist_;                      ///< and its creation properties
+    std::map<std::string, long long> counters_; ///< event counters summed up
+    /// Settings of the first file, to check those of the others
+    std::vector<std::pair<std::string, std::string> > settings_;
+    bool check_config_; ///< refuse files with a different configuration?
+
+    int files_;          ///< files appended so far
+    bool event_index_;   ///< do the files have an event index?
+    bool rebase_ids_;    ///< shift the event ids of every file?
+    long long next_id_;  ///< first event id free in the merged file
+    long long id_delta_; ///< shift of the event ids of the current file
+  };
+
+
+  // INLINE DEFINITIONS //////////////////////////////////////////////
+
+  inline const std::string& HDF5Merger::Error() const { return error_; }
+
+  inline void HDF5Merger::SetRebaseEventIds(bool rebase) { rebase_ids_ = rebase; }
+
+  inline void HDF5Merger::SetCheckConfiguration(bool check) { check_config_ = check; }
+
+} // namespace nexus
+
+#endif
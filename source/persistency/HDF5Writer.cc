@@ -20,51 +20,153 @@ using namespace nexus;
 
 
 HDF5Writer::HDF5Writer():
-  file_(0), irun_(0), ismp_(0), ihit_(0),
-  ipart_(0), ipos_(0), istep_(0)
+  BaseWriter(), file_(0), group_(0), debugGroup_(0), tables_(),
+  swmr_(false), fileSize_(0),
+  async_(false), maxQueued_(16), stop_(false)
 {
+  // Default chunk sizes keep every chunk below the 1 MB HDF5
+  // chunk cache, so that partially filled chunks can be compressed
+  // in memory. Level 1 deflate with shuffle shrinks the tables by
+  // more than an order of magnitude (mostly repeated strings); higher
+  // levels gain less than 10% in size for twice the CPU time or more.
+  tableOptions_["configuration"] = {   256, 1, true};
+  tableOptions_["sns_response"]  = { 32768, 1, true};
+  tableOptions_["hits"]          = {  4096, 1, true};
+  tableOptions_["particles"]     = {  1024, 1, true};
+  tableOptions_["sns_positions"] = {  1024, 1, true};
+  tableOptions_["steps"]         = {  2048, 1, true};
+  tableOptions_["string_table"]  = {  1024, 1, true};
+  tableOptions_["event_index"]   = {  4096, 1, true};
+  tableOptions_["sns_waveforms"] = { 16384, 1, true};
+  tableOptions_["sns_samples"]   = {131072, 1, true};
+  tableOptions_["sns_digits"]    = { 65536, 1, true};
+
+  // Rows every file needs to be read on its own
+  tables_[SNS_POS_TABLE].keep = true;
+  tables_[STRING_TABLE].keep = true;
 }
 
 HDF5Writer::~HDF5Writer()
 {
+  Close();
 }
 
-void HDF5Writer::Open(std::string fileName, bool debug)
+void HDF5Writer::Open(std::string fileName, bool debug, bool string_ids)
 {
   firstEvent_= true;
+  ResetRows();
+
+  // SWMR needs the latest file format. Closing the file closes
+  // whatever object of it is still open.
+  hid_t fapl = H5Pcreate(H5P_FILE_ACCESS);
+  H5Pset_fclose_degree(fapl, H5F_CLOSE_STRONG);
+  if (swmr_)
+    H5Pset_libver_bounds(fapl, H5F_LIBVER_LATEST, H5F_LIBVER_LATEST);
 
   file_ = H5Fcreate( fileName.c_str(), H5F_ACC_TRUNC,
-                      H5P_DEFAULT, H5P_DEFAULT );
+                      H5P_DEFAULT, fapl );
+  H5Pclose(fapl);
 
   std::string group_name = "/MC";
-  size_t group = createGroup(file_, group_name);
+  group_ = createGroup(file_, group_name);
+  size_t group = group_;
 
   std::string run_table_name = "configuration";
-  memtypeRun_ = createRunType();
-  runTable_ = createTable(group, run_table_name, memtypeRun_);
+  CreateTable(RUN_TABLE, group, run_table_name,
+              createRunType(), sizeof(run_info_t));
 
-  std::string sns_data_table_name = "sns_response";
-  memtypeSnsData_ = createSensorDataType();
-  snsDataTable_ = createTable(group, sns_data_table_name, memtypeSnsData_);
+  if (!compactSns_) {
+    std::string sns_data_table_name = "sns_response";
+    CreateTable(SNS_DATA_TABLE, group, sns_data_table_name,
+                createSensorDataType(), sizeof(sns_data_t));
+  }
+  else {
+    std::string sns_waveform_table_name = "sns_waveforms";
+    CreateTable(SNS_WAVEFORM_TABLE, group, sns_waveform_table_name,
+                createSensorWaveformType(), sizeof(sns_waveform_t));
+    writeStringAttribute(tables_[SNS_WAVEFORM_TABLE].dataset, "encoding",
+                         "time_bin = first_bin + cumsum(sns_samples.bin_delta"
+                         "[first:last]); charges of samples with the same "
+                         "time_bin add up");
+
+    std::string sns_sample_table_name = "sns_samples";
+    CreateTable(SNS_SAMPLE_TABLE, group, sns_sample_table_name,
+                createSensorSampleType(), sizeof(sns_sample_t));
+  }
 
-  std::string hit_info_table_name = "hits";
-  memtypeHitInfo_ = createHitInfoType();
-  hitInfoTable_ = createTable(group, hit_info_table_name, memtypeHitInfo_);
+  if (digitSns_) {
+    std::string sns_digit_table_name = "sns_digits";
+    CreateTable(SNS_DIGIT_TABLE, group, sns_digit_table_name,
+                createSensorDigitType(), sizeof(sns_digit_t));
+  }
 
-  std::string particle_info_table_name = "particles";
-  memtypeParticleInfo_ = createParticleInfoType();
-  particleInfoTable_ = createTable(group, particle_info_table_name, memtypeParticleInfo_);
+  std::string event_index_table_name = "event_index";
+  if (!digitSns_)
+    CreateTable(EVENT_INDEX_TABLE, group, event_index_table_name,
+                createEventIndexType(), sizeof(event_index_t));
+  else
+    CreateTable(EVENT_INDEX_TABLE, group, event_index_table_name,
+                createEventIndexDigitsType(), sizeof(event_index_digits_t));
 
+  std::string hit_info_table_name = "hits";
+  std::string particle_info_table_name = "particles";
   std::string sns_pos_table_name = "sns_positions";
-  memtypeSnsPos_ = createSensorPosType();
-  snsPosTable_ = createTable(group, sns_pos_table_name, memtypeSnsPos_);
+
+  if (!string_ids) {
+    CreateTable(HIT_TABLE, group, hit_info_table_name,
+                createHitInfoType(), sizeof(hit_info_t));
+    CreateTable(PARTICLE_TABLE, group, particle_info_table_name,
+                createParticleInfoType(), sizeof(particle_info_t));
+    CreateTable(SNS_POS_TABLE, group, sns_pos_table_name,
+                createSensorPosType(), sizeof(sns_pos_t));
+  }
+  else {
+    CreateTable(HIT_TABLE, group, hit_info_table_name,
+                createHitInfoIdsType(), sizeof(hit_info_ids_t));
+    CreateTable(PARTICLE_TABLE, group, particle_info_table_name,
+                createParticleInfoIdsType(), sizeof(particle_info_ids_t));
+    CreateTable(SNS_POS_TABLE, group, sns_pos_table_name,
+                createSensorPosIdsType(), sizeof(sns_pos_ids_t));
+
+    std::string string_table_name = "string_table";
+    CreateTable(STRING_TABLE, group, string_table_name,
+                createStringType(), sizeof(string_info_t));
+  }
 
   if (debug) {
     std::string debug_group_name = "/DEBUG";
-    size_t debug_group = createGroup(file_, debug_group_name);
+    debugGroup_ = createGroup(file_, debug_group_name);
+    size_t debug_group = debugGroup_;
     std::string step_table_name = "steps";
-    memtypeStep_ = createStepType();
-    stepTable_   = createTable(debug_group, step_table_name, memtypeStep_);
+    if (!string_ids)
+      CreateTable(STEP_TABLE, debug_group, step_table_name,
+                  createStepType(), sizeof(step_info_t));
+    else
+      CreateTable(STEP_TABLE, debug_group, step_table_name,
+                  createStepIdsType(), sizeof(step_info_ids_t));
+  }
+
+  // Repeat the rows kept from the previous file
+  OutputTable kept_tables[] = {SNS_POS_TABLE, STRING_TABLE};
+  for (OutputTable id: kept_tables) {
+    Table& table = tables_[id];
+    if (table.kept.empty()) continue;
+    table.buffer.swap(table.kept);
+    table.kept.clear();
+    rows_[id] = table.buffer.size() / table.rowsize;
+  }
+
+  // No object can be created from here on in SWMR mode
+#if H5_VERSION_GE(1,10,0)
+  if (swmr_)
+    H5Fstart_swmr_write(file_);
+#endif
+
+  fileSize_ = 0;
+
+  if (async_) {
+    stop_ = false;
+    writer_ = std::thread(&HDF5Writer::WriterLoop, this);
   }
 
   isOpen_ = true;
@@ -72,134 +174,201 @@ void HDF5Writer::Open(std::string fileName, bool debug)
 
 void HDF5Writer::Close()
 {
+  if (!isOpen_) return;
+  Flush();
+
+  // Let the writer thread empty the queue before closing the file
+  if (async_) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    notEmpty_.notify_one();
+    writer_.join();
+  }
+
   isOpen_=false;
+
+  // Release every object of the file, so that it is complete on disk
+  // once closed: the HDF5 cleanup at exit may never run (processes
+  // leave with _exit) or come much later (files rolled over)
+  for (Table& table: tables_) {
+    if (table.dataset) H5Dclose(table.dataset);
+    if (table.memtype) H5Tclose(table.memtype);
+    table.dataset = table.memtype = 0;
+  }
+  if (debugGroup_) H5Gclose(debugGroup_);
+  if (group_) H5Gclose(group_);
+  debugGroup_ = group_ = 0;
+
   H5Fclose(file_);
+  file_ = 0;
+}
+
+void HDF5Writer::Flush()
+{
+  if (!async_) {
+    for (Table& table: tables_)
+      FlushTable(table);
+    return;
+  }
+
+  // Move the buffered rows into a record owned by the writer thread
+  Record record;
+  for (Table& table: tables_) {
+    if (table.buffer.empty()) continue;
+    if (table.keep)
+      table.kept.insert(table.kept.end(),
+                        table.buffer.begin(), table.buffer.end());
+    record.emplace_back();
+    record.back().table = &table;
+    record.back().rows.swap(table.buffer);
+  }
+  Enqueue(record);
 }
 
-void HDF5Writer::WriteRunInfo(const char* param_key, const char* param_value)
-{
-  run_info_t runData;
-  memset(runData.param_key,   0, CONFLEN);
-  memset(runData.param_value, 0, CONFLEN);
-  strcpy(runData.param_key, param_key);
-  strcpy(runData.param_value, param_value);
-  writeRun(&runData, runTable_, memtypeRun_, irun_);
-
-  irun_++;
-}
-
-
-void HDF5Writer::WriteSensorDataInfo(int evt_number, unsigned int sensor_id, unsigned int time_bin, unsigned int charge)
-{
-  sns_data_t snsData;
-  snsData.event_id = evt_number;
-  snsData.sensor_id = sensor_id;
-  snsData.time_bin = time_bin;
-  snsData.charge = charge;
-  writeSnsData(&snsData, snsDataTable_, memtypeSnsData_, ismp_);
-
-  ismp_++;
-}
-
-void HDF5Writer::WriteHitInfo(int evt_number, int particle_indx, int hit_indx, float hit_position_x, float hit_position_y, float hit_position_z, float hit_time, float hit_energy, const char* label)
-{
-  hit_info_t trueInfo;
-  trueInfo.event_id = evt_number;
-  trueInfo.x = hit_position_x;
-  trueInfo.y = hit_position_y;
-  trueInfo.z = hit_position_z;
-  trueInfo.time = hit_time;
-  trueInfo.energy = hit_energy;
-  memset(trueInfo.label, 0, STRLEN);
-  strcpy(trueInfo.label, label);
-  trueInfo.particle_id = particle_indx;
-  trueInfo.hit_id = hit_indx;
-  writeHit(&trueInfo,  hitInfoTable_, memtypeHitInfo_, ihit_);
-
-  ihit_++;
-}
-
-void HDF5Writer::WriteParticleInfo(int evt_number, int particle_indx, const char* particle_name, char primary, int mother_id, float initial_vertex_x, float initial_vertex_y, float initial_vertex_z, float initial_vertex_t, float final_vertex_x, float final_vertex_y, float final_vertex_z, float final_vertex_t, const char* initial_volume, const char* final_volume, float ini_momentum_x, float ini_momentum_y, float ini_momentum_z, float final_momentum_x, float final_momentum_y, float final_momentum_z, float kin_energy, float length, const char* creator_proc, const char* final_proc)
-{
-  particle_info_t trueInfo;
-  trueInfo.event_id = evt_number;
-  trueInfo.particle_id = particle_indx;
-  memset(trueInfo.particle_name, 0, STRLEN);
-  strcpy(trueInfo.particle_name, particle_name);
-  trueInfo.primary = primary;
-  trueInfo.mother_id = mother_id;
-  trueInfo.initial_x = initial_vertex_x;
-  trueInfo.initial_y = initial_vertex_y;
-  trueInfo.initial_z = initial_vertex_z;
-  trueInfo.initial_t = initial_vertex_t;
-  trueInfo.final_x = final_vertex_x;
-  trueInfo.final_y = final_vertex_y;
-  trueInfo.final_z = final_vertex_z;
-  trueInfo.final_t = final_vertex_t;
-  memset(trueInfo.initial_volume, 0, STRLEN);
-  strcpy(trueInfo.initial_volume, initial_volume);
-  memset(trueInfo.final_volume, 0, STRLEN);
-  strcpy(trueInfo.final_volume, final_volume);
-  trueInfo.initial_momentum_x = ini_momentum_x;
-  trueInfo.initial_momentum_y = ini_momentum_y;
-  trueInfo.initial_momentum_z = ini_momentum_z;
-  trueInfo.final_momentum_x = final_momentum_x;
-  trueInfo.final_momentum_y = final_momentum_y;
-  trueInfo.final_momentum_z = final_momentum_z;
-  trueInfo.kin_energy = kin_energy;
-  trueInfo.length = length;
-  memset(trueInfo.creator_proc, 0, STRLEN);
-  strcpy(trueInfo.creator_proc, creator_proc);
-  memset(trueInfo.final_proc, 0, STRLEN);
-  strcpy(trueInfo.final_proc, final_proc);
-  writeParticle(&trueInfo,  particleInfoTable_, memtypeParticleInfo_, ipart_);
-
-  ipart_++;
-}
-
-void HDF5Writer::WriteSensorPosInfo(unsigned int sensor_id, const char* sensor_name, float x, float y, float z)
-{
-  sns_pos_t snsPos;
-  snsPos.sensor_id = sensor_id;
-  memset(snsPos.sensor_name, 0, STRLEN);
-  strcpy(snsPos.sensor_name, sensor_name);
-  snsPos.x = x;
-  snsPos.y = y;
-  snsPos.z = z;
-  writeSnsPos(&snsPos, snsPosTable_, memtypeSnsPos_, ipos_);
-
-  ipos_++;
-}
-
-void HDF5Writer::WriteStep(int evt_number,
-                           int particle_id, const char* particle_name,
-                           int step_id,
-                           const char* initial_volume,
-                           const char*   final_volume,
-                           const char*      proc_name,
-                           float initial_x, float initial_y, float initial_z,
-                           float   final_x, float   final_y, float   final_z)
-{
-  step_info_t step;
-  step.event_id    = evt_number;
-  step.particle_id = particle_id;
-  memset(step.particle_name , 0,  STRLEN);
-  strcpy(step.particle_name ,  particle_name);
-  step.step_id    = step_id;
-  memset(step.initial_volume, 0, STRLEN);
-  strcpy(step.initial_volume, initial_volume);
-  memset(step.  final_volume, 0, STRLEN);
-  strcpy(step.  final_volume,   final_volume);
-  memset(step.     proc_name, 0, STRLEN);
-  strcpy(step.     proc_name,      proc_name);
-  step.initial_x   = initial_x;
-  step.initial_y   = initial_y;
-  step.initial_z   = initial_z;
-  step.  final_x   =   final_x;
-  step.  final_y   =   final_y;
-  step.  final_z   =   final_z;
-
-  writeStep(&step, stepTable_, memtypeStep_, istep_);
-
-  istep_++;
+void HDF5Writer::FlushFile()
+{
+  Flush();
+
+  if (!async_) {
+    H5Fflush(file_, H5F_SCOPE_LOCAL);
+    return;
+  }
+
+  Record record(1);
+  record[0].table = nullptr;
+  Enqueue(record);
+}
+
+bool HDF5Writer::SetSwmr(bool swmr)
+{
+  if (isOpen_) return false;
+#if H5_VERSION_GE(1,10,0)
+  swmr_ = swmr;
+  return true;
+#else
+  swmr_ = false;
+  return !swmr;
+#endif
+}
+
+void HDF5Writer::SetAsync(bool async, size_t max_queued)
+{
+  if (isOpen_) return;
+  async_ = async;
+  maxQueued_ = max_queued > 0 ? max_queued : 1;
+}
+
+bool HDF5Writer::SetChunkSize(std::string table, hsize_t rows)
+{
+  std::map<std::string, table_options_t>::iterator it = tableOptions_.find(table);
+  if (it == tableOptions_.end() || rows == 0) return false;
+  it->second.chunk_size = rows;
+  return true;
+}
+
+bool HDF5Writer::SetDeflateLevel(std::string table, int level)
+{
+  std::map<std::string, table_options_t>::iterator it = tableOptions_.find(table);
+  if (it == tableOptions_.end() || level < 0 || level > 9) return false;
+  it->second.deflate = level;
+  return true;
+}
+
+bool HDF5Writer::SetShuffle(std::string table, bool shuffle)
+{
+  std::map<std::string, table_options_t>::iterator it = tableOptions_.find(table);
+  if (it == tableOptions_.end()) return false;
+  it->second.shuffle = shuffle;
+  return true;
+}
+
+void* HDF5Writer::AllocateRows(OutputTable id, size_t size, size_t nrows)
+{
+  Table& table = tables_[id];
+  if (table.buffer.size() >= table.chunk * table.rowsize)
+    FlushTable(table);
+  table.buffer.resize(table.buffer.size() + nrows * size, 0);
+  return &table.buffer[table.buffer.size() - nrows * size];
+}
+
+void HDF5Writer::CreateTable(OutputTable id, size_t group, std::string table_name,
+                             size_t memtype, size_t rowsize)
+{
+  Table& table = tables_[id];
+  const table_options_t& options = tableOptions_[table_name];
+  table.dataset = createTable(group, table_name, memtype, options);
+  table.memtype = memtype;
+  table.rowsize = rowsize;
+  table.chunk   = options.chunk_size;
+  table.counter = 0;
+  table.buffer.clear();
+  table.buffer.reserve(table.chunk * table.rowsize);
+}
+
+void HDF5Writer::FlushTable(Table& table)
+{
+  if (table.buffer.empty()) return;
+
+  if (table.keep)
+    table.kept.insert(table.kept.end(), table.buffer.begin(), table.buffer.end());
+
+  if (!async_) {
+    WriteBlock(table, table.buffer);
+    table.buffer.clear();
+    return;
+  }
+
+  Record record(1);
+  record[0].table = &table;
+  record[0].rows.swap(table.buffer);
+  Enqueue(record);
+}
+
+void HDF5Writer::WriteBlock(Table& table, const std::vector<char>& rows)
+{
+  size_t nrows = rows.size() / table.rowsize;
+  writeRows(rows.data(), nrows, table.dataset, table.memtype, table.counter);
+  table.counter += nrows;
+
+  hsize_t size = 0;
+  H5Fget_filesize(file_, &size);
+  fileSize_ = size;
+}
+
+void HDF5Writer::Enqueue(Record& record)
+{
+  if (record.empty()) return;
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  // Backpressure: wait for the writer thread if it is falling behind
+  notFull_.wait(lock, [this] { return queue_.size() < maxQueued_; });
+  queue_.push_back(std::move(record));
+  lock.unlock();
+  notEmpty_.notify_one();
+}
+
+void HDF5Writer::WriterLoop()
+{
+  // The writer thread is the only one calling the HDF5 library
+  // between Open() and Close(), so no HDF5 thread-safety is required
+  while (true) {
+    Record record;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      notEmpty_.wait(lock, [this] { return !queue_.empty() || stop_; });
+      if (queue_.empty()) return;
+      record.swap(queue_.front());
+      queue_.pop_front();
+    }
+    notFull_.notify_one();
+
+    for (Block& block: record) {
+      if (block.table)
+        WriteBlock(*block.table, block.rows);
+      else
+        H5Fflush(file_, H5F_SCOPE_LOCAL);
+    }
+  }
 }
@@ -9,14 +9,22 @@
 #ifndef HDF5WRITER_H
 #define HDF5WRITER_H
 
+#include "BaseWriter.h"
 #include "hdf5_functions.h"
 
 #include <hdf5.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
 #include <iostream>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 namespace nexus {
 
-  class HDF5Writer {
+  class HDF5Writer: public BaseWriter {
 
   public:
     /// constructor
@@ -24,56 +32,121 @@ namespace nexus {
     /// destructor
     ~HDF5Writer();
 
-    /// open file
-    void Open(std::string filename, bool debug);
+    /// open file. If string_ids is true, the string columns of
+    /// the tables hold ids of the entries of /MC/string_table.
+    /// The sensor positions and strings written to a previously
+    /// opened file are written again, so that every file is complete.
+    void Open(std::string filename, bool debug, bool string_ids=false);
 
     /// close file
     void Close();
 
-    void WriteRunInfo(const char* param_key, const char* param_value);
-    void WriteSensorDataInfo(int evt_number, unsigned int sensor_id, unsigned int time_bin, unsigned int charge);
-    void WriteHitInfo(int evt_number, int particle_indx, int hit_indx, float hit_position_x, float hit_position_y, float hit_position_z, float hit_time, float hit_energy, const char* label);
-    void WriteParticleInfo(int evt_number, int particle_indx, const char* particle_name, char primary, int mother_id, float initial_vertex_x, float initial_vertex_y, float initial_vertex_z, float initial_vertex_t, float final_vertex_x, float final_vertex_y, float final_vertex_z, float final_vertex_t, const char* initial_volume, const char* final_volume, float ini_momentum_x, float ini_momentum_y, float ini_momentum_z, float final_momentum_x, float final_momentum_y, float final_momentum_z, float kin_energy, float length, const char* creator_proc, const char* final_proc);
-    void WriteSensorPosInfo(unsigned int sensor_id, const char* sensor_name, float x, float y, float z);
-    void WriteStep(int evt_number,
-                   int particle_id, const char* particle_name,
-                   int step_id,
-                   const char* initial_volume,
-                   const char*   final_volume,
-                   const char*      proc_name,
-                   float initial_x, float initial_y, float initial_z,
-                   float   final_x, float   final_y, float   final_z);
+    /// write all buffered rows to file
+    void Flush();
+
+    /// write all buffered rows and flush the file to disk, making
+    /// them visible to SWMR readers
+    void FlushFile();
+
+    /// size in bytes of the file as of the last write; rows still
+    /// buffered, queued for the writer thread or in the HDF5 chunk
+    /// cache are not included
+    size_t FileSize() const;
+
+    /// Storage options of the tables. They only apply to tables
+    /// created afterwards, i.e., they must be set before Open().
+    /// They return false if the table name is unknown.
+    bool SetChunkSize(std::string table, hsize_t rows);
+    bool SetDeflateLevel(std::string table, int level);
+    bool SetShuffle(std::string table, bool shuffle);
+
+    /// Write to file from a background thread. Flush() then hands
+    /// the buffered rows over to the thread, blocking only if more
+    /// than max_queued flushes are still waiting to be written.
+    /// It must be set before Open().
+    void SetAsync(bool async, size_t max_queued);
+
+    /// Open files for single-writer/multiple-reader access, so that
+    /// they can be read while being written (rows become visible on
+    /// FlushFile()). It must be set before Open(). Returns false if
+    /// the HDF5 library does not support it.
+    bool SetSwmr(bool swmr);
+
+  private:
+    /// An output table and the rows waiting to be written to it
+    struct Table {
+      size_t dataset;           ///< HDF5 dataset
+      size_t memtype;           ///< compound type of the rows
+      size_t rowsize;           ///< size of a row in bytes
+      size_t chunk;             ///< rows per chunk, flushed together
+      size_t counter;           ///< rows already written to file
+      std::vector<char> buffer; ///< rows not yet written to file
+      bool keep;                ///< write the rows again in new files?
+      std::vector<char> kept;   ///< rows written to file, if kept
+    };
+
+    /// Rows of a table taken out of its buffer to be written.
+    /// A block without table asks the writer thread to flush the file.
+    struct Block {
+      Table* table;
+      std::vector<char> rows;
+    };
+    /// All the rows handed over to the writer thread in one flush
+    typedef std::vector<Block> Record;
+
+    /// Append zero-initialized rows to the buffer of a table
+    void* AllocateRows(OutputTable table, size_t size, size_t nrows);
+
+    /// Create a table in group using the options set for it
+    void CreateTable(OutputTable table, size_t group, std::string table_name,
+                     size_t memtype, size_t rowsize);
+
+    /// Append the buffered rows of a table to file and empty the buffer
+    void FlushTable(Table& table);
+
+    /// Append rows to a table on file
+    void WriteBlock(Table& table, const std::vector<char>& rows);
+
+    /// Queue a record for the writer thread, waiting for room if needed
+    void Enqueue(Record& record);
+
+    /// Body of the writer thread
+    void WriterLoop();
 
   private:
     size_t file_; ///< HDF5 file
 
-    bool isOpen_;
+    size_t group_;      ///< /MC group
+    size_t debugGroup_; ///< /DEBUG group, if any
+
     bool firstEvent_; ///< First event
 
-    //Datasets
-    size_t runTable_;
-    size_t snsDataTable_;
-    size_t hitInfoTable_;
-    size_t particleInfoTable_;
-    size_t snsPosTable_;
-    size_t stepTable_;
-
-    size_t memtypeRun_;
-    size_t memtypeSnsData_;
-    size_t memtypeHitInfo_;
-    size_t memtypeParticleInfo_;
-    size_t memtypeSnsPos_;
-    size_t memtypeStep_;
-
-    size_t irun_; ///< counter for configuration parameters
-    size_t ismp_; ///< counter for written waveform samples
-    size_t ihit_; ///< counter for true information
-    size_t ipart_; ///< counter for particle information
-    size_t ipos_; ///< counter for sensor positions
-    size_t istep_; ///< counter for steps
+    Table tables_[NUM_TABLES]; ///< output tables
+
+    /// chunking and compression of each table, by name
+    std::map<std::string, table_options_t> tableOptions_;
+
+    bool swmr_; ///< single-writer/multiple-reader access?
+
+    std::atomic<size_t> fileSize_; ///< file size after the last write
+
+    bool async_;       ///< write from a background thread?
+    size_t maxQueued_; ///< maximum number of records waiting in the queue
+    bool stop_;        ///< tells the writer thread to finish
+
+    std::thread writer_;  ///< background writer thread
+    std::mutex mutex_;    ///< protects queue_ and stop_
+    std::condition_variable notEmpty_;
+    std::condition_variable notFull_;
+    std::deque<Record> queue_; ///< records waiting to be written
 
   };
 
+
+  // INLINE DEFINITIONS //////////////////////////////////////////////
+
+  inline size_t HDF5Writer::FileSize() const { return fileSize_; }
+
 } // namespace nexus
 
 #endif
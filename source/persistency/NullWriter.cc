@@ -0,0 +1,46 @@
+// ----------------------------------------------------------------------------
+// nexus | NullWriter.cc
+//
+// This class fills the rows of the output tables and discards them,
+// to measure the simulation throughput without any I/O.
+//
+// The NEXT Collaboration
+// ----------------------------------------------------------------------------
+
+#include "NullWriter.h"
+
+#include <algorithm>
+
+using namespace nexus;
+
+
+NullWriter::NullWriter(): BaseWriter()
+{
+}
+
+NullWriter::~NullWriter()
+{
+}
+
+void NullWriter::Open(std::string, bool, bool)
+{
+  ResetRows();
+  isOpen_ = true;
+}
+
+void NullWriter::Close()
+{
+  isOpen_ = false;
+}
+
+void NullWriter::Flush()
+{
+}
+
+void* NullWriter::AllocateRows(OutputTable table, size_t size, size_t nrows)
+{
+  std::vector<char>& rows = scratch_[table];
+  rows.resize(nrows * size);
+  std::fill(rows.begin(), rows.end(), 0);
+  return rows.data();
+}
@@ -0,0 +1,47 @@
+// ----------------------------------------------------------------------------
+// nexus | NullWriter.h
+//
+// This class fills the rows of the output tables and discards them,
+// to measure the simulation throughput without any I/O.
+//
+// The NEXT Collaboration
+// ----------------------------------------------------------------------------
+
+#ifndef NULL_WRITER_H
+#define NULL_WRITER_H
+
+#include "BaseWriter.h"
+
+#include <vector>
+
+namespace nexus {
+
+  class NullWriter: public BaseWriter
+  {
+  public:
+    /// constructor
+    NullWriter();
+    /// destructor
+    ~NullWriter();
+
+    /// No file is created
+    void Open(std::string filename, bool debug, bool string_ids=false);
+    void Close();
+    void Flush();
+    size_t FileSize() const;
+
+  private:
+    /// Return scratch rows, overwritten by the next rows of the table
+    void* AllocateRows(OutputTable table, size_t size, size_t nrows);
+
+  private:
+    std::vector<char> scratch_[NUM_TABLES]; ///< scratch rows of each table
+  };
+
+  // INLINE DEFINITIONS //////////////////////////////////////////////
+
+  inline size_t NullWriter::FileSize() const { return 0; }
+
+} // namespace nexus
+
+#endif
@@ -13,11 +13,15 @@
 #include "TrajectoryMap.h"
 #include "IonizationSD.h"
 #include "PmtSD.h"
+#include "SensorDigitizer.h"
 #include "NexusApp.h"
 #include "DetectorConstruction.h"
 #include "SaveAllSteppingAction.h"
 #include "BaseGeometry.h"
 #include "HDF5Writer.h"
+#include "NullWriter.h"
+#include "RawWriter.h"
+#include "HDF5Merger.h"
 
 #include <G4GenericMessenger.hh>
 #include <G4Event.hh>
@@ -27,24 +31,47 @@
 #include <G4HCtable.hh>
 #include <G4RunManager.hh>
 #include <G4Run.hh>
+#include <G4UIcommand.hh>
+#include <G4AutoLock.hh>
 
 #include <string>
 #include <sstream>
 #include <iostream>
+#include <iomanip>
 #include <string>
+#include <algorithm>
+#include <cmath>
+#include <tuple>
+#include <cstdio>
 
 using namespace nexus;
 
 
+PersistencyManager* PersistencyManager::master_instance_ = 0;
+
+namespace {
+  /// Serializes the events that worker threads hand over for writing
+  G4Mutex storeMutex = G4MUTEX_INITIALIZER;
+}
+
+
 PersistencyManager::PersistencyManager(G4String init_macro,
                                        std::vector<G4String>& macros,
                                        std::vector<G4String>& delayed_macros):
-  G4VPersistencyManager(), msg_(0), init_macro_(init_macro), macros_(macros),
+  G4VPersistencyManager(), master_(0),
+  msg_(0), init_macro_(init_macro), macros_(macros),
   delayed_macros_(delayed_macros), ready_(false),
   store_evt_(true), store_steps_(false),
   interacting_evt_(false), event_type_("other"), saved_evts_(0),
-  interacting_evts_(0), pmt_bin_size_(-1), sipm_bin_size_(-1),
-  nevt_(0), start_id_(0), first_evt_(true), h5writer_(0)
+  interacting_evts_(0), processed_evts_(0),
+  pmt_bin_size_(-1), sipm_bin_size_(-1),
+  nevt_(0), start_id_(0), first_evt_(true),
+  writer_(0), h5writer_(0), backend_("hdf5"),
+  string_ids_(false), async_writer_(false), async_queue_size_(16),
+  compact_sns_(false), max_file_events_(0), max_file_bytes_(0.),
+  file_index_(0), file_events_(0), processes_(1), process_index_(-1),
+  swmr_(false), flush_interval_(0),
+  voxel_per_track_(true), voxel_time_("min"), digitizer_(0)
 {
   msg_ = new G4GenericMessenger(this, "/nexus/persistency/");
   msg_->DeclareMethod("outputFile", &PersistencyManager::OpenFile, "");
@@ -52,16 +79,104 @@ PersistencyManager::PersistencyManager(G4String init_macro,
                         "Type of event: bb0nu, bb2nu, background.");
   msg_->DeclareProperty("start_id", start_id_,
                         "Starting event ID for this job.");
+  G4GenericMessenger::Command& backend_cmd =
+    msg_->DeclareMethod("backend", &PersistencyManager::SetBackend,
+                        "Output format: hdf5, raw (append-only binary) or null "
+                        "(no output, to measure the simulation alone). Must be "
+                        "set before the output file is opened.");
+  backend_cmd.SetCandidates("hdf5 raw null");
+  msg_->DeclareMethod("string_ids", &PersistencyManager::SetStringIds,
+                      "Write particle, volume, process and sensor names as ids "
+                      "of the /MC/string_table. Must be set before the output "
+                      "file is opened.");
+  msg_->DeclareMethod("compact_sns_response",
+                      &PersistencyManager::SetCompactSensorResponse,
+                      "Write the sensor response as delta-encoded waveforms "
+                      "(/MC/sns_waveforms and /MC/sns_samples). Must be set "
+                      "before the output file is opened.");
+  msg_->DeclareProperty("max_events_per_file", max_file_events_,
+                        "Start a new output file (name_NNNN.h5) after this "
+                        "number of events. 0 means no limit. Must be set "
+                        "before the output file is opened.");
+  msg_->DeclareProperty("max_bytes_per_file", max_file_bytes_,
+                        "Start a new output file (name_NNNN.h5) once the "
+                        "current one reaches this size. 0 means no limit. "
+                        "Must be set before the output file is opened.");
+  msg_->DeclareMethod("swmr", &PersistencyManager::SetSwmr,
+                      "Open the output file for single-writer/multiple-reader "
+                      "access, so that it can be read while the simulation "
+                      "runs (requires HDF5 1.10 readers). Must be set before "
+                      "the output file is opened.");
+  msg_->DeclareProperty("flush_interval", flush_interval_,
+                        "Flush the output file to disk every this number of "
+                        "events, making them visible to SWMR readers. "
+                        "0 means only when the file is closed.");
+  msg_->DeclareMethod("voxel_size", &PersistencyManager::SetVoxelSize,
+                      "Merge the ionization hits of a sensitive detector in "
+                      "cubic voxels of this size: <sdname|all> <size> <unit>. "
+                      "0 stores every step.");
+  msg_->DeclareProperty("voxel_per_track", voxel_per_track_,
+                        "Voxelize the hits of each track separately, keeping "
+                        "the particle_id and hit_id of every hit.");
+  G4GenericMessenger::Command& voxel_time_cmd =
+    msg_->DeclareProperty("voxel_time", voxel_time_,
+                          "Time of a voxel: earliest (min) or energy-weighted "
+                          "mean (mean) time of its hits.");
+  voxel_time_cmd.SetCandidates("min mean");
+  msg_->DeclareMethod("chunk_size", &PersistencyManager::SetChunkSize,
+                      "Rows per chunk of an output table: <table|all> <rows>. "
+                      "Must be set before the output file is opened.");
+  msg_->DeclareMethod("deflate", &PersistencyManager::SetDeflateLevel,
+                      "Gzip level (0-9) of an output table: <table|all> <level>. "
+                      "Must be set before the output file is opened.");
+  msg_->DeclareMethod("shuffle", &PersistencyManager::SetShuffle,
+                      "Byte-shuffle an output table: <table|all> <true|false>. "
+                      "Must be set before the output file is opened.");
+  msg_->DeclareMethod("async_writer", &PersistencyManager::SetAsyncWriter,
+                      "Write the output file from a background thread. "
+                      "Must be set before the output file is opened.");
+  msg_->DeclareProperty("async_queue_size", async_queue_size_,
+                        "Maximum number of events waiting to be written "
+                        "by the background thread.");
+
+  h5writer_ = new HDF5Writer();
+  writer_ = h5writer_;
+
+  digitizer_ = new SensorDigitizer();
 
   secondary_macros_.clear();
+
+  master_instance_ = this;
+}
+
+
+
+PersistencyManager::PersistencyManager(PersistencyManager* master):
+  G4VPersistencyManager(), master_(master),
+  msg_(0), ready_(false),
+  store_evt_(true), store_steps_(false),
+  interacting_evt_(false), event_type_("other"), saved_evts_(0),
+  interacting_evts_(0), processed_evts_(0),
+  pmt_bin_size_(-1), sipm_bin_size_(-1),
+  nevt_(0), start_id_(0), first_evt_(true),
+  writer_(0), h5writer_(0), backend_("hdf5"),
+  string_ids_(false), async_writer_(false), async_queue_size_(16),
+  compact_sns_(false), max_file_events_(0), max_file_bytes_(0.),
+  file_index_(0), file_events_(0), processes_(1), process_index_(-1),
+  swmr_(false), flush_interval_(0),
+  voxel_per_track_(true), voxel_time_("min"), digitizer_(0)
+{
 }
 
 
 
 PersistencyManager::~PersistencyManager()
 {
+  if (master_instance_ == this) master_instance_ = 0;
   delete msg_;
+  if (writer_ != h5writer_) delete writer_;
   delete h5writer_;
+  delete digitizer_;
 }
 
 
@@ -85,13 +200,26 @@ void PersistencyManager::Initialize(G4String init_macro, std::vector<G4String>&
 }
 
 
+void PersistencyManager::InitializeWorker()
+{
+  // Every thread has its own current persistency manager
+  PersistencyManager* current = dynamic_cast<PersistencyManager*>
+    (G4VPersistencyManager::GetPersistencyManager());
+
+  if (!current && master_instance_)
+    current = new PersistencyManager(master_instance_);
+}
+
+
+
 void PersistencyManager::OpenFile(G4String filename)
 {
   // If the output file was not set yet, do so
-  if (!h5writer_) {
-    h5writer_ = new HDF5Writer();
-    G4String hdf5file = filename + ".h5";
-    h5writer_->Open(hdf5file, store_steps_);
+  if (!writer_->IsOpen()) {
+    output_base_ = filename;
+    // Every process opens its own file once the events are split
+    if (processes_ > 1) return;
+    Open();
     return;
   } else {
     G4Exception("[PersistencyManager]", "OpenFile()",
@@ -101,17 +229,370 @@ void PersistencyManager::OpenFile(G4String filename)
 
 
 
+void PersistencyManager::Open()
+{
+  h5writer_->SetAsync(async_writer_, async_queue_size_);
+  writer_->SetCompactSensorResponse(compact_sns_);
+  writer_->SetDigitizedSensorResponse(digitizer_->IsEnabled());
+  if (!h5writer_->SetSwmr(swmr_))
+    G4Exception("[PersistencyManager]", "OpenFile()", JustWarning,
+                "SWMR is not supported by this HDF5 version.");
+  writer_->Open(FileName(), store_steps_, string_ids_);
+}
+
+
+
+void PersistencyManager::SetProcesses(G4int processes)
+{
+  processes_ = processes;
+}
+
+
+
+void PersistencyManager::OpenProcessFile(G4int index, G4int first_event)
+{
+  if (output_base_ == "") return;
+
+  // The process files are merged into one, so they do not roll over
+  if (max_file_events_ > 0 || max_file_bytes_ > 0.) {
+    G4Exception("[PersistencyManager]", "OpenProcessFile()", JustWarning,
+                "Output file rollover is not supported with several "
+                "processes and will be ignored.");
+    max_file_events_ = 0;
+    max_file_bytes_  = 0.;
+  }
+
+  process_index_ = index;
+  start_id_ += first_event;
+  Open();
+}
+
+
+
+void PersistencyManager::MergeProcessFiles()
+{
+  if (output_base_ == "" || backend_ == "null") return;
+
+  std::vector<G4String> parts;
+  for (process_index_=0; process_index_<processes_; process_index_++)
+    parts.push_back(FileName());
+  process_index_ = -1;
+
+  if (backend_ != "hdf5") {
+    G4Exception("[PersistencyManager]", "MergeProcessFiles()", JustWarning,
+                ("Only hdf5 output can be merged. The output of every "
+                 "process is kept in " + output_base_ + ".procNNN.").c_str());
+    return;
+  }
+
+  HDF5Merger merger;
+  G4bool merged = merger.Open(FileName());
+  for (unsigned int i=0; merged && i<parts.size(); i++)
+    merged = merger.Append(parts[i]);
+  merger.Close();
+
+  if (!merged) {
+    G4Exception("[PersistencyManager]", "MergeProcessFiles()", JustWarning,
+                ("The output of the processes could not be merged (" +
+                 merger.Error() + "). It is kept in " + output_base_ +
+                 ".procNNN.").c_str());
+    return;
+  }
+
+  for (unsigned int i=0; i<parts.size(); i++)
+    std::remove(parts[i].c_str());
+}
+
+
+
 void PersistencyManager::CloseFile()
 {
-  if (!h5writer_) return;
+  if (!writer_) return;
+
+  writer_->Close();
+}
+
+
+
+G4String PersistencyManager::FileName() const
+{
+  // With rollover, every file gets its index, including the first one
+  G4String extension = (backend_ == "raw") ? ".raw" : ".h5";
+
+  // Each process writes its own file, merged at the end
+  if (process_index_ >= 0) {
+    std::ostringstream name;
+    name << output_base_ << ".proc" << std::setw(3) << std::setfill('0')
+         << process_index_ << extension;
+    return name.str();
+  }
+
+  if (max_file_events_ <= 0 && max_file_bytes_ <= 0.)
+    return output_base_ + extension;
+
+  std::ostringstream name;
+  name << output_base_ << "_" << std::setw(4) << std::setfill('0')
+       << file_index_ << extension;
+  return name.str();
+}
+
+
+
+G4bool PersistencyManager::FileIsFull() const
+{
+  if (file_events_ == 0) return false;
 
-  h5writer_->Close();
+  if (max_file_events_ > 0 && file_events_ >= max_file_events_)
+    return true;
+
+  if (max_file_bytes_ > 0. && writer_->FileSize() >= max_file_bytes_)
+    return true;
+
+  return false;
+}
+
+
+
+void PersistencyManager::NextFile()
+{
+  // Every file gets the configuration and the event counters of its
+  // own events, so that counters can be summed up over files
+  StoreConfiguration();
+  writer_->Close();
+
+  saved_evts_       = 0;
+  interacting_evts_ = 0;
+  processed_evts_   = 0;
+  file_events_      = 0;
+  file_index_++;
+
+  writer_->Open(FileName(), store_steps_, string_ids_);
+}
+
+
+
+void PersistencyManager::SetStringIds(G4bool string_ids)
+{
+  if (writer_->IsOpen()) {
+    G4Exception("[PersistencyManager]", "SetStringIds()", JustWarning,
+                "The output file is already open. The command will be ignored.");
+    return;
+  }
+  string_ids_ = string_ids;
+}
+
+
+
+void PersistencyManager::SetCompactSensorResponse(G4bool compact)
+{
+  if (writer_->IsOpen()) {
+    G4Exception("[PersistencyManager]", "SetCompactSensorResponse()", JustWarning,
+                "The output file is already open. The command will be ignored.");
+    return;
+  }
+  compact_sns_ = compact;
+}
+
+
+
+void PersistencyManager::SetBackend(G4String backend)
+{
+  if (writer_->IsOpen()) {
+    G4Exception("[PersistencyManager]", "SetBackend()", JustWarning,
+                "The output file is already open. The command will be ignored.");
+    return;
+  }
+
+  BaseWriter* writer = 0;
+  if (backend == "hdf5")
+    writer = h5writer_;
+  else if (backend == "raw")
+    writer = new RawWriter();
+  else if (backend == "null")
+    writer = new NullWriter();
+  else {
+    G4Exception("[PersistencyManager]", "SetBackend()", JustWarning,
+                ("Unknown output backend: " + backend).c_str());
+    return;
+  }
+
+  if (writer_ != h5writer_) delete writer_;
+  writer_  = writer;
+  backend_ = backend;
+}
+
+
+
+void PersistencyManager::SetSwmr(G4bool swmr)
+{
+  if (writer_->IsOpen()) {
+    G4Exception("[PersistencyManager]", "SetSwmr()", JustWarning,
+                "The output file is already open. The command will be ignored.");
+    return;
+  }
+  swmr_ = swmr;
+}
+
+
+
+void PersistencyManager::SetAsyncWriter(G4bool async)
+{
+  if (writer_->IsOpen()) {
+    G4Exception("[PersistencyManager]", "SetAsyncWriter()", JustWarning,
+                "The output file is already open. The command will be ignored.");
+    return;
+  }
+  async_writer_ = async;
+}
+
+
+
+G4int PersistencyManager::StringId(const G4String& str)
+{
+  std::unordered_map<std::string, G4int>::const_iterator it =
+    string_table_.find(str);
+  if (it != string_table_.end()) return it->second;
+
+  G4int id = string_table_.size();
+  string_table_[str] = id;
+  writer_->WriteString(id, str.c_str());
+  return id;
+}
+
+
+
+void PersistencyManager::SetVoxelSize(G4String args)
+{
+  std::istringstream iss(args);
+  G4String sdname, size;
+  iss >> sdname;
+  std::getline(iss, size);
+
+  G4double voxel_size = G4UIcommand::ConvertToDimensionedDouble(size);
+  if (voxel_size < 0.) {
+    G4Exception("[PersistencyManager]", "SetVoxelSize()", JustWarning,
+                "The voxel size cannot be negative.");
+    return;
+  }
+
+  voxel_size_[sdname] = voxel_size;
+}
+
+
+
+G4double PersistencyManager::VoxelSize(const G4String& sdname) const
+{
+  std::map<G4String, G4double>::const_iterator it = voxel_size_.find(sdname);
+  if (it == voxel_size_.end()) it = voxel_size_.find("all");
+  return (it == voxel_size_.end()) ? 0. : it->second;
+}
+
+
+
+void PersistencyManager::SetChunkSize(G4String args)
+{
+  std::istringstream iss(args);
+  G4String table;
+  G4int rows = 0;
+  iss >> table >> rows;
+  if (rows <= 0) {
+    G4Exception("[PersistencyManager]", "SetChunkSize()", JustWarning,
+                "The chunk size must be a positive number of rows.");
+    return;
+  }
+
+  std::vector<G4String> tables = SelectTables(table, "SetChunkSize()");
+  for (unsigned int i=0; i<tables.size(); i++) {
+    if (!h5writer_->SetChunkSize(tables[i], rows))
+      G4Exception("[PersistencyManager]", "SetChunkSize()", JustWarning,
+                  ("Unknown output table '" + tables[i] + "'.").c_str());
+  }
+}
+
+
+
+void PersistencyManager::SetDeflateLevel(G4String args)
+{
+  std::istringstream iss(args);
+  G4String table;
+  G4int level = -1;
+  iss >> table >> level;
+  if (level < 0 || level > 9) {
+    G4Exception("[PersistencyManager]", "SetDeflateLevel()", JustWarning,
+                "The deflate level must be between 0 and 9.");
+    return;
+  }
+
+  std::vector<G4String> tables = SelectTables(table, "SetDeflateLevel()");
+  for (unsigned int i=0; i<tables.size(); i++) {
+    if (!h5writer_->SetDeflateLevel(tables[i], level))
+      G4Exception("[PersistencyManager]", "SetDeflateLevel()", JustWarning,
+                  ("Unknown output table '" + tables[i] + "'.").c_str());
+  }
+}
+
+
+
+void PersistencyManager::SetShuffle(G4String args)
+{
+  std::istringstream iss(args);
+  G4String table, value;
+  iss >> table >> value;
+  G4bool shuffle = G4UIcommand::ConvertToBool(value.c_str());
+
+  std::vector<G4String> tables = SelectTables(table, "SetShuffle()");
+  for (unsigned int i=0; i<tables.size(); i++) {
+    if (!h5writer_->SetShuffle(tables[i], shuffle))
+      G4Exception("[PersistencyManager]", "SetShuffle()", JustWarning,
+                  ("Unknown output table '" + tables[i] + "'.").c_str());
+  }
+}
+
+
+
+std::vector<G4String> PersistencyManager::SelectTables(G4String table,
+                                                       const char* method)
+{
+  std::vector<G4String> tables;
+
+  // Storage options are fixed when the tables are created
+  if (writer_->IsOpen()) {
+    G4Exception("[PersistencyManager]", method, JustWarning,
+                "The output file is already open. Table options will be ignored.");
+    return tables;
+  }
+
+  if (table == "all") {
+    tables = {"configuration", "sns_response", "hits", "particles",
+              "sns_positions", "steps", "string_table", "event_index",
+              "sns_waveforms", "sns_samples", "sns_digits"};
+  } else {
+    tables.push_back(table);
+  }
+
+  return tables;
 }
 
 
 
 G4bool PersistencyManager::Store(const G4Event* event)
 {
+  // Events of worker threads are written by the master instance,
+  // one at a time, with the flags set by the actions of their thread
+  if (master_) {
+    G4AutoLock lock(&storeMutex);
+    master_->store_evt_       = store_evt_;
+    master_->interacting_evt_ = interacting_evt_;
+    G4bool stored = master_->Store(event);
+    StoreCurrentEvent(true);
+    return stored;
+  }
+
+  if (store_evt_ && FileIsFull())
+    NextFile();
+
+  processed_evts_++;
+
   if (interacting_evt_) {
     interacting_evts_++;
   }
@@ -133,6 +614,12 @@ G4bool PersistencyManager::Store(const G4Event* event)
     nevt_ = start_id_;
   }
 
+  // With event seeding, events keep the absolute number their random
+  // state was derived from, so that any of them can be simulated again
+  NexusApp* app = NexusApp::GetInstance();
+  if (app && app->GetEventSeeding())
+    nevt_ = start_id_ + event->GetEventID();
+
   if (store_steps_)
     StoreSteps();
 
@@ -142,7 +629,17 @@ G4bool PersistencyManager::Store(const G4Event* event)
   // Store ionization hits and sensor hits
   StoreHits(event->GetHCofThisEvent());
 
+  writer_->WriteEventIndex(nevt_);
+
   nevt_++;
+  file_events_++;
+
+  // Write the rows buffered for this event in one go,
+  // and make them reach the disk every flush_interval_ events
+  if (flush_interval_ > 0 && file_events_ % flush_interval_ == 0)
+    writer_->FlushFile();
+  else
+    writer_->Flush();
 
   TrajectoryMap::Clear();
   StoreCurrentEvent(true);
@@ -171,8 +668,8 @@ void PersistencyManager::StoreTrajectories(G4TrajectoryContainer* tc)
     G4ThreeVector final_xyz = trj->GetFinalPosition();
     G4double final_t = trj->GetFinalTime();
 
-    G4String ini_volume = trj->GetInitialVolume();
-    G4String final_volume = trj->GetFinalVolume();
+    const G4String& ini_volume = trj->GetInitialVolume();
+    const G4String& final_volume = trj->GetFinalVolume();
 
     G4double mass = trj->GetParticleDefinition()->GetPDGMass();
     G4ThreeVector ini_mom = trj->GetInitialMomentum();
@@ -187,7 +684,28 @@ void PersistencyManager::StoreTrajectories(G4TrajectoryContainer* tc)
     } else {
       mother_id = trj->GetParentID();
     }
-    h5writer_->WriteParticleInfo(nevt_, trackid, trj->GetParticleName().c_str(),
+
+    const G4String& particle_name =
+      trj->GetParticleDefinition()->GetParticleName();
+
+    if (string_ids_) {
+      writer_->WriteParticleInfo(nevt_, trackid, StringId(particle_name),
+                                   primary, mother_id,
+                                   (float)ini_xyz.x(), (float)ini_xyz.y(),
+                                   (float)ini_xyz.z(), (float)ini_t,
+                                   (float)final_xyz.x(), (float)final_xyz.y(),
+                                   (float)final_xyz.z(), (float)final_t,
+                                   StringId(ini_volume), StringId(final_volume),
+                                   (float)ini_mom.x(), (float)ini_mom.y(),
+                                   (float)ini_mom.z(), (float)final_mom.x(),
+                                   (float)final_mom.y(), (float)final_mom.z(),
+                                   kin_energy, length,
+                                   StringId(trj->GetCreatorProcess()),
+                                   StringId(trj->GetFinalProcess()));
+      continue;
+    }
+
+    writer_->WriteParticleInfo(nevt_, trackid, particle_name.c_str(),
 				 primary, mother_id,
 				 (float)ini_xyz.x(), (float)ini_xyz.y(),
                                  (float)ini_xyz.z(), (float)ini_t,
@@ -243,41 +761,141 @@ void PersistencyManager::StoreHits(G4HCofThisEvent* hce)
 
 void PersistencyManager::StoreIonizationHits(G4VHitsCollection* hc)
 {
-  IonizationHitsCollection* hits =
-    dynamic_cast<IonizationHitsCollection*>(hc);
-  if (!hits) return;
+  // Hits stored as objects are copied to the columns of a store,
+  // so that every hit is written from the same arrays
+  const IonizationHitStore* store = dynamic_cast<IonizationHitStore*>(hc);
+  if (!store) {
+    IonizationHitsCollection* hits =
+      dynamic_cast<IonizationHitsCollection*>(hc);
+    if (!hits) return;
+
+    hit_store_.Clear();
+    for (size_t i=0; i<hits->entries(); i++) {
+      IonizationHit* hit = (*hits)[i];
+      hit_store_.Append(hit->GetTrackID(), hit->GetTime(),
+                        hit->GetEnergyDeposit(), hit->GetPosition());
+    }
+    store = &hit_store_;
+  }
 
-  hit_map_.clear();
+  G4String sdname = hc->GetSDname();
+  G4int sdname_id = string_ids_ ? StringId(sdname) : -1;
 
-  double evt_energy = 0.;
-  std::string sdname = hits->GetSDname();
+  G4double voxel_size = VoxelSize(sdname);
+  if (voxel_size > 0.)
+    StoreVoxelizedHits(*store, voxel_size, sdname, sdname_id);
+  else
+    WriteIonizationHits(*store, sdname, sdname_id);
+}
 
-  for (size_t i=0; i<hits->entries(); i++) {
 
-    IonizationHit* hit = dynamic_cast<IonizationHit*>(hits->GetHit(i));
-    if (!hit) continue;
 
-    G4int trackid = hit->GetTrackID();
+void PersistencyManager::WriteIonizationHits(const IonizationHitStore& hits,
+                                             const G4String& sdname,
+                                             G4int sdname_id)
+{
+  const std::vector<G4int>& track_ids = hits.GetTrackIDs();
+
+  // Hits are numbered within their track
+  std::unordered_map<G4int, G4int> track_hits;
+  hit_ids_.resize(track_ids.size());
+  for (size_t i=0; i<track_ids.size(); i++)
+    hit_ids_[i] = track_hits[track_ids[i]]++;
+
+  if (string_ids_)
+    writer_->WriteHits(nevt_, hits.GetSize(), track_ids.data(), hit_ids_.data(),
+                       hits.GetX().data(), hits.GetY().data(), hits.GetZ().data(),
+                       hits.GetTimes().data(), hits.GetEnergyDeposits().data(),
+                       sdname_id);
+  else
+    writer_->WriteHits(nevt_, hits.GetSize(), track_ids.data(), hit_ids_.data(),
+                       hits.GetX().data(), hits.GetY().data(), hits.GetZ().data(),
+                       hits.GetTimes().data(), hits.GetEnergyDeposits().data(),
+                       sdname.c_str());
+}
+
 
-    std::vector<G4int>* ihits = nullptr;
-    std::map<G4int, std::vector<G4int>* >::iterator it = hit_map_.find(trackid);
-    if (it != hit_map_.end()) {
-      ihits = it->second;
-    } else {
-       ihits = new std::vector<G4int>;
-      hit_map_[trackid] = ihits;
+
+void PersistencyManager::StoreVoxelizedHits(const IonizationHitStore& hits,
+                                            G4double voxel_size,
+                                            const G4String& sdname,
+                                            G4int sdname_id)
+{
+  // Hits falling in the same cubic voxel (and, if requested, belonging
+  // to the same track) are merged into a hit at their energy-weighted
+  // centroid, with their total energy. Voxels are stored in the order
+  // of their first hit, and voxels without energy keep its position.
+  struct Voxel {
+    G4int track_id;
+    G4ThreeVector first;    ///< position of the first hit
+    G4ThreeVector position; ///< energy-weighted sum of the positions
+    G4double energy;
+    G4double first_time;    ///< time of the first hit
+    G4double time;          ///< earliest time or energy-weighted sum
+  };
+
+  typedef std::tuple<G4int, G4int, G4int, G4int> VoxelKey;
+  std::map<VoxelKey, size_t> voxel_map;
+  std::vector<Voxel> voxels;
+  std::vector<G4double> max_edep; // largest deposit of each voxel
+
+  G4bool mean_time = (voxel_time_ == "mean");
+
+  const std::vector<G4int>&    track_ids = hits.GetTrackIDs();
+  const std::vector<G4double>& energies  = hits.GetEnergyDeposits();
+  const std::vector<G4double>& times     = hits.GetTimes();
+
+  for (size_t i=0; i<hits.GetSize(); i++) {
+
+    G4ThreeVector xyz(hits.GetX()[i], hits.GetY()[i], hits.GetZ()[i]);
+    G4double edep = energies[i];
+    G4double time = times[i];
+
+    VoxelKey key(voxel_per_track_ ? track_ids[i] : 0,
+                 (G4int) std::floor(xyz.x() / voxel_size),
+                 (G4int) std::floor(xyz.y() / voxel_size),
+                 (G4int) std::floor(xyz.z() / voxel_size));
+
+    std::pair<std::map<VoxelKey, size_t>::iterator, bool> found =
+      voxel_map.insert(std::make_pair(key, voxels.size()));
+
+    if (found.second) {
+      Voxel voxel = {track_ids[i], xyz, edep * xyz, edep,
+                     time, mean_time ? edep * time : time};
+      voxels.push_back(voxel);
+      max_edep.push_back(edep);
+      continue;
     }
 
-    ihits->push_back(1);
+    size_t index = found.first->second;
+    Voxel& voxel = voxels[index];
+    voxel.position += edep * xyz;
+    voxel.energy   += edep;
+    voxel.time      = mean_time ? voxel.time + edep * time
+                                : std::min(voxel.time, time);
+
+    // Without per-track voxels, the voxel goes to the track
+    // that deposited the most energy in a single hit
+    if (edep > max_edep[index]) {
+      max_edep[index] = edep;
+      voxel.track_id  = track_ids[i];
+    }
+  }
 
-    G4ThreeVector xyz = hit->GetPosition();
-    h5writer_->WriteHitInfo(nevt_, trackid,  ihits->size() - 1,
-			    xyz[0], xyz[1], xyz[2],
-			    hit->GetTime(), hit->GetEnergyDeposit(),
-			    sdname.c_str());
+  voxel_store_.Clear();
 
-    evt_energy += hit->GetEnergyDeposit();
+  for (size_t i=0; i<voxels.size(); i++) {
+    const Voxel& voxel = voxels[i];
+    G4ThreeVector xyz = voxel.first;
+    G4double time = mean_time ? voxel.first_time : voxel.time;
+    if (voxel.energy > 0.) {
+      xyz = voxel.position / voxel.energy;
+      if (mean_time) time = voxel.time / voxel.energy;
+    }
+    voxel_store_.Append(voxel.track_id, time, voxel.energy, xyz);
   }
+
+  WriteIonizationHits(voxel_store_, sdname, sdname_id);
 }
 
 
@@ -288,6 +906,7 @@ void PersistencyManager::StorePmtHits(G4VHitsCollection* hc)
   if (!hits) return;
 
   std::string sdname = hits->GetSDname();
+  G4int sdname_id = string_ids_ ? StringId(sdname) : -1;
 
   std::map<G4String, G4double>::const_iterator sensdet_it = sensdet_bin_.find(sdname);
   if (sensdet_it == sensdet_bin_.end()) {
@@ -300,36 +919,43 @@ void PersistencyManager::StorePmtHits(G4VHitsCollection* hc)
     }
   }
 
+  G4bool digitize = digitizer_->IsEnabled(sdname);
+  G4bool store_photons = !digitize || digitizer_->StorePhotons();
+
+  std::vector<std::pair<unsigned int, unsigned int> > samples;
+  std::vector<std::pair<unsigned int, unsigned int> > digits;
+
   for (size_t i=0; i<hits->entries(); i++) {
 
     PmtHit* hit = dynamic_cast<PmtHit*>(hits->GetHit(i));
     if (!hit) continue;
 
     G4ThreeVector xyz = hit->GetPosition();
-    G4double binsize = hit->GetBinSize();
 
-    const std::map<G4double, G4int>& wvfm = hit->GetHistogram();
-    std::map<G4double, G4int>::const_iterator it;
-    std::vector< std::pair<unsigned int,float> > data;
-    G4double amplitude = 0.;
+    hit->GetHistogram(samples);
 
-    for (it = wvfm.begin(); it != wvfm.end(); ++it) {
-      unsigned int time_bin = (unsigned int)((*it).first/binsize+0.5);
-      unsigned int charge = (unsigned int)((*it).second+0.5);
-
-      data.push_back(std::make_pair(time_bin, charge));
-      amplitude = amplitude + (*it).second;
+    if (store_photons) {
+      if (compact_sns_)
+        writer_->WriteSensorWaveform(nevt_, (unsigned int)hit->GetPmtID(),
+                                     samples);
+      else
+        writer_->WriteSensorData(nevt_, (unsigned int)hit->GetPmtID(),
+                                 samples);
+    }
 
-      h5writer_->WriteSensorDataInfo(nevt_, (unsigned int)hit->GetPmtID(),
-                                     time_bin, charge);
+    if (digitize) {
+      digitizer_->Digitize(sdname, samples, hit->GetBinSize(), digits);
+      writer_->WriteSensorDigits(nevt_, (unsigned int)hit->GetPmtID(), digits);
     }
 
-    std::vector<G4int>::iterator pos_it =
-      std::find(sns_posvec_.begin(), sns_posvec_.end(), hit->GetPmtID());
-    if (pos_it == sns_posvec_.end()) {
-      h5writer_->WriteSensorPosInfo((unsigned int)hit->GetPmtID(), sdname.c_str(),
-				    (float)xyz.x(), (float)xyz.y(), (float)xyz.z());
-      sns_posvec_.push_back(hit->GetPmtID());
+    // Write the position of each sensor the first time it is hit
+    if (sns_ids_.insert(hit->GetPmtID()).second) {
+      if (string_ids_)
+        writer_->WriteSensorPosInfo((unsigned int)hit->GetPmtID(), sdname_id,
+                                      (float)xyz.x(), (float)xyz.y(), (float)xyz.z());
+      else
+        writer_->WriteSensorPosInfo((unsigned int)hit->GetPmtID(), sdname.c_str(),
+                                      (float)xyz.x(), (float)xyz.y(), (float)xyz.z());
     }
 
   }
@@ -354,7 +980,20 @@ void PersistencyManager::StoreSteps()
     G4String                   particle_name = key.second;
 
     for (size_t step_id=0; step_id < it->second.size(); ++step_id) {
-      h5writer_->WriteStep(nevt_, track_id, particle_name, step_id,
+      if (string_ids_) {
+        writer_->WriteStep(nevt_, track_id, StringId(particle_name), step_id,
+                             StringId(initial_volumes[key][step_id]),
+                             StringId(  final_volumes[key][step_id]),
+                             StringId(     proc_names[key][step_id]),
+                             initial_poss   [key][step_id].x(),
+                             initial_poss   [key][step_id].y(),
+                             initial_poss   [key][step_id].z(),
+                               final_poss   [key][step_id].x(),
+                               final_poss   [key][step_id].y(),
+                               final_poss   [key][step_id].z());
+        continue;
+      }
+      writer_->WriteStep(nevt_, track_id, particle_name, step_id,
                            initial_volumes[key][step_id],
                              final_volumes[key][step_id],
                                 proc_names[key][step_id],
@@ -370,28 +1009,50 @@ void PersistencyManager::StoreSteps()
 }
 
 G4bool PersistencyManager::Store(const G4Run*)
+{
+  // The configuration is stored once, by the master instance
+  if (master_) return false;
+
+  StoreConfiguration();
+  writer_->Flush();
+
+  return true;
+}
+
+
+
+void PersistencyManager::StoreConfiguration()
 {
   // Store the event type
   G4String key = "event_type";
-  h5writer_->WriteRunInfo(key, event_type_.c_str());
+  writer_->WriteRunInfo(key, event_type_.c_str());
 
-  // Store the number of events to be processed
-  NexusApp* app = (NexusApp*) G4RunManager::GetRunManager();
-  G4int num_events = app->GetNumberOfEventsToBeProcessed();
+  // Store the number of events processed while this file was
+  // open, which add up to those of the job over rolled-over files
+  NexusApp* app = NexusApp::GetInstance();
 
   key = "num_events";
-  h5writer_->WriteRunInfo(key,  std::to_string(num_events).c_str());
+  writer_->WriteRunInfo(key,  std::to_string(processed_evts_).c_str());
   key = "saved_events";
-  h5writer_->WriteRunInfo(key,  std::to_string(saved_evts_).c_str());
+  writer_->WriteRunInfo(key,  std::to_string(saved_evts_).c_str());
   key = "interacting_events";
-  h5writer_->WriteRunInfo(key,  std::to_string(interacting_evts_).c_str());
+  writer_->WriteRunInfo(key,  std::to_string(interacting_evts_).c_str());
+
+  // The seed in use, even if chosen from the system time
+  key = "random_seed";
+  writer_->WriteRunInfo(key,  std::to_string(app->GetRandomSeed()).c_str());
+  key = "event_seeding";
+  writer_->WriteRunInfo(key,  app->GetEventSeeding() ? "1" : "0");
 
   std::map<G4String, G4double>::const_iterator it;
   for (it = sensdet_bin_.begin(); it != sensdet_bin_.end(); ++it) {
-    h5writer_->WriteRunInfo((it->first + "_binning").c_str(),
+    writer_->WriteRunInfo((it->first + "_binning").c_str(),
                            (std::to_string(it->second/microsecond)+" mus").c_str());
   }
 
+  // Macros executed from others are found again while saving them
+  secondary_macros_.clear();
+
   SaveConfigurationInfo(init_macro_);
   for (unsigned long i=0; i<macros_.size(); i++) {
     SaveConfigurationInfo(macros_[i]);
@@ -402,8 +1063,6 @@ G4bool PersistencyManager::Store(const G4Run*)
   for (unsigned long i=0; i<secondary_macros_.size(); i++) {
     SaveConfigurationInfo(secondary_macros_[i]);
   }
-
-  return true;
 }
 
 void PersistencyManager::SaveConfigurationInfo(G4String file_name)
@@ -429,7 +1088,7 @@ void PersistencyManager::SaveConfigurationInfo(G4String file_name)
         if (key[0] == '\n') {
           key.erase(0, 1);
         }
-	h5writer_->WriteRunInfo(key.c_str(), value.c_str());
+	writer_->WriteRunInfo(key.c_str(), value.c_str());
       }
 
       if (found_other_macro != std::string::npos)
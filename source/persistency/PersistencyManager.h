@@ -10,8 +10,12 @@
 #ifndef PERSISTENCY_MANAGER_H
 #define PERSISTENCY_MANAGER_H
 
+#include "IonizationHitStore.h"
+
 #include <G4VPersistencyManager.hh>
 #include <map>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 
@@ -21,8 +25,10 @@ class G4HCofThisEvent;
 class G4VHitsCollection;
 
 namespace nexus {
+  class BaseWriter;
   class HDF5Writer;
   class IonizationHit;
+  class SensorDigitizer;
 }
 
 namespace nexus {
@@ -34,11 +40,19 @@ namespace nexus {
     static void Initialize(G4String init_macro, std::vector<G4String>& macros,
                            std::vector<G4String>& delayed_macros);
 
+    /// Create the persistency manager of a worker thread. It keeps the
+    /// state of the events of the thread and hands them over to the
+    /// instance created by Initialize(), which writes them one at a time.
+    static void InitializeWorker();
+
     /// Set whether to store or not the current event
     void StoreCurrentEvent(G4bool);
     void InteractingEvent(G4bool);
     void StoreSteps(G4bool);
 
+    /// Event ID of the first event of this job
+    G4int GetStartID() const;
+
     ///
     virtual G4bool Store(const G4Event*);
     virtual G4bool Store(const G4Run*);
@@ -52,23 +66,91 @@ namespace nexus {
     void OpenFile(G4String);
     void CloseFile();
 
+    /// Set the number of processes the events are split into.
+    /// With more than one, the output file is not opened by OpenFile(),
+    /// but by OpenProcessFile() in every process.
+    void SetProcesses(G4int);
+    /// Open the output file of one of the processes, whose events
+    /// are numbered from first_event on
+    void OpenProcessFile(G4int index, G4int first_event);
+    /// Merge the output files of the processes into the output file,
+    /// removing them if successful
+    void MergeProcessFiles();
+
 
   private:
     PersistencyManager(G4String init_macro, std::vector<G4String>& macros,
                            std::vector<G4String>& delayed_macros);
     ~PersistencyManager();
     PersistencyManager(const PersistencyManager&);
+    /// Constructor of the persistency manager of a worker thread
+    PersistencyManager(PersistencyManager* master);
 
     void StoreTrajectories(G4TrajectoryContainer*);
     void StoreHits(G4HCofThisEvent*);
     void StoreIonizationHits(G4VHitsCollection*);
     void StorePmtHits(G4VHitsCollection*);
+    /// Store the ionization hits of a sensitive detector, numbering
+    /// them within their track
+    void WriteIonizationHits(const IonizationHitStore&,
+                             const G4String& sdname, G4int sdname_id);
+    /// Merge the ionization hits in voxels and store the voxels as hits
+    void StoreVoxelizedHits(const IonizationHitStore&, G4double voxel_size,
+                            const G4String& sdname, G4int sdname_id);
     void StoreSteps();
 
     void SaveConfigurationInfo(G4String history);
+    /// Write run counters, sensor binning and macros to the configuration
+    void StoreConfiguration();
+
+    /// Open the output file with the options set so far
+    void Open();
+    /// Name of the current output file
+    G4String FileName() const;
+    /// Has the current file reached the events or bytes limit?
+    G4bool FileIsFull() const;
+    /// Close the current file and continue in the next one
+    void NextFile();
+
+    /// Messenger command to replace strings by ids in the output
+    void SetStringIds(G4bool);
+    /// Return the id of a string in the output string table,
+    /// adding it to the table the first time it is seen
+    G4int StringId(const G4String&);
+
+    /// Messenger command to write the sensor response as compact waveforms
+    void SetCompactSensorResponse(G4bool);
+
+    /// Messenger command to set the voxel size of the ionization hits
+    /// of a sensitive detector, or of all of them
+    void SetVoxelSize(G4String);
+    /// Voxel size for the hits of a sensitive detector (0: no voxels)
+    G4double VoxelSize(const G4String& sdname) const;
+
+    /// Messenger command to select the output backend
+    void SetBackend(G4String);
+
+    /// Messenger command to make the output readable while it is written
+    void SetSwmr(G4bool);
+
+    /// Messenger command to write the output from a background thread
+    void SetAsyncWriter(G4bool);
+
+    /// Messenger commands to set the storage options of the tables
+    void SetChunkSize(G4String);
+    void SetDeflateLevel(G4String);
+    void SetShuffle(G4String);
+    /// Names of the tables a storage option applies to ('all' is
+    /// expanded). Empty if the file is already open.
+    std::vector<G4String> SelectTables(G4String table, const char* method);
 
 
   private:
+    /// Instance created by Initialize(), which writes the output
+    static PersistencyManager* master_instance_;
+    /// Instance that writes the events of this one (null if it is itself)
+    PersistencyManager* master_;
+
     G4GenericMessenger* msg_; ///< User configuration messenger
 
     G4String init_macro_;
@@ -85,18 +167,49 @@ namespace nexus {
 
     G4int saved_evts_; ///< number of events to be saved
     G4int interacting_evts_; ///< number of events interacting in ACTIVE
+    G4int processed_evts_; ///< number of events processed for the current file
     G4double pmt_bin_size_, sipm_bin_size_; ///< bin width of sensors
 
     G4int nevt_; ///< Event ID
     G4int start_id_; ///< ID for the first event in file
     G4bool first_evt_; ///< true only for the first event of the run
 
-    HDF5Writer* h5writer_;  ///< Event writer to hdf5 file
+    BaseWriter* writer_;    ///< Event writer of the selected backend
+    HDF5Writer* h5writer_;  ///< Event writer to hdf5 file, holds its options
+    G4String backend_;      ///< Name of the selected backend
 
-    std::map<G4int, std::vector<G4int>* > hit_map_;
-    std::vector<G4int> sns_posvec_;
+    IonizationHitStore hit_store_;   ///< Columns of the IonizationHit objects
+    IonizationHitStore voxel_store_; ///< Columns of the voxelized hits
+    std::vector<G4int> hit_ids_;     ///< Hit number within its track
+    std::unordered_set<G4int> sns_ids_; ///< Sensors whose position was written
 
     std::map<G4String, G4double> sensdet_bin_;
+
+    G4bool string_ids_; ///< Write string columns as ids of the string table?
+    std::unordered_map<std::string, G4int> string_table_; ///< string -> id
+
+    G4bool async_writer_;    ///< Write the output from a background thread?
+    G4int async_queue_size_; ///< Events allowed to wait for the writer thread
+
+    G4bool compact_sns_; ///< Write the sensor response as compact waveforms?
+
+    G4String output_base_;     ///< Output file name without extension
+    G4int max_file_events_;    ///< Events per file before rollover (0: no limit)
+    G4double max_file_bytes_;  ///< File size before rollover (0: no limit)
+    G4int file_index_;         ///< Index of the current file
+    G4int file_events_;        ///< Events stored in the current file
+
+    G4int processes_;     ///< Number of processes the events are split into
+    G4int process_index_; ///< Index of this process (-1: not split)
+
+    G4bool swmr_;          ///< Single-writer/multiple-reader output file?
+    G4int flush_interval_; ///< Events between flushes of the file to disk
+
+    std::map<G4String, G4double> voxel_size_; ///< Voxel size of each SD
+    G4bool voxel_per_track_; ///< Voxelize the hits of each track separately?
+    G4String voxel_time_;    ///< Time of a voxel: min or mean
+
+    SensorDigitizer* digitizer_; ///< Digitization of the sensor response
   };
 
 
@@ -108,6 +221,8 @@ namespace nexus {
   { store_steps_ = ss; }
   inline void PersistencyManager::InteractingEvent(G4bool ie)
   { interacting_evt_ = ie; }
+  inline G4int PersistencyManager::GetStartID() const
+  { return master_ ? master_->start_id_ : start_id_; }
   inline G4bool PersistencyManager::Store(const G4VPhysicalVolume*)
   { return false; }
   inline G4bool PersistencyManager::Retrieve(G4Event*&)
@@ -0,0 +1,109 @@
+// ----------------------------------------------------------------------------
+// nexus | RawWriter.cc
+//
+// This class writes the rows of the output tables to an append-only
+// binary file, trading the HDF5 structure for write speed.
+//
+// The NEXT Collaboration
+// ----------------------------------------------------------------------------
+
+#include "RawWriter.h"
+
+#include <stdint.h>
+
+using namespace nexus;
+
+
+namespace {
+  const char     raw_magic[8]   = {'N','E','X','U','S','R','A','W'};
+  const uint32_t raw_version    = 1;
+  const size_t   max_block_size = 1 << 20; ///< bytes buffered per table
+}
+
+
+RawWriter::RawWriter(): BaseWriter(), fileSize_(0), rowSize_()
+{
+}
+
+RawWriter::~RawWriter()
+{
+  Close();
+}
+
+void RawWriter::Open(std::string fileName, bool debug, bool string_ids)
+{
+  file_.open(fileName.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+
+  uint32_t flags = 0;
+  if (string_ids)  flags |= 1;
+  if (compactSns_) flags |= 2;
+  if (debug)       flags |= 4;
+  if (digitSns_)   flags |= 8;
+
+  file_.write(raw_magic, sizeof(raw_magic));
+  file_.write(reinterpret_cast<const char*>(&raw_version), sizeof(raw_version));
+  file_.write(reinterpret_cast<const char*>(&flags), sizeof(flags));
+  fileSize_ = sizeof(raw_magic) + sizeof(raw_version) + sizeof(flags);
+
+  ResetRows();
+
+  // Repeat the rows kept from the previous file
+  OutputTable kept_tables[] = {SNS_POS_TABLE, STRING_TABLE};
+  for (OutputTable table: kept_tables) {
+    if (kept_[table].empty()) continue;
+    buffers_[table].swap(kept_[table]);
+    kept_[table].clear();
+    rows_[table] = buffers_[table].size() / rowSize_[table];
+  }
+
+  isOpen_ = true;
+}
+
+void RawWriter::Close()
+{
+  if (!isOpen_) return;
+  Flush();
+  isOpen_ = false;
+  file_.close();
+}
+
+void RawWriter::Flush()
+{
+  for (int table=0; table<NUM_TABLES; ++table)
+    WriteBlock(OutputTable(table));
+}
+
+void RawWriter::FlushFile()
+{
+  Flush();
+  file_.flush();
+}
+
+void* RawWriter::AllocateRows(OutputTable table, size_t size, size_t nrows)
+{
+  std::vector<char>& buffer = buffers_[table];
+  if (buffer.size() >= max_block_size)
+    WriteBlock(table);
+  rowSize_[table] = size;
+  buffer.resize(buffer.size() + nrows * size, 0);
+  return &buffer[buffer.size() - nrows * size];
+}
+
+void RawWriter::WriteBlock(OutputTable table)
+{
+  std::vector<char>& buffer = buffers_[table];
+  if (buffer.empty()) return;
+
+  uint32_t header[2] = {uint32_t(table), uint32_t(rowSize_[table])};
+  uint64_t nrows = buffer.size() / rowSize_[table];
+
+  file_.write(reinterpret_cast<const char*>(header), sizeof(header));
+  file_.write(reinterpret_cast<const char*>(&nrows), sizeof(nrows));
+  file_.write(buffer.data(), buffer.size());
+  fileSize_ += sizeof(header) + sizeof(nrows) + buffer.size();
+
+  if (table == SNS_POS_TABLE || table == STRING_TABLE)
+    kept_[table].insert(kept_[table].end(), buffer.begin(), buffer.end());
+
+  buffer.clear();
+}
@@ -0,0 +1,74 @@
+// ----------------------------------------------------------------------------
+// nexus | RawWriter.h
+//
+// This class writes the rows of the output tables to an append-only
+// binary file, trading the HDF5 structure for write speed.
+//
+// The NEXT Collaboration
+// ----------------------------------------------------------------------------
+
+#ifndef RAW_WRITER_H
+#define RAW_WRITER_H
+
+#include "BaseWriter.h"
+
+#include <fstream>
+#include <vector>
+
+namespace nexus {
+
+  /// The file starts with the 8 characters "NEXUSRAW", a uint32 format
+  /// version and a uint32 with flags (1: string ids, 2: compact sensor
+  /// response, 4: steps, 8: digitized sensor response). Then come blocks
+  /// of rows of one table: a uint32 table id (BaseWriter::OutputTable),
+  /// a uint32 row size and a uint64 number of rows, followed by the rows
+  /// with the layout of the structs of hdf5_functions.h, in native byte
+  /// order.
+
+  class RawWriter: public BaseWriter
+  {
+  public:
+    /// constructor
+    RawWriter();
+    /// destructor
+    ~RawWriter();
+
+    /// open file. The sensor positions and strings written to a
+    /// previously opened file are written again.
+    void Open(std::string filename, bool debug, bool string_ids=false);
+
+    /// close file
+    void Close();
+
+    /// write all buffered rows to file
+    void Flush();
+
+    /// write all buffered rows and flush the file to disk
+    void FlushFile();
+
+    /// bytes written to file
+    size_t FileSize() const;
+
+  private:
+    /// Append zero-initialized rows to the buffer of a table
+    void* AllocateRows(OutputTable table, size_t size, size_t nrows);
+
+    /// Write the buffered rows of a table as a block
+    void WriteBlock(OutputTable table);
+
+  private:
+    std::ofstream file_; ///< output file
+    size_t fileSize_;    ///< bytes written to file
+
+    size_t rowSize_[NUM_TABLES];            ///< row size of each table
+    std::vector<char> buffers_[NUM_TABLES]; ///< rows not yet written
+    std::vector<char> kept_[NUM_TABLES];    ///< rows to repeat in new files
+  };
+
+  // INLINE DEFINITIONS //////////////////////////////////////////////
+
+  inline size_t RawWriter::FileSize() const { return fileSize_; }
+
+} // namespace nexus
+
+#endif
@@ -17,6 +17,7 @@ hsize_t createRunType()
   hsize_t memtype = H5Tcreate (H5T_COMPOUND, sizeof (run_info_t));
   H5Tinsert (memtype, "param_key" , HOFFSET (run_info_t, param_key), strtype);
   H5Tinsert (memtype, "param_value" , HOFFSET (run_info_t, param_value), strtype);
+  H5Tclose(strtype);
   return memtype;
 }
 
@@ -49,6 +50,7 @@ hsize_t createHitInfoType()
   H5Tinsert (memtype, "label", HOFFSET (hit_info_t, label), strtype);
   H5Tinsert (memtype, "particle_id", HOFFSET (hit_info_t, particle_id), H5T_NATIVE_INT);
   H5Tinsert (memtype, "hit_id", HOFFSET (hit_info_t, hit_id), H5T_NATIVE_INT);
+  H5Tclose(strtype);
   return memtype;
 }
 
@@ -88,6 +90,8 @@ hsize_t createParticleInfoType()
   H5Tinsert (memtype, "length", HOFFSET (particle_info_t, length), H5T_NATIVE_FLOAT);
   H5Tinsert (memtype, "creator_proc", HOFFSET (particle_info_t, creator_proc), proc_strtype);
   H5Tinsert (memtype, "final_proc", HOFFSET (particle_info_t, final_proc), proc_strtype);
+  H5Tclose(strtype);
+  H5Tclose(proc_strtype);
   return memtype;
 }
 
@@ -104,6 +108,7 @@ hsize_t createSensorPosType()
   H5Tinsert (memtype, "x", HOFFSET (sns_pos_t, x), H5T_NATIVE_FLOAT);
   H5Tinsert (memtype, "y", HOFFSET (sns_pos_t, y), H5T_NATIVE_FLOAT);
   H5Tinsert (memtype, "z", HOFFSET (sns_pos_t, z), H5T_NATIVE_FLOAT);
+  H5Tclose(strtype);
   return memtype;
 }
 
@@ -131,10 +136,177 @@ hsize_t createStepType()
   H5Tinsert (memtype, "final_x"       , HOFFSET(step_info_t, final_x       ), H5T_NATIVE_FLOAT);
   H5Tinsert (memtype, "final_y"       , HOFFSET(step_info_t, final_y       ), H5T_NATIVE_FLOAT);
   H5Tinsert (memtype, "final_z"       , HOFFSET(step_info_t, final_z       ), H5T_NATIVE_FLOAT);
+  H5Tclose(strtype);
+  H5Tclose(proc_strtype);
   return memtype;
 }
 
-hid_t createTable(hid_t group, std::string& table_name, hsize_t memtype)
+hsize_t createSensorWaveformType()
+{
+  //Create compound datatype for the table
+  hsize_t memtype = H5Tcreate (H5T_COMPOUND, sizeof (sns_waveform_t));
+  H5Tinsert (memtype, "event_id", HOFFSET (sns_waveform_t, event_id), H5T_NATIVE_INT32);
+  H5Tinsert (memtype, "sensor_id", HOFFSET (sns_waveform_t, sensor_id), H5T_NATIVE_UINT32);
+  H5Tinsert (memtype, "first_bin", HOFFSET (sns_waveform_t, first_bin), H5T_NATIVE_UINT64);
+  H5Tinsert (memtype, "first", HOFFSET (sns_waveform_t, first), H5T_NATIVE_UINT64);
+  H5Tinsert (memtype, "last", HOFFSET (sns_waveform_t, last), H5T_NATIVE_UINT64);
+  return memtype;
+}
+
+
+hsize_t createSensorSampleType()
+{
+  //Create compound datatype for the table
+  hsize_t memtype = H5Tcreate (H5T_COMPOUND, sizeof (sns_sample_t));
+  H5Tinsert (memtype, "bin_delta", HOFFSET (sns_sample_t, bin_delta), H5T_NATIVE_UINT16);
+  H5Tinsert (memtype, "charge", HOFFSET (sns_sample_t, charge), H5T_NATIVE_UINT16);
+  return memtype;
+}
+
+
+hsize_t createSensorDigitType()
+{
+  //Create compound datatype for the table
+  hsize_t memtype = H5Tcreate (H5T_COMPOUND, sizeof (sns_digit_t));
+  H5Tinsert (memtype, "event_id", HOFFSET (sns_digit_t, event_id), H5T_NATIVE_INT32);
+  H5Tinsert (memtype, "sensor_id", HOFFSET (sns_digit_t, sensor_id), H5T_NATIVE_UINT32);
+  H5Tinsert (memtype, "sample", HOFFSET (sns_digit_t, sample), H5T_NATIVE_UINT32);
+  H5Tinsert (memtype, "adc", HOFFSET (sns_digit_t, adc), H5T_NATIVE_UINT16);
+  return memtype;
+}
+
+
+hsize_t createEventIndexType()
+{
+  //Create compound datatype for the table
+  hsize_t memtype = H5Tcreate (H5T_COMPOUND, sizeof (event_index_t));
+  H5Tinsert (memtype, "event_id", HOFFSET (event_index_t, event_id), H5T_NATIVE_INT32);
+  H5Tinsert (memtype, "hits_first", HOFFSET (event_index_t, hits_first), H5T_NATIVE_UINT64);
+  H5Tinsert (memtype, "hits_last", HOFFSET (event_index_t, hits_last), H5T_NATIVE_UINT64);
+  H5Tinsert (memtype, "particles_first", HOFFSET (event_index_t, particles_first), H5T_NATIVE_UINT64);
+  H5Tinsert (memtype, "particles_last", HOFFSET (event_index_t, particles_last), H5T_NATIVE_UINT64);
+  H5Tinsert (memtype, "sns_response_first", HOFFSET (event_index_t, sns_response_first), H5T_NATIVE_UINT64);
+  H5Tinsert (memtype, "sns_response_last", HOFFSET (event_index_t, sns_response_last), H5T_NATIVE_UINT64);
+  return memtype;
+}
+
+
+hsize_t createEventIndexDigitsType()
+{
+  //Create compound datatype for the table
+  hsize_t memtype = H5Tcreate (H5T_COMPOUND, sizeof (event_index_digits_t));
+  H5Tinsert (memtype, "event_id", HOFFSET (event_index_digits_t, event_id), H5T_NATIVE_INT32);
+  H5Tinsert (memtype, "hits_first", HOFFSET (event_index_digits_t, hits_first), H5T_NATIVE_UINT64);
+  H5Tinsert (memtype, "hits_last", HOFFSET (event_index_digits_t, hits_last), H5T_NATIVE_UINT64);
+  H5Tinsert (memtype, "particles_first", HOFFSET (event_index_digits_t, particles_first), H5T_NATIVE_UINT64);
+  H5Tinsert (memtype, "particles_last", HOFFSET (event_index_digits_t, particles_last), H5T_NATIVE_UINT64);
+  H5Tinsert (memtype, "sns_response_first", HOFFSET (event_index_digits_t, sns_response_first), H5T_NATIVE_UINT64);
+  H5Tinsert (memtype, "sns_response_last", HOFFSET (event_index_digits_t, sns_response_last), H5T_NATIVE_UINT64);
+  H5Tinsert (memtype, "sns_digits_first", HOFFSET (event_index_digits_t, sns_digits_first), H5T_NATIVE_UINT64);
+  H5Tinsert (memtype, "sns_digits_last", HOFFSET (event_index_digits_t, sns_digits_last), H5T_NATIVE_UINT64);
+  return memtype;
+}
+
+
+hsize_t createStringType()
+{
+  hid_t strtype = H5Tcopy(H5T_C_S1);
+  H5Tset_size (strtype, STRLEN);
+
+  //Create compound datatype for the table
+  hsize_t memtype = H5Tcreate (H5T_COMPOUND, sizeof (string_info_t));
+  H5Tinsert (memtype, "id", HOFFSET (string_info_t, id), H5T_NATIVE_INT32);
+  H5Tinsert (memtype, "value", HOFFSET (string_info_t, value), strtype);
+  H5Tclose(strtype);
+  return memtype;
+}
+
+
+hsize_t createHitInfoIdsType()
+{
+  //Create compound datatype for the table
+  hsize_t memtype = H5Tcreate (H5T_COMPOUND, sizeof (hit_info_ids_t));
+  H5Tinsert (memtype, "event_id", HOFFSET (hit_info_ids_t, event_id), H5T_NATIVE_INT32);
+  H5Tinsert (memtype, "x", HOFFSET (hit_info_ids_t, x), H5T_NATIVE_FLOAT);
+  H5Tinsert (memtype, "y", HOFFSET (hit_info_ids_t, y), H5T_NATIVE_FLOAT);
+  H5Tinsert (memtype, "z", HOFFSET (hit_info_ids_t, z), H5T_NATIVE_FLOAT);
+  H5Tinsert (memtype, "time", HOFFSET (hit_info_ids_t, time), H5T_NATIVE_FLOAT);
+  H5Tinsert (memtype, "energy", HOFFSET (hit_info_ids_t, energy), H5T_NATIVE_FLOAT);
+  H5Tinsert (memtype, "label", HOFFSET (hit_info_ids_t, label), H5T_NATIVE_INT32);
+  H5Tinsert (memtype, "particle_id", HOFFSET (hit_info_ids_t, particle_id), H5T_NATIVE_INT);
+  H5Tinsert (memtype, "hit_id", HOFFSET (hit_info_ids_t, hit_id), H5T_NATIVE_INT);
+  return memtype;
+}
+
+
+hsize_t createParticleInfoIdsType()
+{
+  //Create compound datatype for the table
+  hsize_t memtype = H5Tcreate (H5T_COMPOUND, sizeof (particle_info_ids_t));
+  H5Tinsert (memtype, "event_id", HOFFSET (particle_info_ids_t, event_id), H5T_NATIVE_INT32);
+  H5Tinsert (memtype, "particle_id", HOFFSET (particle_info_ids_t, particle_id), H5T_NATIVE_INT);
+  H5Tinsert (memtype, "particle_name", HOFFSET (particle_info_ids_t, particle_name), H5T_NATIVE_INT32);
+  H5Tinsert (memtype, "primary", HOFFSET (particle_info_ids_t, primary), H5T_NATIVE_CHAR);
+  H5Tinsert (memtype, "mother_id", HOFFSET (particle_info_ids_t, mother_id),H5T_NATIVE_INT);
+  H5Tinsert (memtype, "initial_x", HOFFSET (particle_info_ids_t, initial_x), H5T_NATIVE_FLOAT);
+  H5Tinsert (memtype, "initial_y", HOFFSET (particle_info_ids_t, initial_y), H5T_NATIVE_FLOAT);
+  H5Tinsert (memtype, "initial_z", HOFFSET (particle_info_ids_t, initial_z), H5T_NATIVE_FLOAT);
+  H5Tinsert (memtype, "initial_t", HOFFSET (particle_info_ids_t, initial_t), H5T_NATIVE_FLOAT);
+  H5Tinsert (memtype, "final_x", HOFFSET (particle_info_ids_t, final_x), H5T_NATIVE_FLOAT);
+  H5Tinsert (memtype, "final_y", HOFFSET (particle_info_ids_t, final_y), H5T_NATIVE_FLOAT);
+  H5Tinsert (memtype, "final_z", HOFFSET (particle_info_ids_t, final_z), H5T_NATIVE_FLOAT);
+  H5Tinsert (memtype, "final_t", HOFFSET (particle_info_ids_t, final_t), H5T_NATIVE_FLOAT);
+  H5Tinsert (memtype, "initial_volume", HOFFSET (particle_info_ids_t, initial_volume), H5T_NATIVE_INT32);
+  H5Tinsert (memtype, "final_volume", HOFFSET (particle_info_ids_t, final_volume), H5T_NATIVE_INT32);
+  H5Tinsert (memtype, "initial_momentum_x", HOFFSET (particle_info_ids_t, initial_momentum_x), H5T_NATIVE_FLOAT);
+  H5Tinsert (memtype, "initial_momentum_y", HOFFSET (particle_info_ids_t, initial_momentum_y), H5T_NATIVE_FLOAT);
+  H5Tinsert (memtype, "initial_momentum_z", HOFFSET (particle_info_ids_t, initial_momentum_z), H5T_NATIVE_FLOAT);
+  H5Tinsert (memtype, "final_momentum_x", HOFFSET (particle_info_ids_t, final_momentum_x), H5T_NATIVE_FLOAT);
+  H5Tinsert (memtype, "final_momentum_y", HOFFSET (particle_info_ids_t, final_momentum_y), H5T_NATIVE_FLOAT);
+  H5Tinsert (memtype, "final_momentum_z", HOFFSET (particle_info_ids_t, final_momentum_z), H5T_NATIVE_FLOAT);
+  H5Tinsert (memtype, "kin_energy", HOFFSET (particle_info_ids_t, kin_energy), H5T_NATIVE_FLOAT);
+  H5Tinsert (memtype, "length", HOFFSET (particle_info_ids_t, length), H5T_NATIVE_FLOAT);
+  H5Tinsert (memtype, "creator_proc", HOFFSET (particle_info_ids_t, creator_proc), H5T_NATIVE_INT32);
+  H5Tinsert (memtype, "final_proc", HOFFSET (particle_info_ids_t, final_proc), H5T_NATIVE_INT32);
+  return memtype;
+}
+
+
+hsize_t createSensorPosIdsType()
+{
+  //Create compound datatype for the table
+  hsize_t memtype = H5Tcreate (H5T_COMPOUND, sizeof (sns_pos_ids_t));
+  H5Tinsert (memtype, "sensor_id", HOFFSET (sns_pos_ids_t, sensor_id), H5T_NATIVE_UINT);
+  H5Tinsert (memtype, "sensor_name", HOFFSET (sns_pos_ids_t, sensor_name), H5T_NATIVE_INT32);
+  H5Tinsert (memtype, "x", HOFFSET (sns_pos_ids_t, x), H5T_NATIVE_FLOAT);
+  H5Tinsert (memtype, "y", HOFFSET (sns_pos_ids_t, y), H5T_NATIVE_FLOAT);
+  H5Tinsert (memtype, "z", HOFFSET (sns_pos_ids_t, z), H5T_NATIVE_FLOAT);
+  return memtype;
+}
+
+
+hsize_t createStepIdsType()
+{
+  //Create compound datatype for the table
+  hsize_t memtype = H5Tcreate (H5T_COMPOUND, sizeof(step_info_ids_t));
+  H5Tinsert (memtype, "event_id"      , HOFFSET(step_info_ids_t, event_id      ), H5T_NATIVE_INT32);
+  H5Tinsert (memtype, "particle_id"   , HOFFSET(step_info_ids_t, particle_id   ), H5T_NATIVE_INT  );
+  H5Tinsert (memtype, "particle_name" , HOFFSET(step_info_ids_t, particle_name ), H5T_NATIVE_INT32);
+  H5Tinsert (memtype, "step_id"       , HOFFSET(step_info_ids_t, step_id       ), H5T_NATIVE_INT  );
+  H5Tinsert (memtype, "initial_volume", HOFFSET(step_info_ids_t, initial_volume), H5T_NATIVE_INT32);
+  H5Tinsert (memtype, "final_volume"  , HOFFSET(step_info_ids_t, final_volume  ), H5T_NATIVE_INT32);
+  H5Tinsert (memtype, "proc_name"     , HOFFSET(step_info_ids_t, proc_name     ), H5T_NATIVE_INT32);
+  H5Tinsert (memtype, "initial_x"     , HOFFSET(step_info_ids_t, initial_x     ), H5T_NATIVE_FLOAT);
+  H5Tinsert (memtype, "initial_y"     , HOFFSET(step_info_ids_t, initial_y     ), H5T_NATIVE_FLOAT);
+  H5Tinsert (memtype, "initial_z"     , HOFFSET(step_info_ids_t, initial_z     ), H5T_NATIVE_FLOAT);
+  H5Tinsert (memtype, "final_x"       , HOFFSET(step_info_ids_t, final_x       ), H5T_NATIVE_FLOAT);
+  H5Tinsert (memtype, "final_y"       , HOFFSET(step_info_ids_t, final_y       ), H5T_NATIVE_FLOAT);
+  H5Tinsert (memtype, "final_z"       , HOFFSET(step_info_ids_t, final_z       ), H5T_NATIVE_FLOAT);
+  return memtype;
+}
+
+hid_t createTable(hid_t group, std::string& table_name, hsize_t memtype,
+                  const table_options_t& options)
 {
   //Create 1D dataspace (evt number). First dimension is unlimited (initially 0)
   const hsize_t ndims = 1;
@@ -146,17 +318,24 @@ hid_t createTable(hid_t group, std::string& table_name, hsize_t memtype)
   // The layout of the dataset have to be chunked when using unlimited dimensions
   hid_t plist = H5Pcreate(H5P_DATASET_CREATE);
   H5Pset_layout(plist, H5D_CHUNKED);
-  hsize_t chunk_dims[ndims] = {32768};
+  hsize_t chunk_dims[ndims] = {options.chunk_size};
   H5Pset_chunk(plist, ndims, chunk_dims);
 
-  //Set compression
-  //  int clevel = 0;
-  //  H5Pset_deflate (plist, clevel);
+  //Set compression. The shuffle filter must come first in the pipeline
+  //so that deflate sees the bytes of each field grouped together.
+  if (options.deflate > 0 && H5Zfilter_avail(H5Z_FILTER_DEFLATE)) {
+    if (options.shuffle)
+      H5Pset_shuffle(plist);
+    H5Pset_deflate(plist, options.deflate);
+  }
 
   // Create dataset
   hid_t dataset = H5Dcreate(group, table_name.c_str(), memtype, file_space,
                             H5P_DEFAULT, plist, H5P_DEFAULT);
 
+  H5Pclose(plist);
+  H5Sclose(file_space);
+
   return dataset;
 }
 
@@ -169,126 +348,61 @@ hid_t createGroup(hid_t file, std::string& groupName)
   return wfgroup;
 }
 
-void writeRun(run_info_t* runData, hid_t dataset, hid_t memtype, hsize_t counter)
-{
-  hid_t memspace, file_space;
-  hsize_t dims[1] = {1};
-  memspace = H5Screate_simple(1, dims, NULL);
-
-  //Extend dataset
-  dims[0] = counter+1;
-  H5Dset_extent(dataset, dims);
-
-  file_space = H5Dget_space(dataset);
-  hsize_t start[1] = {counter};
-  hsize_t count[1] = {1};
-  H5Sselect_hyperslab(file_space, H5S_SELECT_SET, start, NULL, count, NULL);
-  H5Dwrite(dataset, memtype, memspace, file_space, H5P_DEFAULT, runData);
-  H5Sclose(file_space);
-  H5Sclose(memspace);
-}
-
-
-void writeSnsData(sns_data_t* snsData, hid_t dataset, hid_t memtype, hsize_t counter)
-{
-  hid_t memspace, file_space;
-  //Create memspace for one more row
-  const hsize_t n_dims = 1;
-  hsize_t dims[n_dims] = {1};
-  memspace = H5Screate_simple(n_dims, dims, NULL);
-
-  //Extend dataset
-  dims[0] = counter+1;
-  H5Dset_extent(dataset, dims);
-
-  //Write waveforms
-  file_space = H5Dget_space(dataset);
-  hsize_t start[1] = {counter};
-  hsize_t count[1] = {1};
-  H5Sselect_hyperslab(file_space, H5S_SELECT_SET, start, NULL, count, NULL);
-  H5Dwrite(dataset, memtype, memspace, file_space, H5P_DEFAULT, snsData);
-  H5Sclose(file_space);
-  H5Sclose(memspace);
-}
-
-void writeHit(hit_info_t* hitInfo, hid_t dataset, hid_t memtype, hsize_t counter)
+void writeStringAttribute(hid_t object, const std::string& name,
+                          const std::string& value)
 {
-  hid_t memspace, file_space;
-
-  const hsize_t n_dims = 1;
-  hsize_t dims[n_dims] = {1};
-  memspace = H5Screate_simple(n_dims, dims, NULL);
-
-  dims[0] = counter+1;
-  H5Dset_extent(dataset, dims);
-
-  file_space = H5Dget_space(dataset);
-  hsize_t start[1] = {counter};
-  hsize_t count[1] = {1};
-  H5Sselect_hyperslab(file_space, H5S_SELECT_SET, start, NULL, count, NULL);
-  H5Dwrite(dataset, memtype, memspace, file_space, H5P_DEFAULT, hitInfo);
-  H5Sclose(file_space);
-  H5Sclose(memspace);
+  hid_t strtype = H5Tcopy(H5T_C_S1);
+  H5Tset_size(strtype, value.size() + 1);
+  hid_t space = H5Screate(H5S_SCALAR);
+  hid_t attr = H5Acreate2(object, name.c_str(), strtype, space,
+                          H5P_DEFAULT, H5P_DEFAULT);
+  H5Awrite(attr, strtype, value.c_str());
+  H5Aclose(attr);
+  H5Sclose(space);
+  H5Tclose(strtype);
 }
 
-void writeParticle(particle_info_t* particleInfo, hid_t dataset, hid_t memtype, hsize_t counter)
+void writeRows(const void* rows, hsize_t nrows, hid_t dataset, hid_t memtype, hsize_t counter)
 {
-  hid_t memspace, file_space;
+  if (nrows == 0) return;
 
+  //Create memspace for the whole block of rows
   const hsize_t n_dims = 1;
-  hsize_t dims[n_dims] = {1};
-  memspace = H5Screate_simple(n_dims, dims, NULL);
+  hsize_t dims[n_dims] = {nrows};
+  hid_t memspace = H5Screate_simple(n_dims, dims, NULL);
 
-  dims[0] = counter+1;
+  //Extend dataset once for all of them
+  dims[0] = counter + nrows;
   H5Dset_extent(dataset, dims);
 
-  file_space = H5Dget_space(dataset);
-  hsize_t start[1] = {counter};
-  hsize_t count[1] = {1};
+  hid_t file_space = H5Dget_space(dataset);
+  hsize_t start[n_dims] = {counter};
+  hsize_t count[n_dims] = {nrows};
   H5Sselect_hyperslab(file_space, H5S_SELECT_SET, start, NULL, count, NULL);
-  H5Dwrite(dataset, memtype, memspace, file_space, H5P_DEFAULT, particleInfo);
+  H5Dwrite(dataset, memtype, memspace, file_space, H5P_DEFAULT, rows);
   H5Sclose(file_space);
   H5Sclose(memspace);
 }
 
-void writeSnsPos(sns_pos_t* snsPos, hid_t dataset, hid_t memtype, hsize_t counter)
+hsize_t numRows(hid_t dataset)
 {
-  hid_t memspace, file_space;
-  //Create memspace for one more row
-  const hsize_t n_dims = 1;
-  hsize_t dims[n_dims] = {1};
-  memspace = H5Screate_simple(n_dims, dims, NULL);
-
-  //Extend dataset
-  dims[0] = counter+1;
-  H5Dset_extent(dataset, dims);
-
-  //Write waveforms
-  file_space = H5Dget_space(dataset);
-  hsize_t start[1] = {counter};
-  hsize_t count[1] = {1};
-  H5Sselect_hyperslab(file_space, H5S_SELECT_SET, start, NULL, count, NULL);
-  H5Dwrite(dataset, memtype, memspace, file_space, H5P_DEFAULT, snsPos);
-  H5Sclose(file_space);
-  H5Sclose(memspace);
+  hid_t space = H5Dget_space(dataset);
+  hsize_t dims[1] = {0};
+  H5Sget_simple_extent_dims(space, dims, NULL);
+  H5Sclose(space);
+  return dims[0];
 }
 
-void writeStep(step_info_t* step, hid_t dataset, hid_t memtype, hsize_t counter)
+void readRows(void* rows, hsize_t nrows, hid_t dataset, hid_t memtype, hsize_t first)
 {
-  hid_t memspace, file_space;
-
-  const hsize_t n_dims = 1;
-  hsize_t dims[n_dims] = {1};
-  memspace = H5Screate_simple(n_dims, dims, NULL);
-
-  dims[0] = counter + 1;
-  H5Dset_extent(dataset, dims);
+  if (nrows == 0) return;
 
-  file_space = H5Dget_space(dataset);
-  hsize_t start[1] = {counter};
-  hsize_t count[1] = {1};
+  hsize_t count[1] = {nrows};
+  hsize_t start[1] = {first};
+  hid_t memspace = H5Screate_simple(1, count, NULL);
+  hid_t file_space = H5Dget_space(dataset);
   H5Sselect_hyperslab(file_space, H5S_SELECT_SET, start, NULL, count, NULL);
-  H5Dwrite(dataset, memtype, memspace, file_space, H5P_DEFAULT, step);
+  H5Dread(dataset, memtype, memspace, file_space, H5P_DEFAULT, rows);
   H5Sclose(file_space);
   H5Sclose(memspace);
 }
@@ -91,22 +91,172 @@
     float     final_z;
   } step_info_t;
 
+  // Compact sensor response: one waveform per (event, sensor) pointing
+  // to its samples [first, last) in the sns_samples table. The time bin
+  // of each sample is first_bin plus the running sum of bin_delta.
+  // Samples with the same time bin add up, which is how charges above
+  // 65535 are stored; zero-charge samples only pad time gaps longer
+  // than 65535 bins.
+  typedef struct{
+    int32_t  event_id;
+    uint32_t sensor_id;
+    uint64_t first_bin;
+    uint64_t first;
+    uint64_t last;
+  } sns_waveform_t;
+
+  typedef struct{
+    uint16_t bin_delta;
+    uint16_t charge;
+  } sns_sample_t;
+
+  // Digitized sensor response: the ADC counts of a sample of the
+  // waveform of a sensor, sampled from time zero on
+  typedef struct{
+    int32_t  event_id;
+    uint32_t sensor_id;
+    uint32_t sample;
+    uint16_t adc;
+  } sns_digit_t;
+
+  // Row ranges [first, last) of each saved event in the event tables
+  typedef struct{
+    int32_t  event_id;
+    uint64_t hits_first;
+    uint64_t hits_last;
+    uint64_t particles_first;
+    uint64_t particles_last;
+    uint64_t sns_response_first;
+    uint64_t sns_response_last;
+  } event_index_t;
+
+  // Event index of files with the digitized sensor response,
+  // with the row range of each event in sns_digits as well
+  typedef struct{
+    int32_t  event_id;
+    uint64_t hits_first;
+    uint64_t hits_last;
+    uint64_t particles_first;
+    uint64_t particles_last;
+    uint64_t sns_response_first;
+    uint64_t sns_response_last;
+    uint64_t sns_digits_first;
+    uint64_t sns_digits_last;
+  } event_index_digits_t;
+
+  // Row layouts used when strings are replaced by their id
+  // in the string table (see string_info_t)
+
+  typedef struct{
+    int32_t id;
+    char    value[STRLEN];
+  } string_info_t;
+
+  typedef struct{
+    int32_t event_id;
+    float   x;
+    float   y;
+    float   z;
+    float   time;
+    float   energy;
+    int32_t label;
+    int     particle_id;
+    int     hit_id;
+  } hit_info_ids_t;
+
+  typedef struct{
+    int32_t event_id;
+    int     particle_id;
+    int32_t particle_name;
+    char    primary;
+    int     mother_id;
+    float   initial_x;
+    float   initial_y;
+    float   initial_z;
+    float   initial_t;
+    float   final_x;
+    float   final_y;
+    float   final_z;
+    float   final_t;
+    int32_t initial_volume;
+    int32_t final_volume;
+    float   initial_momentum_x;
+    float   initial_momentum_y;
+    float   initial_momentum_z;
+    float   final_momentum_x;
+    float   final_momentum_y;
+    float   final_momentum_z;
+    float   kin_energy;
+    float   length;
+    int32_t creator_proc;
+    int32_t final_proc;
+  } particle_info_ids_t;
+
+  typedef struct{
+    unsigned int sensor_id;
+    int32_t      sensor_name;
+    float        x;
+    float        y;
+    float        z;
+  } sns_pos_ids_t;
+
+  typedef struct{
+    int32_t event_id;
+    int32_t particle_id;
+    int32_t particle_name;
+    int     step_id;
+    int32_t initial_volume;
+    int32_t   final_volume;
+    int32_t      proc_name;
+    float   initial_x;
+    float   initial_y;
+    float   initial_z;
+    float     final_x;
+    float     final_y;
+    float     final_z;
+  } step_info_ids_t;
+
+  /// Storage layout of a table
+  typedef struct{
+    hsize_t chunk_size; ///< rows per chunk (and per write buffer)
+    int     deflate;    ///< gzip level, 0 means no compression
+    bool    shuffle;    ///< byte-shuffle the rows before compressing
+  } table_options_t;
+
   hsize_t createRunType();
   hsize_t createSensorDataType();
   hsize_t createHitInfoType();
   hsize_t createParticleInfoType();
   hsize_t createSensorPosType();
   hsize_t createStepType();
+  hsize_t createSensorWaveformType();
+  hsize_t createSensorSampleType();
+  hsize_t createSensorDigitType();
+  hsize_t createEventIndexType();
+  hsize_t createEventIndexDigitsType();
+  hsize_t createStringType();
+  hsize_t createHitInfoIdsType();
+  hsize_t createParticleInfoIdsType();
+  hsize_t createSensorPosIdsType();
+  hsize_t createStepIdsType();
 
-  hid_t createTable(hid_t group, std::string& table_name, hsize_t memtype);
+  hid_t createTable(hid_t group, std::string& table_name, hsize_t memtype,
+                    const table_options_t& options);
   hid_t createGroup(hid_t file, std::string& groupName);
 
-  void writeRun(run_info_t* runData, hid_t dataset, hid_t memtype, hsize_t counter);
-  void writeSnsData(sns_data_t* snsData, hid_t dataset, hid_t memtype, hsize_t counter);
-  void writeHit(hit_info_t* hitInfo, hid_t dataset, hid_t memtype, hsize_t counter);
-  void writeParticle(particle_info_t* particleInfo, hid_t dataset, hid_t memtype, hsize_t counter);
-  void writeSnsPos(sns_pos_t* snsPos, hid_t dataset, hid_t memtype, hsize_t counter);
-  void writeStep(step_info_t* step, hid_t dataset, hid_t memtype, hsize_t counter);
+  /// Attach a text attribute to a dataset or group
+  void writeStringAttribute(hid_t object, const std::string& name,
+                            const std::string& value);
+
+  /// Append a block of nrows contiguous rows at position counter
+  /// with a single extend + hyperslab write
+  void writeRows(const void* rows, hsize_t nrows, hid_t dataset, hid_t memtype, hsize_t counter);
+
+  /// Number of rows of a table
+  hsize_t numRows(hid_t dataset);
+
+  /// Read a block of nrows contiguous rows starting at row first
+  void readRows(void* rows, hsize_t nrows, hid_t dataset, hid_t memtype, hsize_t first);
 
 
 #endif
@@ -9,38 +9,94 @@
 #ifndef EL_LOOKUP_TABLE_H
 #define EL_LOOKUP_TABLE_H
 
-#include <G4VUserRegionInformation.hh>
+#include "ELTableFile.h"
+
 #include <G4ThreeVector.hh>
+#include <G4SystemOfUnits.hh>
 #include <globals.hh>
 
-#include <vector>
-#include <map>
-
 
 namespace nexus {
 
-  class ELLookupTable: public G4VUserRegionInformation
+  /// Table of the probabilities of detection of the EL light by every
+  /// sensor, for each point of the EL gap and each of the equal time
+  /// bins of the crossing of the gap (see ELTableFile for the formats).
+  /// Binary tables are mapped read-only and carry their own grid; the
+  /// radius and binning given are those of the grid of text tables.
+  ///
+  /// The points are the centres of the bins of a square grid that lie
+  /// within a circle, numbered column (x) by column from the lowest y.
+  /// Every bin of the grid is mapped once to its point (or, outside the
+  /// circle, to the nearest one), and the entries of all the points are
+  /// stored contiguously, so that a lookup is a few array reads.
+
+  class ELLookupTable
   {
   public:
-    /// Constructor
-    ELLookupTable(G4String);
+    /// Constructor, with the radius of the circle of points
+    /// and the size of the bins of the grid of text tables
+    ELLookupTable(G4String filename, G4double radius=92.5*mm,
+                  G4double binning=5.*mm);
     /// Destructor
     ~ELLookupTable();
 
-    /// Read input files and store their content in the transient table
+    /// Read a table file, binary or text
     void ReadFiles(G4String);
 
-    /// Returns the appropiate sensor map for a given point in the EL gap
-    virtual const std::map<int, std::vector<double> >&
-    GetSensorsMap(const G4ThreeVector&);
+    /// Return the point of the EL gap for a position
+    G4int FindPoint(const G4ThreeVector&) const;
+
+    /// Return the first and one past the last entry of a point
+    size_t GetFirstEntry(G4int point) const;
+    size_t GetLastEntry(G4int point) const;
+    /// Return the total number of entries of the table
+    size_t GetNumberOfEntries() const;
 
+    /// Return the sensor of an entry
+    G4int GetSensorID(size_t entry) const;
+    /// Return the detection probabilities of the time bins of an entry
+    const float* GetProbabilities(size_t entry) const;
+    /// Return the number of time bins of every entry
+    size_t GetNumberOfTimeBins() const;
 
   private:
+    G4double radius_;  ///< Radius of the circle of points of text tables
+    G4double binning_; ///< Size of the bins of the grid of text tables
 
-    std::vector<std::map<int, std::vector<double> > > ELtable_;
+    ELTableFile file_; ///< Contents of the table
 
+    // Arrays of the table, cached for the lookups
+    const uint64_t* offsets_;
+    const int32_t*  sensor_ids_;
+    const float*    probs_;
+    size_t npoints_;
+    size_t nbins_t_;
   };
 
+
+  // INLINE DEFINITIONS //////////////////////////////////////////////
+
+  inline G4int ELLookupTable::FindPoint(const G4ThreeVector& xyz) const
+  { return file_.FindPoint(xyz.x() / mm, xyz.y() / mm); }
+
+  inline size_t ELLookupTable::GetFirstEntry(G4int point) const
+  { return (point >= 0 && (size_t) point < npoints_) ? offsets_[point] : 0; }
+
+  inline size_t ELLookupTable::GetLastEntry(G4int point) const
+  { return (point >= 0 && (size_t) point < npoints_) ? offsets_[point+1] : 0; }
+
+  inline size_t ELLookupTable::GetNumberOfEntries() const
+  { return file_.GetNumberOfEntries(); }
+
+  inline G4int ELLookupTable::GetSensorID(size_t entry) const
+  { return sensor_ids_[entry]; }
+
+  inline const float* ELLookupTable::GetProbabilities(size_t entry) const
+  { return probs_ + entry * nbins_t_; }
+
+  inline size_t ELLookupTable::GetNumberOfTimeBins() const
+  { return nbins_t_; }
+
 } // end namespace nexus
 
 #endif
@@ -1,7 +1,7 @@
 // ----------------------------------------------------------------------------
 // nexus | ELParamSimulation.cc
 //
-// This class (WIP) implements a parametrized simulation .
+// This class implements a parametrized simulation of the EL light.
 //
 // The NEXT Collaboration
 // ----------------------------------------------------------------------------
@@ -10,29 +10,25 @@
 
 #include "ELLookupTable.h"
 #include "IonizationElectron.h"
+#include "UniformElectricDriftField.h"
+#include "PmtSD.h"
 
-#include <G4RunManager.hh>
+#include <G4LogicalVolume.hh>
+#include <G4Poisson.hh>
+#include <Randomize.hh>
 
-#include <TRandom2.h>
-#include <TVector3.h>
+#include <cmath>
+#include <algorithm>
 
 
 
 namespace nexus {
 
 
-  ELParamSimulation::ELParamSimulation(G4Region* region):
+  ELParamSimulation::ELParamSimulation(G4Region* region, ELLookupTable* table):
     G4VFastSimulationModel("ELParamSimulation", region),
-    table_(0)
+    table_(table), sensors_version_(-1)
   {
-    // check whether the region has an EL look-up table attached
-    table_ = dynamic_cast<ELLookupTable*>(region->GetUserInformation());
-    // if (!table_) {
-    //   G4String msg = "ERROR: no EL lookup table attached to the region!";
-    //   G4Exception("[ELParamSimulation]", "ELParamSimulation()",
-    // 		  FatalException, msg);
-    // }
-
   }
 
 
@@ -57,43 +53,86 @@ namespace nexus {
 
 
 
-  void ELParamSimulation::DoIt(const G4FastTrack& ftrack, G4FastStep& /*fstep*/)
+  void ELParamSimulation::DoIt(const G4FastTrack& ftrack, G4FastStep& fstep)
   {
-    // Get spatial coordinates
-    G4ThreeVector position = ftrack.GetPrimaryTrack()->GetPosition();
-
-    G4cout << "position = " << position << G4endl;
-
-
-    //table_->GetSensorsMap()
-
-    //if (HCE_.size() == 0) {
-
-      G4HCofThisEvent* hce =
-	G4RunManager::GetRunManager()->GetCurrentEvent()->GetHCofThisEvent();
-
-      //}
-
-
-    G4cout << "No of collections: " << hce->GetNumberOfCollections() << G4endl;
-
-
-    G4cout << "here" << G4endl;
-
-
-    ///FIXME. Parameters to be put in some other place
-    // G4int fNum_tbins = 5;
-    // G4double fBinWidth = 200.;
-    // G4int gain = 1170;
-
-    // Get track coordinates
-    // ...
+    // No optical photon is tracked: the electron ends here
+    fstep.KillPrimaryTrack();
+
+    const G4Track* track = ftrack.GetPrimaryTrack();
+
+    // The light yield and the crossing time of the gap
+    // come from the drift field of the region
+    UniformElectricDriftField* field = dynamic_cast<UniformElectricDriftField*>
+      (track->GetVolume()->GetLogicalVolume()->GetRegion()->GetUserInformation());
+    if (!field) return;
+
+    G4double gap = std::abs(field->GetCathodePosition() - field->GetAnodePosition());
+    // A clustered track stands for as many electrons as its weight
+    G4double mean = field->LightYield() * gap * std::max(1, G4lrint(track->GetWeight()));
+    if (mean <= 0.) return;
+
+    // Sample the photons emitted like the Electroluminescence process
+    G4double num_photons;
+    if (mean < 10.) // Poissonian regime
+      num_photons = G4Poisson(mean);
+    else            // Gaussian regime
+      num_photons = std::max(0., std::floor(G4RandGauss::shoot(mean, std::sqrt(mean)) + 0.5));
+
+    // The sensors are found at the start of the run
+    if (sensors_version_ != sensors_.GetVersion()) FindSensors();
+
+    G4ThreeVector position = track->GetPosition();
+    G4double time = track->GetGlobalTime();
+    G4double velocity = field->GetDriftVelocity();
+    G4double crossing = (velocity > 0.) ? gap / velocity : 0.;
+
+    // Photoelectrons of every time bin of the crossing,
+    // spread uniformly within the bin
+    size_t nbins = table_->GetNumberOfTimeBins();
+    if (nbins == 0) return;
+    G4double bin_photons = num_photons / nbins;
+    G4double bin_time = crossing / nbins;
+
+    G4int point = table_->FindPoint(position);
+    size_t last = table_->GetLastEntry(point);
+
+    for (size_t entry=table_->GetFirstEntry(point); entry<last; entry++) {
+
+      const SensorMap::Sensor* sensor = entry_sensors_[entry];
+      if (!sensor) continue;
+
+      G4int sensor_id = table_->GetSensorID(entry);
+      const float* probs = table_->GetProbabilities(entry);
+
+      for (size_t k=0; k<nbins; k++) {
+        G4long npe = G4Poisson(bin_photons * probs[k]);
+        for (G4long n=0; n<npe; n++)
+          sensor->sd->AddPhotons(sensor_id, sensor->position,
+                                 time + (k + G4UniformRand()) * bin_time);
+      }
+    }
+  }
 
-    // Ask table for the right sensor map
-    // ...
 
-    // Fill PmtHits according to this map
 
+  void ELParamSimulation::FindSensors()
+  {
+    sensors_version_ = sensors_.GetVersion();
+
+    entry_sensors_.assign(table_->GetNumberOfEntries(), 0);
+    if (sensors_.GetSize() == 0) return;
+
+    // Resolve the sensor of every entry of the table once
+    G4bool missing = false;
+    for (size_t entry=0; entry<entry_sensors_.size(); entry++) {
+      entry_sensors_[entry] = sensors_.Find(table_->GetSensorID(entry));
+      if (!entry_sensors_[entry]) missing = true;
+    }
+
+    if (missing)
+      G4Exception("[ELParamSimulation]", "FindSensors()", JustWarning,
+                  "The EL lookup table has sensors that are not in "
+                  "the geometry. Their light is lost.");
   }
 
 
@@ -1,7 +1,7 @@
 // ----------------------------------------------------------------------------
 // nexus | ELParamSimulation.h
 //
-// This class (WIP) implements a parametrized simulation .
+// This class implements a parametrized simulation of the EL light.
 //
 // The NEXT Collaboration
 // ----------------------------------------------------------------------------
@@ -9,8 +9,9 @@
 #ifndef EL_PARAM_SIMULATION_H
 #define EL_PARAM_SIMULATION_H
 
+#include "SensorMap.h"
+
 #include <G4VFastSimulationModel.hh>
-#include "PmtHit.h"
 #include <vector>
 
 
@@ -18,50 +19,46 @@ namespace nexus {
 
   class ELLookupTable;
 
+  /// Fast simulation of the electroluminescence of the ionization
+  /// electrons reaching an EL region. Instead of generating and tracking
+  /// optical photons, the model samples the number of photons emitted
+  /// across the gap (light yield of the drift field of the region times
+  /// the gap length), looks up the detection probabilities of the
+  /// sensors for the position of the electron and fills the hits of
+  /// their PmtSD with the photoelectrons sampled for every time bin
+  /// of the crossing. The electron is killed.
+
   class ELParamSimulation: public G4VFastSimulationModel
   {
   public:
     /// Constructor
-    ELParamSimulation(G4Region* region);
+    ELParamSimulation(G4Region* region, ELLookupTable* table);
     /// Destructor
     ~ELParamSimulation();
 
     // This model is only valid for ionization electrons
     G4bool IsApplicable(const G4ParticleDefinition&);
 
-    // You have to return "true" when the dynamics conditions to trigger your
-    // parameterisation are fulfilled. The G4FastTrack provides you access to
-    // the current G4Track, gives simple access to envelope related features
-    // (G4LogicalVolume, G4VSolid, G4AffineTransform references between the
-    // global and the envelope local coordinates systems) and simple access to
-    // the position, momentum expressed in the envelope coordinate system.
-    // Using those quantities and the G4VSolid methods, you can for example
-    // easily check how far you are from the envelope boundary.
+    // The light of the electron is simulated as soon as it
+    // enters the EL region
     G4bool ModelTrigger(const G4FastTrack &);
 
-    // Your parameterisation properly said. The G4FastTrack reference provides
-    // input informations. The final state of the particles after parameterisation
-    // has to be returned through the G4FastStep reference. This final state is
-    // described has "requests" the tracking will apply after your
-    // parameterisation has been invoked.
+    // Fill the sensor hits with the EL light of the electron
+    // and kill it
     void DoIt(const G4FastTrack&, G4FastStep&);
 
-    //To load EL table
-    // void ReadELTable(const char* filename,
-    // 		     std::map<int, std::map<int, std::vector<double> > >& eltable);
-
-
   private:
-    //BaseELGrid* elgrid_;
-    // std::map<G4int, std::map<G4int, std::vector<G4double> > >  eltable_;
+    /// Find the sensor of every entry of the table
+    /// in the sensors of the geometry
+    void FindSensors();
 
-    // bool timebinning_;
-    // int num_tbins_;
-
-    ELLookupTable* table_;
-
-    std::vector<PmtHitsCollection*> HCE_;
+  private:
+    ELLookupTable* table_; ///< Detection probabilities (not owned)
 
+    SensorMap sensors_; ///< Sensors of the geometry
+    std::vector<const SensorMap::Sensor*> entry_sensors_; ///< Sensor of every entry
+                                                          ///< of the table (0: missing)
+    G4int sensors_version_; ///< Version of the sensors of entry_sensors_
   };
 
 } // end namespace nexus
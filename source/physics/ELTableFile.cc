@@ -0,0 +1,371 @@
+// ----------------------------------------------------------------------------
+// nexus | ELTableFile.cc
+//
+// This class reads and writes the files of the EL lookup tables.
+//
+// The NEXT Collaboration
+// ----------------------------------------------------------------------------
+
+#include "ELTableFile.h"
+
+#include <fstream>
+#include <sstream>
+#include <cstring>
+
+
+
+namespace nexus {
+
+
+  const char ELTableFile::MAGIC[8] = {'N', 'X', 'E', 'L', 'T', 'A', 'B', 'L'};
+  const uint32_t ELTableFile::VERSION;
+
+
+
+  ELTableFile::ELTableFile():
+    radius_(0.), binning_(0.), nbins_xy_(0), npoints_xy_(0),
+    npoints_(0), nentries_(0), nbins_t_(0),
+    offsets_(0), sensor_ids_(0), probs_(0)
+  {
+  }
+
+
+
+  ELTableFile::~ELTableFile()
+  {
+    Clear();
+  }
+
+
+
+  bool ELTableFile::IsBinary(const std::string& filename)
+  {
+    std::ifstream file(filename, std::ios::binary);
+    char magic[sizeof(MAGIC)];
+    if (!file.read(magic, sizeof(magic))) return false;
+    return std::memcmp(magic, MAGIC, sizeof(MAGIC)) == 0;
+  }
+
+
+
+  bool ELTableFile::ReadText(const std::string& filename, double radius,
+                             double binning)
+  {
+    if (!Reset(radius, binning)) return false;
+
+    std::ifstream file(filename);
+    if (!file.is_open()) {
+      error_ = "cannot open " + filename;
+      return false;
+    }
+
+    // Header lines start with '*'. Every other non-blank line holds
+    // the point id, the sensor id and the probabilities of the time
+    // bins; a line that does not is an error, not a row to drop.
+    std::string line;
+    std::vector<float> probs;
+    int line_number = 0;
+
+    while (std::getline(file, line)) {
+
+      line_number++;
+      if (line.find_first_not_of(" \t\r") == std::string::npos ||
+          line[0] == '*') continue;
+
+      std::istringstream iss(line);
+      int point_id, sensor_id;
+      bool ok = static_cast<bool>(iss >> point_id >> sensor_id);
+
+      probs.clear();
+      float prob;
+      while (ok && iss >> prob) probs.push_back(prob);
+
+      // Something else than a number stopped the reading
+      if (!ok || !iss.eof() || probs.empty()) {
+        std::ostringstream msg;
+        msg << filename << ":" << line_number << ": malformed line";
+        error_ = msg.str();
+        return false;
+      }
+
+      if (!AddEntry(point_id, sensor_id, probs)) {
+        std::ostringstream msg;
+        msg << filename << ":" << line_number << ": " << error_;
+        error_ = msg.str();
+        return false;
+      }
+    }
+
+    Finish();
+    return true;
+  }
+
+
+
+  bool ELTableFile::Map(const std::string& filename)
+  {
+    Clear();
+
+    Header header;
+    if (!binary_.Open(filename, MAGIC, &header, sizeof(header), "EL table")) {
+      error_ = binary_.Error();
+      return false;
+    }
+
+    if (header.version != VERSION) {
+      binary_.Clear();
+      std::ostringstream msg;
+      msg << filename << " has version " << header.version
+          << " of the EL table format, expected " << VERSION;
+      error_ = msg.str();
+      return false;
+    }
+
+    if (!binary_.Map(header.npoints, header.nentries, header.nbins_t)) {
+      error_ = binary_.Error();
+      return false;
+    }
+
+    if (!BuildGrid(header.radius, header.binning)) {
+      Clear();
+      error_ = filename + ": " + error_;
+      return false;
+    }
+
+    npoints_ = header.npoints;
+    nentries_ = header.nentries;
+    nbins_t_ = header.nbins_t;
+
+    offsets_ = binary_.GetOffsets();
+    sensor_ids_ = binary_.GetSensorIDs();
+    probs_ = binary_.GetProbabilities();
+
+    return true;
+  }
+
+
+
+  bool ELTableFile::Reset(double radius, double binning)
+  {
+    Clear();
+    return BuildGrid(radius, binning);
+  }
+
+
+
+  bool ELTableFile::AddEntry(int point, int sensor_id,
+                             const std::vector<float>& probs)
+  {
+    if (point < 0) {
+      error_ = "negative point id";
+      return false;
+    }
+
+    if (new_points_.empty()) nbins_t_ = probs.size();
+
+    if (probs.size() != nbins_t_) {
+      error_ = "all the entries must have the same number of time bins";
+      return false;
+    }
+
+    new_points_.push_back(point);
+    new_sensors_.push_back(sensor_id);
+    new_probs_.insert(new_probs_.end(), probs.begin(), probs.end());
+    return true;
+  }
+
+
+
+  void ELTableFile::Finish()
+  {
+    Compress(new_points_, new_sensors_, new_probs_);
+
+    std::vector<int>().swap(new_points_);
+    std::vector<int32_t>().swap(new_sensors_);
+    std::vector<float>().swap(new_probs_);
+  }
+
+
+
+  bool ELTableFile::Write(const std::string& filename) const
+  {
+    Header header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version  = VERSION;
+    header.nbins_t  = nbins_t_;
+    header.radius   = radius_;
+    header.binning  = binning_;
+    header.npoints  = npoints_;
+    header.nentries = nentries_;
+
+    return LightTableFile::Write(filename, &header, sizeof(header),
+                                 offsets_, npoints_, sensor_ids_, nentries_,
+                                 probs_, nbins_t_, error_);
+  }
+
+
+
+  bool ELTableFile::BuildGrid(double radius, double binning)
+  {
+    if (!(radius > 0.) || !(binning > 0.)) {
+      error_ = "the radius and the binning of the grid must be positive";
+      return false;
+    }
+
+    radius_ = radius;
+    binning_ = binning;
+
+    /// The EL points must be in the middle of the bins.
+    int maxidx = radius_*2./binning_ + 1;
+    nbins_xy_ = maxidx;
+
+    /// If the number of bins per axis is odd, a different math must be applied
+    bool even = (maxidx % 2 == 0);
+
+    /// Coordinates of the center of bins (they are the same in
+    /// x and y, because it is a regular squared grid)
+    std::vector<double> bincenters;
+    for (int i=0; i<maxidx; i++){
+      double bincenter = -binning_*(maxidx/2.) + binning_/2.+ i*binning_;
+      bincenters.push_back(bincenter);
+    }
+
+    /// For every coordinate in x, a column is built with a number of bins equal
+    /// to the number of EL points which have that x. Remember that only the points
+    /// which falls inside a circle of a fixed radius are taken into account,
+    /// so columns have not all the same number of points
+    std::vector<int> columns;
+    for (int i=0; i<maxidx; i++){
+      if (!even && (i == 0 || i == maxidx-1)) {
+        columns.push_back(0);
+        continue;
+      }
+      double y = std::sqrt(std::max(0., radius_*radius_ - bincenters[i]*bincenters[i]));
+      double col = 0;
+      ///If the y coord of the circle falls further than the center of the bin,
+      ///that bin is included, otherwise it isn't.
+      if (even) {
+        if ((y/binning_) - floor(y/binning_)<0.5){
+          col = floor(y/binning_)*2.;
+        } else {
+          col = ceil(y/binning_)*2.;
+        }
+      } else {
+        if ((y-binning_/2.)/binning_ - floor((y-binning_/2.)/binning_)<0.5){
+          col = floor((y-binning_/2.)/binning_)*2.+1;
+        } else {
+          if (y < radius_){
+            col = ceil((y-binning_/2.)/binning_)*2.+1;
+          } else {
+            col = ceil((y-binning_/2.)/binning_)*2.-1;
+          }
+        }
+      }
+      columns.push_back(std::min(std::max(int(col), 0), maxidx));
+    }
+
+    /// First and last valid bin of every column, and id of its first point
+    std::vector<int> lower(maxidx), upper(maxidx), first_id(maxidx);
+    int sum = 0;
+    for (int i=0; i<maxidx; i++){
+      lower[i] = (maxidx - columns[i])/2;
+      upper[i] = lower[i] + columns[i] - 1;
+      first_id[i] = sum;
+      sum += columns[i];
+    }
+    npoints_xy_ = sum;
+
+    /// Bins without EL point take the closest point, by distance between
+    /// bin centres. The valid bins of a column are contiguous, so the
+    /// closest one in a column is the bin clamped to its range.
+    grid_.assign(maxidx * maxidx, -1);
+
+    for (int i=0; i<maxidx; i++){
+      for (int j=0; j<maxidx; j++){
+
+        if (j >= lower[i] && j <= upper[i]) {
+          grid_[i*maxidx + j] = first_id[i] + j - lower[i];
+          continue;
+        }
+
+        double min_dist = 0.;
+        for (int k=0; k<maxidx; k++){
+          if (columns[k] == 0) continue;
+          int l = std::min(std::max(j, lower[k]), upper[k]);
+          double dist = (i-k)*(i-k) + (j-l)*(j-l);
+          if (grid_[i*maxidx + j] < 0 || dist < min_dist) {
+            min_dist = dist;
+            grid_[i*maxidx + j] = first_id[k] + l - lower[k];
+          }
+        }
+      }
+    }
+
+    return true;
+  }
+
+
+
+  void ELTableFile::Clear()
+  {
+    binary_.Clear();
+
+    grid_.clear();
+    nbins_xy_ = npoints_xy_ = 0;
+    npoints_ = nentries_ = 0;
+    nbins_t_ = 0;
+
+    offsets_ = 0;
+    sensor_ids_ = 0;
+    probs_ = 0;
+
+    std::vector<uint64_t>().swap(offsets_store_);
+    std::vector<int32_t>().swap(sensor_ids_store_);
+    std::vector<float>().swap(probs_store_);
+
+    new_points_.clear();
+    new_sensors_.clear();
+    new_probs_.clear();
+  }
+
+
+
+  void ELTableFile::Compress(const std::vector<int>& points,
+                             const std::vector<int32_t>& sensors,
+                             const std::vector<float>& probs)
+  {
+    // The entries of point p are those
+    // between offsets[p] and offsets[p+1]
+    int npoints = 0;
+    for (size_t i=0; i<points.size(); i++)
+      npoints = std::max(npoints, points[i] + 1);
+
+    offsets_store_.assign(npoints + 1, 0);
+    for (size_t i=0; i<points.size(); i++)
+      offsets_store_[points[i] + 1]++;
+    for (int p=0; p<npoints; p++)
+      offsets_store_[p+1] += offsets_store_[p];
+
+    sensor_ids_store_.resize(points.size());
+    probs_store_.resize(probs.size());
+
+    std::vector<uint64_t> next(offsets_store_.begin(), offsets_store_.end() - 1);
+    for (size_t i=0; i<points.size(); i++) {
+      uint64_t entry = next[points[i]]++;
+      sensor_ids_store_[entry] = sensors[i];
+      std::copy(probs.begin() + i * nbins_t_, probs.begin() + (i+1) * nbins_t_,
+                probs_store_.begin() + entry * nbins_t_);
+    }
+
+    npoints_ = npoints;
+    nentries_ = points.size();
+    if (nentries_ == 0) nbins_t_ = 0;
+
+    offsets_ = offsets_store_.data();
+    sensor_ids_ = sensor_ids_store_.data();
+    probs_ = probs_store_.data();
+  }
+
+
+} // end namespace nexus
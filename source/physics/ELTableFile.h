@@ -0,0 +1,172 @@
+// ----------------------------------------------------------------------------
+// nexus | ELTableFile.h
+//
+// This class reads and writes the files of the EL lookup tables.
+//
+// The NEXT Collaboration
+// ----------------------------------------------------------------------------
+
+#ifndef EL_TABLE_FILE_H
+#define EL_TABLE_FILE_H
+
+#include "LightTableFile.h"
+
+#include <string>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include <stdint.h>
+
+
+namespace nexus {
+
+  /// Contents of an EL lookup table: the grid of points of the EL gap
+  /// and, for every point, the detection probabilities of the sensors
+  /// for each time bin of the crossing of the gap, stored in compressed
+  /// rows (the entries of point p are those in [offsets[p], offsets[p+1])).
+  ///
+  /// Tables are read from the text format (one line per point and
+  /// sensor: point id, sensor id and the probability of every time bin;
+  /// header lines start with '*') or mapped read-only from the binary
+  /// format, so that the pages of a table are shared by all the
+  /// processes of a node and nothing is parsed at startup. A binary
+  /// file is a LightTableFile with a Header, a row per point and
+  /// nbins_t probabilities per entry.
+  ///
+  /// This class does not depend on Geant4, so that tables can be
+  /// converted by standalone tools. Lengths are in mm.
+
+  class ELTableFile {
+
+  public:
+    /// Header of the binary format
+    struct Header {
+      char     magic[8];  ///< MAGIC
+      uint32_t version;   ///< VERSION
+      uint32_t nbins_t;   ///< time bins of every entry
+      double   radius;    ///< radius of the circle of points (mm)
+      double   binning;   ///< size of the bins of the grid (mm)
+      uint64_t npoints;   ///< points with an offset
+      uint64_t nentries;  ///< entries (point, sensor) of the table
+    };
+
+    static const char MAGIC[8];
+    static const uint32_t VERSION = 1;
+
+  public:
+    /// constructor
+    ELTableFile();
+    /// destructor
+    ~ELTableFile();
+
+    /// Is the file in the binary format?
+    static bool IsBinary(const std::string& filename);
+
+    /// Read a table in the text format, with the given grid.
+    /// Returns false on error, including any malformed data line.
+    bool ReadText(const std::string& filename, double radius, double binning);
+
+    /// Map a table in the binary format read-only. Returns false on error.
+    bool Map(const std::string& filename);
+
+    /// Start an empty table with the given grid, to be filled with
+    /// AddEntry and completed with Finish
+    bool Reset(double radius, double binning);
+    /// Add the probabilities of the time bins of a sensor for a point
+    bool AddEntry(int point, int sensor_id, const std::vector<float>& probs);
+    /// Sort the entries added by point
+    void Finish();
+
+    /// Write the table in the binary format. Returns false on error.
+    bool Write(const std::string& filename) const;
+
+    /// Point of the grid closest to a position of the gap
+    int FindPoint(double x, double y) const;
+    /// Number of points of the grid
+    int GetNumberOfGridPoints() const;
+
+    double GetRadius() const;
+    double GetBinning() const;
+    uint64_t GetNumberOfPoints() const;
+    uint64_t GetNumberOfEntries() const;
+    uint32_t GetNumberOfTimeBins() const;
+
+    const uint64_t* GetOffsets() const;
+    const int32_t*  GetSensorIDs() const;
+    const float*    GetProbabilities() const;
+
+    /// description of the last error
+    const std::string& Error() const;
+
+  private:
+    /// Map every bin of the grid to its point
+    bool BuildGrid(double radius, double binning);
+    /// Release the table
+    void Clear();
+    /// Build the compressed rows from the entries added
+    void Compress(const std::vector<int>& points, const std::vector<int32_t>& sensors,
+                  const std::vector<float>& probs);
+
+  private:
+    double radius_;   ///< radius of the circle of points
+    double binning_;  ///< size of the bins of the grid
+    int nbins_xy_;    ///< bins of the grid per axis
+    int npoints_xy_;  ///< points of the grid
+
+    std::vector<int> grid_; ///< point of every bin of the grid (x major)
+
+    uint64_t npoints_;   ///< points with an offset
+    uint64_t nentries_;  ///< entries of the table
+    uint32_t nbins_t_;   ///< time bins of every entry
+
+    const uint64_t* offsets_;     ///< first entry of every point, plus the end
+    const int32_t*  sensor_ids_;  ///< sensor of every entry
+    const float*    probs_;       ///< probabilities of every entry
+
+    // Storage of tables read from text or being filled
+    std::vector<uint64_t> offsets_store_;
+    std::vector<int32_t>  sensor_ids_store_;
+    std::vector<float>    probs_store_;
+
+    // Entries added, before Finish
+    std::vector<int>     new_points_;
+    std::vector<int32_t> new_sensors_;
+    std::vector<float>   new_probs_;
+
+    LightTableFile binary_; ///< binary file mapped
+
+    mutable std::string error_; ///< last error
+  };
+
+
+  // INLINE DEFINITIONS //////////////////////////////////////////////
+
+  inline int ELTableFile::FindPoint(double x, double y) const
+  {
+    if (grid_.empty()) return -1;
+    double half = binning_ * nbins_xy_ / 2.;
+    int i = (int) std::floor((x + half) / binning_);
+    int j = (int) std::floor((y + half) / binning_);
+    i = std::min(std::max(i, 0), nbins_xy_ - 1);
+    j = std::min(std::max(j, 0), nbins_xy_ - 1);
+    return grid_[i * nbins_xy_ + j];
+  }
+
+  inline int ELTableFile::GetNumberOfGridPoints() const { return npoints_xy_; }
+
+  inline double ELTableFile::GetRadius() const { return radius_; }
+  inline double ELTableFile::GetBinning() const { return binning_; }
+
+  inline uint64_t ELTableFile::GetNumberOfPoints() const { return npoints_; }
+  inline uint64_t ELTableFile::GetNumberOfEntries() const { return nentries_; }
+  inline uint32_t ELTableFile::GetNumberOfTimeBins() const { return nbins_t_; }
+
+  inline const uint64_t* ELTableFile::GetOffsets() const { return offsets_; }
+  inline const int32_t* ELTableFile::GetSensorIDs() const { return sensor_ids_; }
+  inline const float* ELTableFile::GetProbabilities() const { return probs_; }
+
+  inline const std::string& ELTableFile::Error() const { return error_; }
+
+} // end namespace nexus
+
+#endif
@@ -21,6 +21,8 @@
 
 #include <CLHEP/Units/PhysicalConstants.h>
 
+#include <algorithm>
+
 using namespace nexus;
 using namespace CLHEP;
 
@@ -31,7 +33,10 @@ Electroluminescence::Electroluminescence(const G4String& process_name,
   G4VDiscreteProcess(process_name, type), theFastIntegralTable_(0),
   table_generation_(false), photons_per_point_(0)
 {
+  // The photons do not inherit the weight of the ionization
+  // electrons, which is the number of electrons they represent
   ParticleChange_ = new G4ParticleChange();
+  ParticleChange_->SetSecondaryWeightByProcess(true);
   pParticleChange = ParticleChange_;
 
   BuildThePhysicsTable();
@@ -85,8 +90,9 @@ Electroluminescence::PostStepDoIt(const G4Track& track, const G4Step& step)
   if (yield <= 0.)
     return G4VDiscreteProcess::PostStepDoIt(track, step);
 
-  // Generate a random number of photons around mean 'yield'
-  G4double mean = yield * step_length;
+  // Generate a random number of photons around mean 'yield',
+  // for all the electrons represented by the track
+  G4double mean = yield * step_length * std::max(1, G4lrint(track.GetWeight()));
 
   G4int num_photons;
 
@@ -21,6 +21,8 @@
 
 #include "CLHEP/Units/SystemOfUnits.h"
 
+#include <algorithm>
+
 
 namespace nexus {
 
@@ -29,10 +31,13 @@ namespace nexus {
 
   IonizationClustering::IonizationClustering(const G4String& process_name,
                                              G4ProcessType type):
-    G4VRestDiscreteProcess(process_name, type), ParticleChange_(0), rnd_(0)
+    G4VRestDiscreteProcess(process_name, type), ParticleChange_(0), rnd_(0),
+    factor_(1)
   {
-    // Create particle change object
+    // Create particle change object. The weight of the secondaries is
+    // the number of electrons they represent, not that of the parent.
     ParticleChange_ = new G4ParticleChange();
+    ParticleChange_->SetSecondaryWeightByProcess(true);
     pParticleChange = ParticleChange_;
 
     // Create a segment point sample
@@ -131,10 +136,15 @@ namespace nexus {
       num_charges = G4int(G4Poisson(mean));
     }
 
-    ParticleChange_->SetNumberOfSecondaries(num_charges);
+    // The charges are grouped in tracks of up to factor_ electrons.
+    // Their total is sampled as for single electrons, so the
+    // fluctuations of the number of charges are preserved.
+    G4int num_tracks = (num_charges > 0) ? (num_charges + factor_ - 1) / factor_ : 0;
+
+    ParticleChange_->SetNumberOfSecondaries(num_tracks);
 
     // Track secondaries first
-    if ((track.GetTrackStatus() == fAlive) && num_charges > 0)
+    if ((track.GetTrackStatus() == fAlive) && num_tracks > 0)
       ParticleChange_->ProposeTrackStatus(fSuspend);
 
     //////////////////////////////////////////////////////////////////
@@ -150,7 +160,7 @@ namespace nexus {
     rnd_->SetPoints(pre_point, post_point);
 
 
-    for (G4int i=0; i<num_charges; i++) {
+    for (G4int i=0; i<num_tracks; i++) {
 
       G4DynamicParticle* ionielectron =
         new G4DynamicParticle(IonizationElectron::Definition(),
@@ -169,6 +179,9 @@ namespace nexus {
       aSecondaryTrack->
         SetTouchableHandle(step.GetPreStepPoint()->GetTouchableHandle());
 
+      // The last track takes the remaining electrons
+      aSecondaryTrack->SetWeight(std::min(factor_, num_charges - i * factor_));
+
       ParticleChange_->AddSecondary(aSecondaryTrack);
     }
 
@@ -43,6 +43,14 @@ namespace nexus {
     /// by particles at rest
     G4VParticleChange* AtRestDoIt(const G4Track&, const G4Step&);
 
+    /// Set the number of ionization electrons represented by each
+    /// secondary track (default: 1). Every track carries the number
+    /// of electrons it stands for as its weight, which the drift
+    /// (attachment), the electroluminescence and the sensors take into
+    /// account, so the S2 energy response is unchanged. The electrons
+    /// of a track drift and diffuse together, though.
+    void SetClusteringFactor(G4int);
+
   private:
 
     /// Returns infinity; i. e. the process does not limit the step,
@@ -58,8 +66,15 @@ namespace nexus {
   private:
     G4ParticleChange* ParticleChange_;
     SegmentPointSampler* rnd_;
+    G4int factor_; ///< Ionization electrons per secondary track
   };
 
+
+  // INLINE DEFINITIONS //////////////////////////////////////////////
+
+  inline void IonizationClustering::SetClusteringFactor(G4int factor)
+  { factor_ = (factor > 1) ? factor : 1; }
+
 } // end namespace nexus
 
 #endif
@@ -17,13 +17,14 @@
 #include <G4TransportationManager.hh>
 #include <G4TouchableHandle.hh>
 #include <G4Navigator.hh>
+#include <Randomize.hh>
 
 
 namespace nexus {
 
 
   IonizationDrift::IonizationDrift(const G4String& name, G4ProcessType type):
-    G4VContinuousDiscreteProcess(name, type)
+    G4VContinuousDiscreteProcess(name, type), survivors_(-1)
   {
     ParticleChange_ = new G4ParticleChangeForTransport();
     pParticleChange = ParticleChange_;
@@ -77,6 +78,7 @@ namespace nexus {
     // Initialize the particle-change (sets all its members equal to
     // the corresponding members in the track).
     ParticleChange_->Initialize(track);
+    survivors_ = -1;
 
     if (step.GetStepLength() > 0) {
 
@@ -91,9 +93,23 @@ namespace nexus {
       }
       else {
         const G4double attach = mpt->GetConstProperty("ATTACHMENT");
-        G4double rnd = -attach * log(G4UniformRand());
-        if (xyzt_.t() > rnd) 
-          ParticleChange_->ProposeTrackStatus(fStopAndKill);
+        G4int electrons = G4lrint(track.GetWeight());
+
+        if (electrons <= 1) {
+          G4double rnd = -attach * log(G4UniformRand());
+          if (xyzt_.t() > rnd) 
+            ParticleChange_->ProposeTrackStatus(fStopAndKill);
+        }
+        else {
+          // Each electron of a clustered track is attached on its own:
+          // the survivors follow a binomial distribution. The particle
+          // change for transport ignores the weights proposed along
+          // the step, hence the new one is proposed in PostStepDoIt.
+          survivors_ = CLHEP::RandBinomial::shoot(electrons,
+                                                  exp(-xyzt_.t() / attach));
+          if (survivors_ == 0)
+            ParticleChange_->ProposeTrackStatus(fStopAndKill);
+        }
       }
 
       ParticleChange_->ProposeGlobalTime(xyzt_.t());
@@ -125,6 +141,10 @@ namespace nexus {
   {
     ParticleChange_->Initialize(track);
 
+    // Electrons of the track that survived the attachment along the step
+    if (survivors_ > 0) ParticleChange_->ProposeParentWeight(survivors_);
+    survivors_ = -1;
+
     // Update navigator and touchable handle
     G4TouchableHandle touchable = track.GetTouchableHandle();
     nav_->LocateGlobalPointAndUpdateTouchableHandle
@@ -48,6 +48,7 @@ namespace nexus {
     
   private:
     G4LorentzVector xyzt_;
+    G4long survivors_; ///< Electrons left after attachment in the step, or -1
     G4ParticleChangeForTransport* ParticleChange_;
     G4Navigator* nav_; ///< Pointer to the G4 navigator for tracking
   };
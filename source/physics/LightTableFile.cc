@@ -0,0 +1,175 @@
+// ----------------------------------------------------------------------------
+// nexus | LightTableFile.cc
+//
+// This class maps and writes the binary files of the light tables.
+//
+// The NEXT Collaboration
+// ----------------------------------------------------------------------------
+
+#include "LightTableFile.h"
+
+#include <fstream>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+
+
+namespace nexus {
+
+
+  LightTableFile::LightTableFile():
+    fd_(-1), file_size_(0), header_size_(0), map_(0), map_size_(0),
+    offsets_(0), sensor_ids_(0), probs_(0)
+  {
+  }
+
+
+
+  LightTableFile::~LightTableFile()
+  {
+    Clear();
+  }
+
+
+
+  uint64_t LightTableFile::SensorBytes(uint64_t nentries)
+  {
+    return (nentries * sizeof(int32_t) + 7) / 8 * 8;
+  }
+
+
+
+  bool LightTableFile::Open(const std::string& filename, const char magic[8],
+                            void* header, size_t header_size,
+                            const std::string& kind)
+  {
+    Clear();
+
+    fd_ = open(filename.c_str(), O_RDONLY);
+    if (fd_ < 0) {
+      error_ = "cannot open " + filename;
+      return false;
+    }
+
+    struct stat st;
+    if (fstat(fd_, &st) != 0 || (size_t) st.st_size < header_size ||
+        pread(fd_, header, header_size, 0) != (ssize_t) header_size ||
+        std::memcmp(header, magic, 8) != 0) {
+      Clear();
+      error_ = filename + " is not an " + kind;
+      return false;
+    }
+
+    filename_ = filename;
+    file_size_ = st.st_size;
+    header_size_ = header_size;
+    return true;
+  }
+
+
+
+  bool LightTableFile::Map(uint64_t nrows, uint64_t nentries, uint64_t nvalues)
+  {
+    uint64_t size = header_size_ + (nrows + 1) * sizeof(uint64_t)
+      + SensorBytes(nentries) + nentries * nvalues * sizeof(float);
+
+    if (fd_ < 0 || size != file_size_) {
+      Clear();
+      error_ = filename_ + " is truncated or corrupt";
+      return false;
+    }
+
+    // The mapping stays valid once the file is closed
+    void* map = mmap(0, size, PROT_READ, MAP_SHARED, fd_, 0);
+    close(fd_);
+    fd_ = -1;
+    if (map == MAP_FAILED) {
+      Clear();
+      error_ = "cannot map " + filename_;
+      return false;
+    }
+
+    map_ = map;
+    map_size_ = size;
+
+    const char* data = static_cast<const char*>(map_) + header_size_;
+    offsets_ = reinterpret_cast<const uint64_t*>(data);
+    data += (nrows + 1) * sizeof(uint64_t);
+    sensor_ids_ = reinterpret_cast<const int32_t*>(data);
+    data += SensorBytes(nentries);
+    probs_ = reinterpret_cast<const float*>(data);
+
+    if (offsets_[0] != 0 || offsets_[nrows] != nentries) {
+      std::string filename = filename_;
+      Clear();
+      error_ = filename + " is truncated or corrupt";
+      return false;
+    }
+
+    return true;
+  }
+
+
+
+  void LightTableFile::Clear()
+  {
+    if (fd_ >= 0) close(fd_);
+    fd_ = -1;
+
+    if (map_) munmap(map_, map_size_);
+    map_ = 0;
+    map_size_ = 0;
+
+    filename_.clear();
+    file_size_ = 0;
+    header_size_ = 0;
+
+    offsets_ = 0;
+    sensor_ids_ = 0;
+    probs_ = 0;
+  }
+
+
+
+  bool LightTableFile::Write(const std::string& filename,
+                             const void* header, size_t header_size,
+                             const uint64_t* offsets, uint64_t nrows,
+                             const int32_t* sensor_ids, uint64_t nentries,
+                             const float* probs, uint64_t nvalues,
+                             std::string& error)
+  {
+    std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+      error = "cannot create " + filename;
+      return false;
+    }
+
+    const char padding[8] = {0};
+    uint64_t ids_size = nentries * sizeof(int32_t);
+    uint64_t empty_offset = 0;
+
+    file.write(static_cast<const char*>(header), header_size);
+    if (offsets)
+      file.write(reinterpret_cast<const char*>(offsets),
+                 (nrows + 1) * sizeof(uint64_t));
+    else
+      file.write(reinterpret_cast<const char*>(&empty_offset), sizeof(uint64_t));
+    file.write(reinterpret_cast<const char*>(sensor_ids), ids_size);
+    file.write(padding, SensorBytes(nentries) - ids_size);
+    file.write(reinterpret_cast<const char*>(probs),
+               nentries * nvalues * sizeof(float));
+
+    if (!file.good()) {
+      error = "cannot write " + filename;
+      return false;
+    }
+
+    return true;
+  }
+
+
+} // end namespace nexus
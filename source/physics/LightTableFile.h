@@ -0,0 +1,99 @@
+// ----------------------------------------------------------------------------
+// nexus | LightTableFile.h
+//
+// This class maps and writes the binary files of the light tables.
+//
+// The NEXT Collaboration
+// ----------------------------------------------------------------------------
+
+#ifndef LIGHT_TABLE_FILE_H
+#define LIGHT_TABLE_FILE_H
+
+#include <string>
+#include <stdint.h>
+
+
+namespace nexus {
+
+  /// Binary file of a light table (see ELTableFile and S1TableFile):
+  /// a header, which starts with the magic string of the format,
+  /// followed by the compressed rows of the table, in native byte order:
+  ///
+  ///   header
+  ///   uint64  offsets[nrows + 1]
+  ///   int32   sensor_ids[nentries], padded to a multiple of 8 bytes
+  ///   float   probabilities[nentries * nvalues]
+  ///
+  /// A file is read in two steps: Open reads its header, so that the
+  /// table can check it and find the size of its rows, and Map maps
+  /// it read-only. The mapping is released by Clear or the destructor.
+
+  class LightTableFile {
+
+  public:
+    /// constructor
+    LightTableFile();
+    /// destructor
+    ~LightTableFile();
+
+    /// Open a binary file and read its header, checking that it starts
+    /// with the given magic string. The kind of table names the file
+    /// in the errors. Returns false on error.
+    bool Open(const std::string& filename, const char magic[8],
+              void* header, size_t header_size, const std::string& kind);
+
+    /// Map the file opened, holding nrows rows of nentries entries
+    /// of nvalues probabilities each, and close it. Returns false on error.
+    bool Map(uint64_t nrows, uint64_t nentries, uint64_t nvalues);
+
+    /// Close the file and release its mapping
+    void Clear();
+
+    const uint64_t* GetOffsets() const;
+    const int32_t*  GetSensorIDs() const;
+    const float*    GetProbabilities() const;
+
+    /// description of the last error
+    const std::string& Error() const;
+
+    /// Write a header and its rows. The offsets of an empty table
+    /// (no rows) may be null. Returns false on error.
+    static bool Write(const std::string& filename,
+                      const void* header, size_t header_size,
+                      const uint64_t* offsets, uint64_t nrows,
+                      const int32_t* sensor_ids, uint64_t nentries,
+                      const float* probs, uint64_t nvalues,
+                      std::string& error);
+
+  private:
+    /// Bytes of the sensor ids, with their padding
+    static uint64_t SensorBytes(uint64_t nentries);
+
+  private:
+    std::string filename_;  ///< file opened
+    int fd_;                ///< and its descriptor, until mapped
+    uint64_t file_size_;    ///< size of the file
+    size_t header_size_;    ///< size of its header
+
+    void*  map_;       ///< mapping of the file
+    size_t map_size_;  ///< and its size
+
+    const uint64_t* offsets_;     ///< first entry of every row, plus the end
+    const int32_t*  sensor_ids_;  ///< sensor of every entry
+    const float*    probs_;       ///< probabilities of every entry
+
+    std::string error_; ///< last error
+  };
+
+
+  // INLINE DEFINITIONS //////////////////////////////////////////////
+
+  inline const uint64_t* LightTableFile::GetOffsets() const { return offsets_; }
+  inline const int32_t* LightTableFile::GetSensorIDs() const { return sensor_ids_; }
+  inline const float* LightTableFile::GetProbabilities() const { return probs_; }
+
+  inline const std::string& LightTableFile::Error() const { return error_; }
+
+} // end namespace nexus
+
+#endif
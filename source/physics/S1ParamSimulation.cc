@@ -0,0 +1,187 @@
+// ----------------------------------------------------------------------------
+// nexus | S1ParamSimulation.cc
+//
+// This class implements a parametrized simulation of the S1 light.
+//
+// The NEXT Collaboration
+// ----------------------------------------------------------------------------
+
+#include "S1ParamSimulation.h"
+
+#include "S1TableFile.h"
+#include "IonizationElectron.h"
+#include "PmtSD.h"
+
+#include <G4ParticleDefinition.hh>
+#include <G4OpticalPhoton.hh>
+#include <G4Gamma.hh>
+#include <G4Material.hh>
+#include <G4MaterialPropertiesTable.hh>
+#include <G4SystemOfUnits.hh>
+#include <G4Poisson.hh>
+#include <Randomize.hh>
+
+#include <cmath>
+#include <algorithm>
+
+
+namespace nexus {
+
+
+  S1ParamSimulation::S1ParamSimulation(const S1TableFile* table,
+                                       const G4String& process_name,
+                                       G4ProcessType type):
+    G4VRestDiscreteProcess(process_name, type), ParticleChange_(0),
+    table_(table), missing_warned_(false)
+  {
+    ParticleChange_ = new G4ParticleChange();
+    pParticleChange = ParticleChange_;
+  }
+
+
+
+  S1ParamSimulation::~S1ParamSimulation()
+  {
+    delete ParticleChange_;
+  }
+
+
+
+  G4bool S1ParamSimulation::IsApplicable(const G4ParticleDefinition& pdef)
+  {
+    if (pdef == *G4OpticalPhoton::Definition() ||
+        pdef == *IonizationElectron::Definition()) return false;
+
+    else if ((pdef.GetPDGCharge() != 0.) ||
+             (pdef == *G4Gamma::Definition())) return true;
+
+    else return false;
+  }
+
+
+
+  G4VParticleChange*
+  S1ParamSimulation::AtRestDoIt(const G4Track& track, const G4Step& step)
+  {
+    // The method simply calls the equivalent PostStepDoIt,
+    // proceeding as in any other step.
+    return S1ParamSimulation::PostStepDoIt(track, step);
+  }
+
+
+
+  G4VParticleChange*
+  S1ParamSimulation::PostStepDoIt(const G4Track& track, const G4Step& step)
+  {
+    ParticleChange_->Initialize(track);
+
+    G4double energy_dep = step.GetTotalEnergyDeposit();
+    if (energy_dep <= 0.)
+      return G4VRestDiscreteProcess::PostStepDoIt(track, step);
+
+    // Only materials that scintillate emit S1 light
+    G4MaterialPropertiesTable* mpt =
+      track.GetMaterial()->GetMaterialPropertiesTable();
+    if (!mpt || !mpt->ConstPropertyExists("SCINTILLATIONYIELD"))
+      return G4VRestDiscreteProcess::PostStepDoIt(track, step);
+
+    G4double yield = mpt->GetConstProperty("SCINTILLATIONYIELD");
+    if (yield <= 0.)
+      return G4VRestDiscreteProcess::PostStepDoIt(track, step);
+
+    // The light is emitted from the middle of the step, except for the
+    // deposits of gammas, which happen at the post-step point
+    const G4StepPoint* pre  = step.GetPreStepPoint();
+    const G4StepPoint* post = step.GetPostStepPoint();
+
+    G4ThreeVector position = post->GetPosition();
+    if (track.GetDefinition() != G4Gamma::Definition())
+      position = (pre->GetPosition() + post->GetPosition()) / 2.;
+
+    int64_t voxel = table_->FindVoxel(position.x()/mm, position.y()/mm,
+                                      position.z()/mm);
+    if (voxel < 0)
+      return G4VRestDiscreteProcess::PostStepDoIt(track, step);
+
+    // Sample the photons emitted as the optical scintillation does
+    G4double mean = yield * energy_dep;
+    G4double resolution = mpt->ConstPropertyExists("RESOLUTIONSCALE") ?
+      mpt->GetConstProperty("RESOLUTIONSCALE") : 1.;
+
+    G4double num_photons;
+    if (mean < 10.) // Poissonian regime
+      num_photons = G4Poisson(mean);
+    else            // Gaussian regime
+      num_photons = std::max(0., std::floor(G4RandGauss::shoot(mean,
+                               resolution * std::sqrt(mean)) + 0.5));
+    if (num_photons <= 0.)
+      return G4VRestDiscreteProcess::PostStepDoIt(track, step);
+
+    // Time profile of the scintillation of the material
+    G4double fast = mpt->ConstPropertyExists("FASTTIMECONSTANT") ?
+      mpt->GetConstProperty("FASTTIMECONSTANT") : 0.;
+    G4double slow = mpt->ConstPropertyExists("SLOWTIMECONSTANT") ?
+      mpt->GetConstProperty("SLOWTIMECONSTANT") : fast;
+    G4double ratio = mpt->ConstPropertyExists("YIELDRATIO") ?
+      mpt->GetConstProperty("YIELDRATIO") : 1.;
+
+    G4double pre_time  = pre->GetGlobalTime();
+    G4double step_time = post->GetGlobalTime() - pre_time;
+
+    uint64_t last = table_->GetLastEntry(voxel);
+
+    for (uint64_t entry=table_->GetFirstEntry(voxel); entry<last; entry++) {
+
+      G4long npe = G4Poisson(num_photons * table_->GetProbability(entry));
+      if (npe == 0) continue;
+
+      G4int sensor_id = table_->GetSensorID(entry);
+      const SensorMap::Sensor* sensor = sensors_.Find(sensor_id);
+      if (!sensor) {
+        if (!missing_warned_) {
+          missing_warned_ = true;
+          G4Exception("[S1ParamSimulation]", "PostStepDoIt()", JustWarning,
+                      "The S1 light table has sensors that are not in "
+                      "the geometry. Their light is lost.");
+        }
+        continue;
+      }
+
+      for (G4long n=0; n<npe; n++) {
+        G4double time = pre_time + G4UniformRand() * step_time
+          + SampleDelay(fast, slow, ratio);
+        sensor->sd->AddPhotons(sensor_id, sensor->position, time);
+      }
+    }
+
+    return G4VRestDiscreteProcess::PostStepDoIt(track, step);
+  }
+
+
+
+  G4double S1ParamSimulation::SampleDelay(G4double fast, G4double slow,
+                                          G4double ratio) const
+  {
+    G4double tau = (G4UniformRand() < ratio) ? fast : slow;
+    return (tau > 0.) ? -tau * std::log(G4UniformRand()) : 0.;
+  }
+
+
+
+  G4double S1ParamSimulation::GetMeanFreePath(const G4Track&,
+    G4double, G4ForceCondition* condition)
+  {
+    *condition = StronglyForced;
+    return DBL_MAX;
+  }
+
+
+
+  G4double S1ParamSimulation::GetMeanLifeTime(const G4Track&,
+    G4ForceCondition* condition)
+  {
+    *condition = Forced;
+    return DBL_MAX;
+  }
+
+} // end namespace nexus
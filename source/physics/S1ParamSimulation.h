@@ -0,0 +1,78 @@
+// ----------------------------------------------------------------------------
+// nexus | S1ParamSimulation.h
+//
+// This class implements a parametrized simulation of the S1 light.
+//
+// The NEXT Collaboration
+// ----------------------------------------------------------------------------
+
+#ifndef S1_PARAM_SIMULATION_H
+#define S1_PARAM_SIMULATION_H
+
+#include "SensorMap.h"
+
+#include <G4VRestDiscreteProcess.hh>
+
+
+namespace nexus {
+
+  class S1TableFile;
+
+  /// Fast simulation of the primary scintillation (S1). For every energy
+  /// deposit inside the box of an S1 light table, the process samples
+  /// the scintillation photons from the yield and resolution scale of
+  /// the material, looks up the detection probability of every sensor
+  /// for the voxel of the deposit and fills the hits of their PmtSD with
+  /// Poisson-sampled photoelectrons. Their times follow the fast and slow
+  /// components of the scintillation of the material. No optical photon
+  /// is generated: the optical scintillation process must be off.
+
+  class S1ParamSimulation: public G4VRestDiscreteProcess
+  {
+  public:
+    /// Constructor
+    S1ParamSimulation(const S1TableFile* table,
+                      const G4String& process_name="S1ParamSimulation",
+                      G4ProcessType type=fUserDefined);
+    /// Destructor
+    ~S1ParamSimulation();
+
+    /// Returns true for the particles that deposit energy,
+    /// as the ionization clustering does
+    G4bool IsApplicable(const G4ParticleDefinition&);
+
+    /// Fills the sensor hits with the S1 light of the
+    /// deposit of a step in flight
+    G4VParticleChange* PostStepDoIt(const G4Track&, const G4Step&);
+
+    /// Fills the sensor hits with the S1 light of the
+    /// deposit of a particle at rest
+    G4VParticleChange* AtRestDoIt(const G4Track&, const G4Step&);
+
+  private:
+    /// Returns infinity; i. e. the process does not limit the step,
+    /// but sets the 'StronglyForced' condition for the PostStepDoIt
+    /// to be invoked at every step
+    G4double GetMeanFreePath(const G4Track&, G4double, G4ForceCondition*);
+
+    /// Returns infinity; i. e. the process does not limit the time,
+    /// but sets the 'Forced' condition for the AtRestDoIt
+    /// to be invoked at every step
+    G4double GetMeanLifeTime(const G4Track&, G4ForceCondition*);
+
+    /// Emission time of a photon after the deposit
+    G4double SampleDelay(G4double fast, G4double slow, G4double ratio) const;
+
+  private:
+    G4ParticleChange* ParticleChange_;
+
+    const S1TableFile* table_; ///< Detection probabilities (not owned)
+
+    SensorMap sensors_;     ///< Sensors of the geometry, found at
+                            ///< the start of every run
+    G4bool missing_warned_; ///< Has a missing sensor been reported?
+  };
+
+} // end namespace nexus
+
+#endif
@@ -0,0 +1,84 @@
+// ----------------------------------------------------------------------------
+// nexus | S1TableBuilder.cc
+//
+// This class computes the S1 light tables from the events of a production.
+//
+// The NEXT Collaboration
+// ----------------------------------------------------------------------------
+
+#include "S1TableBuilder.h"
+#include "S1TableFile.h"
+
+#include <algorithm>
+#include <sstream>
+
+
+
+namespace nexus {
+
+
+  S1TableBuilder::S1TableBuilder(uint64_t nvoxels): events_(nvoxels, 0)
+  {
+  }
+
+
+
+  void S1TableBuilder::AddEvent(int64_t voxel)
+  {
+    if (voxel >= 0 && (uint64_t) voxel < events_.size())
+      events_[voxel]++;
+  }
+
+
+
+  void S1TableBuilder::AddCharge(int64_t voxel, unsigned int sensor_id,
+                                 double charge)
+  {
+    if (voxel >= 0 && (uint64_t) voxel < events_.size())
+      charges_[std::make_pair((uint64_t) voxel, sensor_id)] += charge;
+  }
+
+
+
+  bool S1TableBuilder::Fill(S1TableFile& table, double photons_per_event)
+  {
+    if (!(photons_per_event > 0.)) {
+      error_ = "the photons per event must be positive";
+      return false;
+    }
+
+    if (table.GetNumberOfVoxels() != events_.size()) {
+      error_ = "the table has a different number of voxels";
+      return false;
+    }
+
+    // The charges are ordered by voxel and sensor
+    std::map<std::pair<uint64_t, unsigned int>, double>::const_iterator it;
+    for (it = charges_.begin(); it != charges_.end(); ++it) {
+      uint64_t voxel = it->first.first;
+      if (events_[voxel] == 0) {
+        std::ostringstream msg;
+        msg << "voxel " << voxel << " has charge but no events";
+        error_ = msg.str();
+        return false;
+      }
+      float prob = it->second / (photons_per_event * events_[voxel]);
+      if (!table.AddEntry(voxel, it->first.second, prob)) {
+        error_ = table.Error();
+        return false;
+      }
+    }
+
+    table.Finish();
+    return true;
+  }
+
+
+
+  uint64_t S1TableBuilder::EmptyVoxels() const
+  {
+    return std::count(events_.begin(), events_.end(), 0);
+  }
+
+
+} // end namespace nexus
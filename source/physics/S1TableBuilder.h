@@ -0,0 +1,66 @@
+// ----------------------------------------------------------------------------
+// nexus | S1TableBuilder.h
+//
+// This class computes the S1 light tables from the events of a production.
+//
+// The NEXT Collaboration
+// ----------------------------------------------------------------------------
+
+#ifndef S1_TABLE_BUILDER_H
+#define S1_TABLE_BUILDER_H
+
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+#include <stdint.h>
+
+
+namespace nexus {
+
+  class S1TableFile;
+
+  /// Accumulates the events of an S1 table production voxel by voxel:
+  /// the number of events generated in every voxel and the charge
+  /// every sensor detected from them. The detection probability of a
+  /// sensor for a voxel is its charge over the photons generated in
+  /// the voxel, i.e., the photons per event times its events.
+  ///
+  /// Like S1TableFile, this class does not depend on Geant4.
+
+  class S1TableBuilder {
+
+  public:
+    /// constructor, for a table with the given number of voxels
+    S1TableBuilder(uint64_t nvoxels);
+
+    /// Count an event generated in a voxel. Events out of the
+    /// box of voxels (voxel < 0) are ignored.
+    void AddEvent(int64_t voxel);
+
+    /// Add the charge detected by a sensor from an event of a voxel
+    void AddCharge(int64_t voxel, unsigned int sensor_id, double charge);
+
+    /// Fill a table, reset with the same voxels, with the detection
+    /// probabilities. Returns false on error.
+    bool Fill(S1TableFile& table, double photons_per_event);
+
+    /// Number of voxels without any event
+    uint64_t EmptyVoxels() const;
+
+    const std::string& Error() const;
+
+  private:
+    std::vector<uint64_t> events_;  ///< events of every voxel
+    std::map<std::pair<uint64_t, unsigned int>, double> charges_; ///< by voxel and sensor
+    std::string error_;
+  };
+
+
+  // INLINE DEFINITIONS //////////////////////////////////////////////
+
+  inline const std::string& S1TableBuilder::Error() const { return error_; }
+
+} // end namespace nexus
+
+#endif
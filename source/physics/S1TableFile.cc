@@ -0,0 +1,209 @@
+// ----------------------------------------------------------------------------
+// nexus | S1TableFile.cc
+//
+// This class reads and writes the files of the S1 light tables.
+//
+// The NEXT Collaboration
+// ----------------------------------------------------------------------------
+
+#include "S1TableFile.h"
+
+#include <sstream>
+#include <cstring>
+
+
+
+namespace nexus {
+
+
+  const char S1TableFile::MAGIC[8] = {'N', 'X', 'S', '1', 'T', 'A', 'B', 'L'};
+  const uint32_t S1TableFile::VERSION;
+
+
+
+  S1TableFile::S1TableFile():
+    size_(0), nentries_(0),
+    offsets_(0), sensor_ids_(0), probs_(0)
+  {
+    for (int i=0; i<3; i++) {
+      origin_[i] = voxel_[i] = 0.;
+      nvoxels_[i] = 0;
+    }
+  }
+
+
+
+  S1TableFile::~S1TableFile()
+  {
+    Clear();
+  }
+
+
+
+  bool S1TableFile::Map(const std::string& filename)
+  {
+    Clear();
+
+    Header header;
+    if (!binary_.Open(filename, MAGIC, &header, sizeof(header), "S1 light table")) {
+      error_ = binary_.Error();
+      return false;
+    }
+
+    if (header.version != VERSION) {
+      binary_.Clear();
+      std::ostringstream msg;
+      msg << filename << " has version " << header.version
+          << " of the S1 table format, expected " << VERSION;
+      error_ = msg.str();
+      return false;
+    }
+
+    uint64_t nvoxels = (uint64_t) header.nvoxels[0] * header.nvoxels[1] *
+      header.nvoxels[2];
+
+    if (!binary_.Map(nvoxels, header.nentries, 1)) {
+      error_ = binary_.Error();
+      return false;
+    }
+
+    for (int i=0; i<3; i++) {
+      if (!(header.voxel[i] > 0.) || header.nvoxels[i] == 0) {
+        Clear();
+        error_ = filename + " has an empty box of voxels";
+        return false;
+      }
+    }
+
+    for (int i=0; i<3; i++) {
+      origin_[i]  = header.origin[i];
+      voxel_[i]   = header.voxel[i];
+      nvoxels_[i] = header.nvoxels[i];
+    }
+    size_ = nvoxels;
+    nentries_ = header.nentries;
+
+    offsets_ = binary_.GetOffsets();
+    sensor_ids_ = binary_.GetSensorIDs();
+    probs_ = binary_.GetProbabilities();
+
+    return true;
+  }
+
+
+
+  bool S1TableFile::Reset(const double origin[3], const double voxel[3],
+                          const uint32_t nvoxels[3])
+  {
+    Clear();
+
+    for (int i=0; i<3; i++) {
+      if (!(voxel[i] > 0.) || nvoxels[i] == 0) {
+        error_ = "the voxels must have a positive size and number";
+        return false;
+      }
+      origin_[i]  = origin[i];
+      voxel_[i]   = voxel[i];
+      nvoxels_[i] = nvoxels[i];
+    }
+
+    size_ = (uint64_t) nvoxels_[0] * nvoxels_[1] * nvoxels_[2];
+    return true;
+  }
+
+
+
+  bool S1TableFile::AddEntry(uint64_t voxel, int sensor_id, float prob)
+  {
+    if (voxel >= size_) {
+      error_ = "voxel out of the box";
+      return false;
+    }
+
+    new_voxels_.push_back(voxel);
+    new_sensors_.push_back(sensor_id);
+    new_probs_.push_back(prob);
+    return true;
+  }
+
+
+
+  void S1TableFile::Finish()
+  {
+    // The entries of voxel v are those
+    // between offsets[v] and offsets[v+1]
+    offsets_store_.assign(size_ + 1, 0);
+    for (size_t i=0; i<new_voxels_.size(); i++)
+      offsets_store_[new_voxels_[i] + 1]++;
+    for (uint64_t v=0; v<size_; v++)
+      offsets_store_[v+1] += offsets_store_[v];
+
+    sensor_ids_store_.resize(new_voxels_.size());
+    probs_store_.resize(new_voxels_.size());
+
+    std::vector<uint64_t> next(offsets_store_.begin(), offsets_store_.end() - 1);
+    for (size_t i=0; i<new_voxels_.size(); i++) {
+      uint64_t entry = next[new_voxels_[i]]++;
+      sensor_ids_store_[entry] = new_sensors_[i];
+      probs_store_[entry] = new_probs_[i];
+    }
+
+    nentries_ = new_voxels_.size();
+
+    offsets_ = offsets_store_.data();
+    sensor_ids_ = sensor_ids_store_.data();
+    probs_ = probs_store_.data();
+
+    std::vector<uint64_t>().swap(new_voxels_);
+    std::vector<int32_t>().swap(new_sensors_);
+    std::vector<float>().swap(new_probs_);
+  }
+
+
+
+  bool S1TableFile::Write(const std::string& filename) const
+  {
+    if (!offsets_) {
+      error_ = "the table is empty";
+      return false;
+    }
+
+    Header header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    for (int i=0; i<3; i++) {
+      header.origin[i]  = origin_[i];
+      header.voxel[i]   = voxel_[i];
+      header.nvoxels[i] = nvoxels_[i];
+    }
+    header.nentries = nentries_;
+
+    return LightTableFile::Write(filename, &header, sizeof(header),
+                                 offsets_, size_, sensor_ids_, nentries_,
+                                 probs_, 1, error_);
+  }
+
+
+
+  void S1TableFile::Clear()
+  {
+    binary_.Clear();
+
+    size_ = nentries_ = 0;
+
+    offsets_ = 0;
+    sensor_ids_ = 0;
+    probs_ = 0;
+
+    std::vector<uint64_t>().swap(offsets_store_);
+    std::vector<int32_t>().swap(sensor_ids_store_);
+    std::vector<float>().swap(probs_store_);
+
+    new_voxels_.clear();
+    new_sensors_.clear();
+    new_probs_.clear();
+  }
+
+
+} // end namespace nexus
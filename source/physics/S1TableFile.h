@@ -0,0 +1,153 @@
+// ----------------------------------------------------------------------------
+// nexus | S1TableFile.h
+//
+// This class reads and writes the files of the S1 light tables.
+//
+// The NEXT Collaboration
+// ----------------------------------------------------------------------------
+
+#ifndef S1_TABLE_FILE_H
+#define S1_TABLE_FILE_H
+
+#include "LightTableFile.h"
+
+#include <string>
+#include <vector>
+#include <cmath>
+#include <stdint.h>
+
+
+namespace nexus {
+
+  /// Contents of an S1 light table: a box of equal voxels and, for
+  /// every voxel, the probability that a scintillation photon emitted
+  /// in it is detected by each sensor, stored in compressed rows (the
+  /// entries of voxel v are those in [offsets[v], offsets[v+1])).
+  /// Voxels are numbered x first, then y, then z.
+  ///
+  /// Tables are mapped read-only from a binary file, a LightTableFile
+  /// with a Header, a row per voxel and one probability per entry.
+  ///
+  /// This class does not depend on Geant4, so that tables can be
+  /// written by standalone tools. Lengths are in mm.
+
+  class S1TableFile {
+
+  public:
+    /// Header of the binary format
+    struct Header {
+      char     magic[8];    ///< MAGIC
+      uint32_t version;     ///< VERSION
+      uint32_t reserved;    ///< zero
+      double   origin[3];   ///< lowest corner of the box (mm)
+      double   voxel[3];    ///< size of the voxels (mm)
+      uint32_t nvoxels[3];  ///< voxels per axis
+      uint32_t padding;     ///< zero
+      uint64_t nentries;    ///< entries (voxel, sensor) of the table
+    };
+
+    static const char MAGIC[8];
+    static const uint32_t VERSION = 1;
+
+  public:
+    /// constructor
+    S1TableFile();
+    /// destructor
+    ~S1TableFile();
+
+    /// Map a table read-only. Returns false on error.
+    bool Map(const std::string& filename);
+
+    /// Start an empty table with the given box of voxels, to be
+    /// filled with AddEntry and completed with Finish
+    bool Reset(const double origin[3], const double voxel[3],
+               const uint32_t nvoxels[3]);
+    /// Add the detection probability of a sensor for a voxel
+    bool AddEntry(uint64_t voxel, int sensor_id, float prob);
+    /// Sort the entries added by voxel
+    void Finish();
+
+    /// Write the table. Returns false on error.
+    bool Write(const std::string& filename) const;
+
+    /// Voxel of a position, or -1 outside the box
+    int64_t FindVoxel(double x, double y, double z) const;
+
+    /// Total number of voxels of the box
+    uint64_t GetNumberOfVoxels() const;
+    uint64_t GetNumberOfEntries() const;
+
+    /// First and one past the last entry of a voxel
+    uint64_t GetFirstEntry(int64_t voxel) const;
+    uint64_t GetLastEntry(int64_t voxel) const;
+
+    int32_t GetSensorID(uint64_t entry) const;
+    float GetProbability(uint64_t entry) const;
+
+    /// description of the last error
+    const std::string& Error() const;
+
+  private:
+    /// Release the table
+    void Clear();
+
+  private:
+    double origin_[3];     ///< lowest corner of the box
+    double voxel_[3];      ///< size of the voxels
+    uint32_t nvoxels_[3];  ///< voxels per axis
+    uint64_t size_;        ///< total number of voxels
+    uint64_t nentries_;    ///< entries of the table
+
+    const uint64_t* offsets_;     ///< first entry of every voxel, plus the end
+    const int32_t*  sensor_ids_;  ///< sensor of every entry
+    const float*    probs_;       ///< probability of every entry
+
+    // Storage of tables being filled
+    std::vector<uint64_t> offsets_store_;
+    std::vector<int32_t>  sensor_ids_store_;
+    std::vector<float>    probs_store_;
+
+    // Entries added, before Finish
+    std::vector<uint64_t> new_voxels_;
+    std::vector<int32_t>  new_sensors_;
+    std::vector<float>    new_probs_;
+
+    LightTableFile binary_; ///< binary file mapped
+
+    mutable std::string error_; ///< last error
+  };
+
+
+  // INLINE DEFINITIONS //////////////////////////////////////////////
+
+  inline int64_t S1TableFile::FindVoxel(double x, double y, double z) const
+  {
+    if (size_ == 0) return -1;
+    double i = std::floor((x - origin_[0]) / voxel_[0]);
+    double j = std::floor((y - origin_[1]) / voxel_[1]);
+    double k = std::floor((z - origin_[2]) / voxel_[2]);
+    if (i < 0. || j < 0. || k < 0. ||
+        i >= nvoxels_[0] || j >= nvoxels_[1] || k >= nvoxels_[2]) return -1;
+    return ((int64_t) k * nvoxels_[1] + (int64_t) j) * nvoxels_[0] + (int64_t) i;
+  }
+
+  inline uint64_t S1TableFile::GetNumberOfVoxels() const { return size_; }
+  inline uint64_t S1TableFile::GetNumberOfEntries() const { return nentries_; }
+
+  inline uint64_t S1TableFile::GetFirstEntry(int64_t voxel) const
+  { return (offsets_ && voxel >= 0 && (uint64_t) voxel < size_) ? offsets_[voxel] : 0; }
+
+  inline uint64_t S1TableFile::GetLastEntry(int64_t voxel) const
+  { return (offsets_ && voxel >= 0 && (uint64_t) voxel < size_) ? offsets_[voxel+1] : 0; }
+
+  inline int32_t S1TableFile::GetSensorID(uint64_t entry) const
+  { return sensor_ids_[entry]; }
+
+  inline float S1TableFile::GetProbability(uint64_t entry) const
+  { return probs_[entry]; }
+
+  inline const std::string& S1TableFile::Error() const { return error_; }
+
+} // end namespace nexus
+
+#endif
@@ -14,14 +14,21 @@
 #include "Electroluminescence.h"
 #include "WavelengthShifting.h"
 #include "OpPhotoelectricEffect.h"
+#include "ELLookupTable.h"
+#include "ELParamSimulation.h"
+#include "S1TableFile.h"
+#include "S1ParamSimulation.h"
 
 #include <G4GenericMessenger.hh>
 #include <G4OpticalPhoton.hh>
+#include <G4Electron.hh>
 #include <G4ProcessManager.hh>
 #include <G4ProcessTable.hh>
 #include <G4StepLimiter.hh>
 #include <G4FastSimulationManagerProcess.hh>
 #include <G4PhysicsConstructorFactory.hh>
+#include <G4RegionStore.hh>
+#include <G4AutoLock.hh>
 
 
 namespace nexus {
@@ -30,11 +37,19 @@ namespace nexus {
   /// with the generic physics list
   G4_DECLARE_PHYSCONSTR_FACTORY(NexusPhysics);
 
+  namespace {
+    G4Mutex elTableMutex = G4MUTEX_INITIALIZER;
+    G4Mutex s1TableMutex = G4MUTEX_INITIALIZER;
+  }
+
 
 
   NexusPhysics::NexusPhysics():
     G4VPhysicsConstructor("NexusPhysics"),
-    clustering_(true), drift_(true), electroluminescence_(true), photoelectric_(false)
+    clustering_(true), clustering_factor_(1), drift_(true),
+    electroluminescence_(true), photoelectric_(false),
+    el_table_radius_(92.5*mm), el_table_binning_(5.*mm), el_table_(0),
+    s1_table_(0)
   {
     msg_ = new G4GenericMessenger(this, "/PhysicsList/Nexus/",
       "Control commands of the nexus physics list.");
@@ -42,6 +57,13 @@ namespace nexus {
     msg_->DeclareProperty("clustering", clustering_,
       "Switch on/off the ionization clustering");
 
+    G4GenericMessenger::Command& factor_cmd =
+      msg_->DeclareProperty("clustering_factor", clustering_factor_,
+        "Number of ionization electrons represented by each track "
+        "created by the clustering.");
+    factor_cmd.SetParameterName("clustering_factor", false);
+    factor_cmd.SetRange("clustering_factor>=1");
+
     msg_->DeclareProperty("drift", drift_,
       "Switch on/off the ionization drift.");
 
@@ -51,6 +73,26 @@ namespace nexus {
     msg_->DeclareProperty("photoelectric", photoelectric_,
       "Switch on/off the photoelectric effect.");
 
+    msg_->DeclareProperty("el_table", el_table_file_,
+      "EL lookup table of the parametrized simulation of the EL light. "
+      "If set, ionization electrons reaching an EL_REGION fill the sensor "
+      "hits directly and no optical photons are tracked.");
+
+    G4GenericMessenger::Command& radius_cmd =
+      msg_->DeclarePropertyWithUnit("el_table_radius", "mm", el_table_radius_,
+        "Radius of the circle of points of the EL lookup table.");
+    radius_cmd.SetRange("el_table_radius>0.");
+
+    G4GenericMessenger::Command& binning_cmd =
+      msg_->DeclarePropertyWithUnit("el_table_binning", "mm", el_table_binning_,
+        "Spacing of the grid of points of the EL lookup table.");
+    binning_cmd.SetRange("el_table_binning>0.");
+
+    msg_->DeclareProperty("s1_table", s1_table_file_,
+      "S1 light table of the parametrized simulation of the S1 light. "
+      "If set, the energy deposits inside the table fill the sensor hits "
+      "directly and the optical scintillation is switched off.");
+
   }
 
 
@@ -58,6 +100,8 @@ namespace nexus {
   NexusPhysics::~NexusPhysics()
   {
     delete msg_;
+    delete el_table_;
+    delete s1_table_;
   }
 
 
@@ -109,12 +153,42 @@ namespace nexus {
       pmanager->AddDiscreteProcess(el);
     }
 
+    // Replace the EL photons with the parametrized simulation: every
+    // thread attaches its own model to the EL regions of the geometry,
+    // all of them sharing the table, which is read only once
+
+    if (el_table_file_ != "") {
+      {
+        G4AutoLock lock(&elTableMutex);
+        if (!el_table_)
+          el_table_ = new ELLookupTable(el_table_file_, el_table_radius_,
+                                        el_table_binning_);
+      }
+
+      G4FastSimulationManagerProcess* fastsim =
+        new G4FastSimulationManagerProcess("ELParamSimulation");
+      pmanager->AddDiscreteProcess(fastsim);
+
+      G4bool found = false;
+      G4RegionStore* regions = G4RegionStore::GetInstance();
+      for (size_t i=0; i<regions->size(); i++) {
+        if ((*regions)[i]->GetName() != "EL_REGION") continue;
+        new ELParamSimulation((*regions)[i], el_table_);
+        found = true;
+      }
+
+      if (!found)
+        G4Exception("[NexusPhysics]", "ConstructProcess()", JustWarning,
+          "The geometry has no EL_REGION. The EL lookup table is not used.");
+    }
+
 
     // Add clustering to all pertinent particles
 
     if (clustering_) {
 
       IonizationClustering* clust = new IonizationClustering();
+      clust->SetClusteringFactor(clustering_factor_);
 
       auto aParticleIterator = GetParticleIterator();
       aParticleIterator->reset();
@@ -129,6 +203,45 @@ namespace nexus {
       }
     }
 
+    // Replace the S1 photons with the parametrized simulation. The
+    // table is mapped only once and shared by the processes of all
+    // threads. The optical scintillation must be constructed before.
+
+    if (s1_table_file_ != "") {
+      {
+        G4AutoLock lock(&s1TableMutex);
+        if (!s1_table_) {
+          s1_table_ = new S1TableFile();
+          if (!s1_table_->Map(s1_table_file_)) {
+            G4String msg = "Cannot read the S1 light table: " + s1_table_->Error();
+            G4Exception("[NexusPhysics]", "ConstructProcess()", FatalException, msg);
+          }
+        }
+      }
+
+      S1ParamSimulation* s1 = new S1ParamSimulation(s1_table_);
+
+      auto aParticleIterator = GetParticleIterator();
+      aParticleIterator->reset();
+      while ((*aParticleIterator)()) {
+        G4ParticleDefinition* particle = aParticleIterator->value();
+        pmanager = particle->GetProcessManager();
+
+        if (s1->IsApplicable(*particle)) {
+          pmanager->AddDiscreteProcess(s1);
+          pmanager->AddRestProcess(s1);
+        }
+      }
+
+      G4ProcessTable* table = G4ProcessTable::GetProcessTable();
+      if (table->FindProcess("Scintillation", G4Electron::Definition()))
+        table->SetProcessActivation("Scintillation", false);
+      else
+        G4Exception("[NexusPhysics]", "ConstructProcess()", JustWarning,
+          "No optical scintillation to switch off. Register the optical "
+          "physics before NexusPhysics to avoid simulating the S1 twice.");
+    }
+
     // Add photoelectric effect to optical photons
 
     if (photoelectric_) {
@@ -16,6 +16,9 @@ class G4GenericMessenger;
 
 namespace nexus {
 
+  class ELLookupTable;
+  class S1TableFile;
+
   class NexusPhysics: public G4VPhysicsConstructor
   {
   public:
@@ -31,9 +34,18 @@ namespace nexus {
 
   private:
     G4bool clustering_;          ///< Switch on/of the ionization clustering
+    G4int clustering_factor_;    ///< Ionization electrons per track
     G4bool drift_;               ///< Switch on/of the ionization drift
     G4bool electroluminescence_; ///< Switch on/off the electroluminescence
     G4bool photoelectric_;       ///< Switch on/off the photoelectric effect
+    G4String el_table_file_;     ///< EL lookup table of the parametrized EL
+    G4double el_table_radius_;   ///< Radius of the points of the EL table
+    G4double el_table_binning_;  ///< Spacing of the points of the EL table
+
+    ELLookupTable* el_table_;    ///< Table shared by the models of all threads
+
+    G4String s1_table_file_;     ///< S1 light table of the parametrized S1
+    S1TableFile* s1_table_;      ///< Table shared by the processes of all threads
 
     G4GenericMessenger* msg_;
   };
@@ -0,0 +1,95 @@
+// ----------------------------------------------------------------------------
+// nexus | IonizationHitStore.cc
+//
+// This class is a collection of ionization hits stored column by column.
+//
+// The NEXT Collaboration
+// ----------------------------------------------------------------------------
+
+#include "IonizationHitStore.h"
+
+
+using namespace nexus;
+
+
+
+IonizationHitStore::IonizationHitStore(): G4VHitsCollection()
+{
+}
+
+
+
+IonizationHitStore::IonizationHitStore(G4String sdname, G4String colname):
+  G4VHitsCollection(sdname, colname)
+{
+}
+
+
+
+IonizationHitStore::~IonizationHitStore()
+{
+}
+
+
+
+void IonizationHitStore::Append(G4int track_id, G4double time, G4double edep,
+                                const G4ThreeVector& position)
+{
+  track_id_  .push_back(track_id);
+  time_      .push_back(time);
+  energy_dep_.push_back(edep);
+  x_.push_back(position.x());
+  y_.push_back(position.y());
+  z_.push_back(position.z());
+}
+
+
+
+void IonizationHitStore::AddToLast(G4double edep, const G4ThreeVector& position)
+{
+  if (track_id_.empty()) return;
+
+  G4double& energy = energy_dep_.back();
+  energy += edep;
+  if (energy <= 0.) return;
+
+  G4double weight = edep / energy;
+  x_.back() += (position.x() - x_.back()) * weight;
+  y_.back() += (position.y() - y_.back()) * weight;
+  z_.back() += (position.z() - z_.back()) * weight;
+}
+
+
+
+void IonizationHitStore::Clear()
+{
+  track_id_  .clear();
+  time_      .clear();
+  energy_dep_.clear();
+  x_.clear();
+  y_.clear();
+  z_.clear();
+}
+
+
+
+void IonizationHitStore::Reserve(size_t size)
+{
+  track_id_  .reserve(size);
+  time_      .reserve(size);
+  energy_dep_.reserve(size);
+  x_.reserve(size);
+  y_.reserve(size);
+  z_.reserve(size);
+}
+
+
+
+G4VHit* IonizationHitStore::GetHit(size_t) const
+{
+  G4Exception("[IonizationHitStore]", "GetHit()", FatalException,
+              "The hits of this collection are not objects: read them "
+              "through GetTrackIDs(), GetTimes(), GetEnergyDeposits(), "
+              "GetX(), GetY() and GetZ().");
+  return 0;
+}
@@ -0,0 +1,88 @@
+// ----------------------------------------------------------------------------
+// nexus | IonizationHitStore.h
+//
+// This class is a collection of ionization hits stored column by column.
+//
+// The NEXT Collaboration
+// ----------------------------------------------------------------------------
+
+#ifndef IONIZATION_HIT_STORE_H
+#define IONIZATION_HIT_STORE_H
+
+#include <G4VHitsCollection.hh>
+#include <G4ThreeVector.hh>
+#include <vector>
+
+
+namespace nexus {
+
+  /// Collection of ionization hits with a contiguous array per
+  /// property (structure of arrays), instead of a hit object per
+  /// deposit. The arrays can be reserved up front (the sensitive
+  /// detector reserves as many hits as its previous event had) and
+  /// are read as whole columns by the persistency. The store can only
+  /// be read through its column accessors: there is no G4VHit to get.
+
+  class IonizationHitStore: public G4VHitsCollection
+  {
+  public:
+    /// Constructor
+    IonizationHitStore();
+    /// Constructor of the collection of a sensitive detector
+    IonizationHitStore(G4String sdname, G4String colname);
+    /// Destructor
+    virtual ~IonizationHitStore();
+
+    /// Append a hit
+    void Append(G4int track_id, G4double time, G4double edep,
+                const G4ThreeVector& position);
+    /// Add a deposit to the last hit, moving it to the
+    /// energy-weighted mean position
+    void AddToLast(G4double edep, const G4ThreeVector& position);
+    /// Remove all the hits, keeping the memory of the arrays
+    void Clear();
+    /// Reserve the arrays for a number of hits
+    void Reserve(size_t size);
+
+    /// Number of hits
+    virtual size_t GetSize() const;
+    /// Hits are not objects in this collection: a fatal exception
+    virtual G4VHit* GetHit(size_t) const;
+
+    const std::vector<G4int>&    GetTrackIDs() const;
+    const std::vector<G4double>& GetTimes() const;
+    const std::vector<G4double>& GetEnergyDeposits() const;
+    const std::vector<G4double>& GetX() const;
+    const std::vector<G4double>& GetY() const;
+    const std::vector<G4double>& GetZ() const;
+
+  private:
+    std::vector<G4int>    track_id_;
+    std::vector<G4double> time_;
+    std::vector<G4double> energy_dep_;
+    std::vector<G4double> x_;
+    std::vector<G4double> y_;
+    std::vector<G4double> z_;
+  };
+
+
+  // INLINE DEFINITIONS //////////////////////////////////////////////
+
+  inline size_t IonizationHitStore::GetSize() const { return track_id_.size(); }
+
+  inline const std::vector<G4int>& IonizationHitStore::GetTrackIDs() const
+  { return track_id_; }
+  inline const std::vector<G4double>& IonizationHitStore::GetTimes() const
+  { return time_; }
+  inline const std::vector<G4double>& IonizationHitStore::GetEnergyDeposits() const
+  { return energy_dep_; }
+  inline const std::vector<G4double>& IonizationHitStore::GetX() const
+  { return x_; }
+  inline const std::vector<G4double>& IonizationHitStore::GetY() const
+  { return y_; }
+  inline const std::vector<G4double>& IonizationHitStore::GetZ() const
+  { return z_; }
+
+} // end namespace nexus
+
+#endif
@@ -16,6 +16,7 @@
 #include <G4SDManager.hh>
 #include <G4Step.hh>
 #include <G4OpticalPhoton.hh>
+#include <G4GenericMessenger.hh>
 
 
 
@@ -24,15 +25,56 @@ using namespace nexus;
 
 
 IonizationSD::IonizationSD(const G4String& name):
-  G4VSensitiveDetector(name), include_(true)
+  G4VSensitiveDetector(name), IHC_(0), store_(0), last_size_(0), include_(true), msg_(0),
+  merge_dist_(0.), merge_time_(0.), soa_(false),
+  open_track_id_(-1), open_time_(0.), open_hit_(0),
+  trj_track_id_(-1), trj_(0)
 {
   collectionName.insert(GetCollectionUniqueName());
+
+  // Every thread defines the commands for its own instance,
+  // so that the worker threads replay them as well
+  G4String dir = "/nexus/ionization" + GetFullPathName() + "/";
+  msg_ = new G4GenericMessenger(this, dir,
+                                "Control commands of the ionization hits.");
+
+  G4GenericMessenger::Command& dist_cmd =
+    msg_->DeclareProperty("merge_distance", merge_dist_,
+                          "Merge consecutive steps of a track within this "
+                          "distance of the first one into a single hit. "
+                          "0 creates a hit per step.");
+  dist_cmd.SetUnitCategory("Length");
+  dist_cmd.SetRange("merge_distance>=0.");
+
+  G4GenericMessenger::Command& time_cmd =
+    msg_->DeclareProperty("merge_time", merge_time_,
+                          "Merge only the steps within this time of the "
+                          "first one. 0 means no limit.");
+  time_cmd.SetUnitCategory("Time");
+  time_cmd.SetRange("merge_time>=0.");
+
+  msg_->DeclareProperty("soa_hits", soa_,
+                        "Store the hits as contiguous arrays of their "
+                        "properties instead of one object per hit.");
 }
 
 
 
 IonizationSD::~IonizationSD()
 {
+  delete msg_;
+}
+
+
+
+G4VSensitiveDetector* IonizationSD::Clone() const
+{
+  IonizationSD* sd = new IonizationSD(GetFullPathName());
+  sd->IncludeInTotalEnergyDeposit(include_);
+  sd->SetMergeDistance(merge_dist_);
+  sd->SetMergeTime(merge_time_);
+  sd->SetStructureOfArrays(soa_);
+  return sd;
 }
 
 
@@ -50,13 +92,31 @@ void IonizationSD::Initialize(G4HCofThisEvent* hce)
   // Create a collection of ionization hits and add it to
   // the collection of hits of the event
 
-  IHC_ =
-    new IonizationHitsCollection(SensitiveDetectorName, collectionName[0]);
+  G4VHitsCollection* hc = 0;
+  if (soa_) {
+    // The event owns (and deletes) its collections, so the arrays are
+    // reserved for as many hits as the previous event had rather than
+    // grown hit by hit
+    store_ = new IonizationHitStore(SensitiveDetectorName, collectionName[0]);
+    store_->Reserve(last_size_);
+    IHC_ = 0;
+    hc = store_;
+  }
+  else {
+    IHC_ = new IonizationHitsCollection(SensitiveDetectorName, collectionName[0]);
+    store_ = 0;
+    hc = IHC_;
+  }
 
   G4int hcid =
     G4SDManager::GetSDMpointer()->GetCollectionID(SensitiveDetectorName+"/"+collectionName[0]);
-  hce->AddHitsCollection(hcid, IHC_);
+  hce->AddHitsCollection(hcid, hc);
 
+  // Track IDs start over with every event
+  open_track_id_ = -1;
+  open_hit_ = 0;
+  trj_track_id_ = -1;
+  trj_ = 0;
 }
 
 
@@ -74,25 +134,52 @@ G4bool IonizationSD::ProcessHits(G4Step* step, G4TouchableHistory*)
   // Discard steps where no energy was deposited in the detector
   if (edep <= 0.) return false;
 
-  // Create a hit and set its properties
-  IonizationHit* hit = new IonizationHit();
-  hit->SetTrackID(step->GetTrack()->GetTrackID());
-  hit->SetTime(step->GetTrack()->GetGlobalTime());
-  hit->SetEnergyDeposit(edep);
-  hit->SetPosition(step->GetPostStepPoint()->GetPosition());
+  G4int track_id = track->GetTrackID();
+  G4double time = track->GetGlobalTime();
+  G4ThreeVector xyz = step->GetPostStepPoint()->GetPosition();
+
+  // Steps of a track come one after another, so only the last hit
+  // of the collection can take this one
+  if (merge_dist_ > 0. && track_id == open_track_id_ &&
+      (xyz - open_origin_).mag2() <= merge_dist_ * merge_dist_ &&
+      (merge_time_ <= 0. || time - open_time_ <= merge_time_)) {
+    if (store_) {
+      store_->AddToLast(edep, xyz);
+    }
+    else {
+      G4double energy = open_hit_->GetEnergyDeposit() + edep;
+      open_hit_->SetPosition(open_hit_->GetPosition() +
+                             (xyz - open_hit_->GetPosition()) * (edep / energy));
+      open_hit_->SetEnergyDeposit(energy);
+    }
+  }
+  else {
+    if (store_) {
+      store_->Append(track_id, time, edep, xyz);
+    }
+    else {
+      // Create a hit and set its properties
+      IonizationHit* hit = new IonizationHit();
+      hit->SetTrackID(track_id);
+      hit->SetTime(time);
+      hit->SetEnergyDeposit(edep);
+      hit->SetPosition(xyz);
+
+      // Add hit to collection
+      IHC_->insert(hit);
+      open_hit_ = hit;
+    }
 
-  // Add hit to collection
-  IHC_->insert(hit);
+    open_track_id_ = track_id;
+    open_time_     = time;
+    open_origin_   = xyz;
+  }
 
   // Add energy deposit to the trajectory associated
   // to the current track
   if (include_) {
-    Trajectory* trj =
-      (Trajectory*) TrajectoryMap::Get(step->GetTrack()->GetTrackID());
-    if (trj) {
-      edep += trj->GetEnergyDeposit();
-      trj->SetEnergyDeposit(edep);
-    }
+    Trajectory* trj = GetTrajectory(track_id);
+    if (trj) trj->SetEnergyDeposit(trj->GetEnergyDeposit() + edep);
   }
 
   return true;
@@ -100,6 +187,21 @@ G4bool IonizationSD::ProcessHits(G4Step* step, G4TouchableHistory*)
 
 
 
+Trajectory* IonizationSD::GetTrajectory(G4int track_id)
+{
+  // The trajectory of a track is stored before it is stepped
+  if (track_id != trj_track_id_) {
+    trj_ = (Trajectory*) TrajectoryMap::Get(track_id);
+    trj_track_id_ = track_id;
+  }
+  return trj_;
+}
+
+
+
 void IonizationSD::EndOfEvent(G4HCofThisEvent*)
 {
+  if (store_) last_size_ = store_->GetSize();
+  open_track_id_ = -1;
+  open_hit_ = 0;
 }
@@ -11,15 +11,26 @@
 
 #include <G4VSensitiveDetector.hh>
 #include "IonizationHit.h"
+#include "IonizationHitStore.h"
 
 class G4Step;
 class G4HCofThisEvent;
 class G4TouchableHistory;
+class G4GenericMessenger;
 
 
 namespace nexus {
 
-  /// Sensitive detector to create ionization hits
+  class Trajectory;
+
+  /// Sensitive detector to create ionization hits.
+  /// Consecutive steps of a track may be merged into the same hit,
+  /// as long as they lie within a distance of (and, optionally, a time
+  /// after) its first step. The hit keeps the time of its first step
+  /// and the energy-weighted mean position of all of them. Hits are
+  /// either IonizationHit objects or, with soa_hits, the columns of an
+  /// IonizationHitStore. The commands /nexus/ionization/<sdname>/...
+  /// exist once the geometry is built, so they go in a delayed macro.
 
   class IonizationSD: public G4VSensitiveDetector
   {
@@ -35,6 +46,10 @@ namespace nexus {
 
     void EndOfEvent(G4HCofThisEvent*);
 
+    /// Return a copy of this sensitive detector, with the same
+    /// configuration, for a worker thread
+    G4VSensitiveDetector* Clone() const;
+
     /// Return the unique name of the hits collection created
     /// by this sensitive detector. This will be used by the persistency
     /// manager to fetch the collection from the G4HCofThisEvent object.
@@ -42,18 +57,51 @@ namespace nexus {
 
     void IncludeInTotalEnergyDeposit(G4bool);
 
+    /// Merge the steps of a track within this distance (0: never)
+    void SetMergeDistance(G4double);
+    /// Merge the steps of a track within this time (0: any time)
+    void SetMergeTime(G4double);
+    /// Store the hits in an IonizationHitStore
+    void SetStructureOfArrays(G4bool);
+
   private:
     ///
     virtual G4bool ProcessHits(G4Step*, G4TouchableHistory*);
 
+    /// Trajectory of a track, looked up once per track
+    Trajectory* GetTrajectory(G4int track_id);
+
   private:
     IonizationHitsCollection* IHC_;
+    IonizationHitStore* store_; ///< Collection of hits with soa_hits
+    size_t last_size_;          ///< Hits of the previous event
     G4String det_name_;
     G4bool include_;
+
+    G4GenericMessenger* msg_;
+
+    G4double merge_dist_; ///< Distance of the steps merged into a hit
+    G4double merge_time_; ///< Time of the steps merged into a hit
+    G4bool soa_;          ///< Store the hits in an IonizationHitStore?
+
+    G4int open_track_id_;       ///< Track of the hit the next step may
+                                ///< be merged into (-1: none)
+    G4double open_time_;        ///< Time of the open hit
+    G4ThreeVector open_origin_; ///< Position of the first step of the open hit
+    IonizationHit* open_hit_;   ///< Open hit, without soa_hits
+
+    G4int trj_track_id_; ///< Track of the cached trajectory
+    Trajectory* trj_;    ///< Trajectory of the last track stepped
   };
 
   inline void IonizationSD::IncludeInTotalEnergyDeposit(G4bool inc)
   { include_ = inc; }
+  inline void IonizationSD::SetMergeDistance(G4double d)
+  { merge_dist_ = d; }
+  inline void IonizationSD::SetMergeTime(G4double t)
+  { merge_time_ = t; }
+  inline void IonizationSD::SetStructureOfArrays(G4bool soa)
+  { soa_ = soa; }
 
 } // end namespace nexus
 
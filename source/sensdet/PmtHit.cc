@@ -8,23 +8,35 @@
 
 #include "PmtHit.h"
 
+#include <algorithm>
+#include <cmath>
+
 
 using namespace nexus;
 
 
-G4Allocator<PmtHit> PmtHitAllocator;
+G4ThreadLocal G4Allocator<PmtHit>* PmtHitAllocator = 0;
+
+
+namespace {
+  /// Contiguous bins that a histogram can always have
+  const G4long DENSE_BINS = 1024;
+  /// Beyond them, maximum ratio of bins to bins with counts
+  const G4long MAX_SPARSENESS = 8;
+}
 
 
 
 PmtHit::PmtHit():
-  G4VHit(), pmt_id_(-1.), bin_size_(0.)
+  G4VHit(), pmt_id_(-1.), bin_size_(0.), first_bin_(0), filled_bins_(0)
 {
 }
 
 
 
 PmtHit::PmtHit(G4int id, const G4ThreeVector& position, G4double bin_size):
-  G4VHit(), pmt_id_(id),  bin_size_(bin_size), position_(position)
+  G4VHit(), pmt_id_(id),  bin_size_(bin_size), position_(position),
+  first_bin_(0), filled_bins_(0)
 {
 }
 
@@ -48,7 +60,10 @@ const PmtHit& PmtHit::operator=(const PmtHit& other)
   pmt_id_    = other.pmt_id_;
   bin_size_  = other.bin_size_;
   position_  = other.position_;
-  histogram_ = other.histogram_;
+  first_bin_   = other.first_bin_;
+  counts_      = other.counts_;
+  filled_bins_ = other.filled_bins_;
+  outliers_    = other.outliers_;
 
   return *this;
 }
@@ -64,7 +79,7 @@ G4int PmtHit::operator==(const PmtHit& other) const
 
 void PmtHit::SetBinSize(G4double bin_size)
 {
-  if (histogram_.size() == 0) {
+  if (counts_.empty() && outliers_.empty()) {
     bin_size_ = bin_size;
   }
   else {
@@ -77,6 +92,78 @@ void PmtHit::SetBinSize(G4double bin_size)
 
 void PmtHit::Fill(G4double time, G4int counts)
 {
-  G4double time_bin = floor(time/bin_size_) * bin_size_;
-  histogram_[time_bin] += counts;
+  G4long bin = (G4long) std::floor(time/bin_size_);
+
+  if (counts_.empty()) {
+    first_bin_ = bin;
+    counts_.push_back(0);
+  }
+
+  G4long index = bin - first_bin_;
+  if (index < 0 || index >= (G4long) counts_.size()) {
+    if (!Extend(bin)) {
+      outliers_[bin] += counts;
+      return;
+    }
+    index = bin - first_bin_;
+  }
+
+  if (counts_[index] == 0) filled_bins_++;
+  counts_[index] += counts;
+}
+
+
+
+G4bool PmtHit::Extend(G4long bin)
+{
+  G4long size = counts_.size();
+  G4long end = std::max(first_bin_ + size, bin + 1);
+  G4long max_size = std::max(DENSE_BINS, MAX_SPARSENESS * (filled_bins_ + 1));
+  if (end - std::min(first_bin_, bin) > max_size)
+    return false;
+
+  if (bin < first_bin_) {
+    // Leave room below too, so that filling backwards in time
+    // does not move the bins every time, as long as the bins
+    // do not become too sparse with it
+    G4long first = std::min(bin, first_bin_ - size/2);
+    if (bin >= 0) first = std::max(first, (G4long) 0);
+    first = std::max(first, end - max_size);
+    counts_.insert(counts_.begin(), first_bin_ - first, 0);
+    first_bin_ = first;
+  }
+  else {
+    counts_.resize(bin - first_bin_ + 1, 0);
+  }
+
+  // Bins kept apart that are now covered
+  G4long last = first_bin_ + (G4long) counts_.size();
+  std::map<G4long, G4int>::iterator it = outliers_.lower_bound(first_bin_);
+  while (it != outliers_.end() && it->first < last) {
+    G4int& counts = counts_[it->first - first_bin_];
+    if (counts == 0) filled_bins_++;
+    counts += it->second;
+    it = outliers_.erase(it);
+  }
+
+  return true;
+}
+
+
+
+void PmtHit::GetHistogram(std::vector<std::pair<unsigned int, unsigned int> >& bins) const
+{
+  bins.clear();
+
+  std::map<G4long, G4int>::const_iterator it = outliers_.begin();
+  for (; it != outliers_.end() && it->first < first_bin_; ++it)
+    bins.push_back(std::make_pair((unsigned int) it->first, (unsigned int) it->second));
+
+  for (size_t i=0; i<counts_.size(); i++)
+    if (counts_[i] != 0)
+      bins.push_back(std::make_pair((unsigned int) (first_bin_ + i),
+                                    (unsigned int) counts_[i]));
+
+  for (; it != outliers_.end(); ++it)
+    bins.push_back(std::make_pair((unsigned int) it->first, (unsigned int) it->second));
 }
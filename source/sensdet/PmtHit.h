@@ -14,6 +14,9 @@
 #include <G4Allocator.hh>
 #include <G4ThreeVector.hh>
 
+#include <map>
+#include <vector>
+
 
 namespace nexus {
 
@@ -58,22 +61,33 @@ namespace nexus {
     /// Adds counts to a given time bin
     void Fill(G4double time, G4int counts=1);
 
-    const std::map<G4double, G4int>& GetHistogram() const;
+    /// Fills the (time bin number, counts) pairs of the bins
+    /// with counts, in time order
+    void GetHistogram(std::vector<std::pair<unsigned int, unsigned int> >&) const;
+
+  private:
+    /// Extend the dense bins to cover a bin, if they do not become too
+    /// sparse. Returns false if the bin must be kept apart.
+    G4bool Extend(G4long bin);
 
   private:
     G4int pmt_id_;           ///< Detector ID number
     G4double bin_size_;      ///< Size of time bin
     G4ThreeVector position_; ///< Detector position
 
-    /// Sparse histogram with number of photons detected per time bin
-    std::map<G4double, G4int> histogram_;
+    /// Histogram with number of photons detected per time bin: contiguous
+    /// bins from first_bin_ on, and the few bins far from them apart
+    G4long first_bin_;
+    std::vector<G4int> counts_;
+    G4int filled_bins_; ///< bins of counts_ with counts
+    std::map<G4long, G4int> outliers_;
   };
 
 } // namespace nexus
 
 
 typedef G4THitsCollection<nexus::PmtHit> PmtHitsCollection;
-extern G4Allocator<nexus::PmtHit> PmtHitAllocator;
+extern G4ThreadLocal G4Allocator<nexus::PmtHit>* PmtHitAllocator;
 
 
 // INLINE DEFINITIONS ////////////////////////////////////////////////
@@ -81,10 +95,13 @@ extern G4Allocator<nexus::PmtHit> PmtHitAllocator;
 namespace nexus {
 
   inline void* PmtHit::operator new(size_t)
-  { return ((void*) PmtHitAllocator.MallocSingle()); }
+  {
+    if (!PmtHitAllocator) PmtHitAllocator = new G4Allocator<PmtHit>;
+    return ((void*) PmtHitAllocator->MallocSingle());
+  }
 
   inline void PmtHit::operator delete(void* hit)
-  { PmtHitAllocator.FreeSingle((PmtHit*) hit); }
+  { PmtHitAllocator->FreeSingle((PmtHit*) hit); }
 
   inline G4int PmtHit::GetPmtID() const { return pmt_id_; }
   inline void PmtHit::SetPmtID(G4int id) { pmt_id_ = id; }
@@ -94,9 +111,6 @@ namespace nexus {
   inline G4ThreeVector PmtHit::GetPosition() const { return position_; }
   inline void PmtHit::SetPosition(const G4ThreeVector& p) { position_ = p; }
 
-  inline const std::map<G4double, G4int>& PmtHit::GetHistogram() const
-  { return histogram_; }
-
 } // namespace nexus
 
 #endif
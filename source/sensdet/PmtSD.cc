@@ -37,6 +37,18 @@ namespace nexus {
 
 
 
+  G4VSensitiveDetector* PmtSD::Clone() const
+  {
+    PmtSD* sd = new PmtSD(GetFullPathName());
+    sd->SetDetectorVolumeDepth(sensor_depth_);
+    sd->SetMotherVolumeDepth(mother_depth_);
+    sd->SetDetectorNamingOrder(naming_order_);
+    sd->SetTimeBinning(timebinning_);
+    return sd;
+  }
+
+
+
   G4String PmtSD::GetCollectionUniqueName()
   {
     return "PmtHitsCollection";
@@ -53,6 +65,22 @@ namespace nexus {
       GetCollectionID(this->GetName()+"/"+this->GetCollectionName(0));
 
     HCE->AddHitsCollection(HCID, HC_);
+
+    hits_.clear();
+
+    // Retrieve the pointer to the optical boundary process once.
+    // The processes of the optical photon are not defined yet when
+    // the sensitive detector is built, but they are by the first event.
+    if (!boundary_) {
+      G4ProcessManager* pm = G4OpticalPhoton::Definition()->GetProcessManager();
+      G4ProcessVector* pv = pm ? pm->GetProcessList() : 0;
+      for (size_t i=0; pv && i<pv->size(); i++) {
+        if ((*pv)[i]->GetProcessName() == "OpBoundary") {
+          boundary_ = (G4OpBoundaryProcess*) (*pv)[i];
+          break;
+        }
+      }
+    }
   }
 
 
@@ -63,19 +91,8 @@ namespace nexus {
     G4ParticleDefinition* pdef = step->GetTrack()->GetDefinition();
     if (pdef != G4OpticalPhoton::Definition()) return false;
 
-    // Retrieve the pointer to the optical boundary process, if it has
-    // not been done yet (i.e., if the pointer is not defined)
-    if (!boundary_) {
-      // Get the list of processes defined for the optical photon
-      // and loop through it to find the optical boundary process.
-      G4ProcessVector* pv = pdef->GetProcessManager()->GetProcessList();
-      for (size_t i=0; i<pv->size(); i++) {
-   	if ((*pv)[i]->GetProcessName() == "OpBoundary") {
-   	  boundary_ = (G4OpBoundaryProcess*) (*pv)[i];
-   	  break;
-   	}
-      }
-    }
+    // Without optical boundary process, no photon can be detected
+    if (!boundary_) return false;
 
     // Check if the photon has reached a geometry boundary
     if (step->GetPostStepPoint()->GetStepStatus() == fGeomBoundary) {
@@ -87,26 +104,10 @@ namespace nexus {
 
 	G4int pmt_id = FindPmtID(touchable);
 
- 	PmtHit* hit = 0;
-	for (size_t i=0; i<HC_->entries(); i++) {
- 	  if ((*HC_)[i]->GetPmtID() == pmt_id) {
- 	    hit = (*HC_)[i];
-	    break;
-	  }
- 	}
-
- 	// If no hit associated to this sensor exists already,
- 	// create it and set main properties
- 	if (!hit) {
- 	  hit = new PmtHit();
- 	  hit->SetPmtID(pmt_id);
- 	  hit->SetBinSize(timebinning_);
- 	  hit->SetPosition(touchable->GetTranslation());
- 	  HC_->insert(hit);
- 	}
-
- 	G4double time = step->GetPostStepPoint()->GetGlobalTime();
- 	hit->Fill(time);
+	// A weighted photon counts as many photons as its weight
+	G4int counts = G4lrint(step->GetTrack()->GetWeight());
+	G4double time = step->GetPostStepPoint()->GetGlobalTime();
+	if (counts > 0) AddPhotons(pmt_id, touchable->GetTranslation(), time, counts);
       }
     }
 
@@ -115,7 +116,27 @@ namespace nexus {
 
 
 
-  G4int PmtSD::FindPmtID(const G4VTouchable* touchable)
+  void PmtSD::AddPhotons(G4int pmt_id, const G4ThreeVector& position,
+                         G4double time, G4int counts)
+  {
+    PmtHit*& hit = hits_[pmt_id];
+
+    // If no hit associated to this sensor exists already,
+    // create it and set main properties
+    if (!hit) {
+      hit = new PmtHit();
+      hit->SetPmtID(pmt_id);
+      hit->SetBinSize(timebinning_);
+      hit->SetPosition(position);
+      HC_->insert(hit);
+    }
+
+    hit->Fill(time, counts);
+  }
+
+
+
+  G4int PmtSD::FindPmtID(const G4VTouchable* touchable) const
   {
     G4int pmtid = touchable->GetCopyNumber(sensor_depth_);
     if (naming_order_ != 0) {
@@ -13,6 +13,8 @@
 #include <G4VSensitiveDetector.hh>
 #include "PmtHit.h"
 
+#include <unordered_map>
+
 class G4Step;
 class G4HCofThisEvent;
 class G4VTouchable;
@@ -39,6 +41,10 @@ namespace nexus {
     /// Method invoked at the end of every event
     void EndOfEvent(G4HCofThisEvent*);
 
+    /// Return a copy of this sensitive detector, with the same
+    /// configuration, for a worker thread
+    G4VSensitiveDetector* Clone() const;
+
     /// Set the depth of the sensitive detector in the geometry hierarchy
     void SetDetectorVolumeDepth(G4int);
     /// Return the depth of the sensitive detector in the volume hierarchy
@@ -57,6 +63,15 @@ namespace nexus {
     /// Set a time binning for the pmt hits
     void SetTimeBinning(G4double);
 
+    /// Return the id of the sensor of a touchable of this detector
+    G4int FindPmtID(const G4VTouchable*) const;
+
+    /// Add photons detected by a sensor at a given position to the
+    /// hits of the current event. Parametrized simulations use it to
+    /// fill the hits without tracking the photons.
+    void AddPhotons(G4int pmt_id, const G4ThreeVector& position,
+                    G4double time, G4int counts=1);
+
     /// Return the unique name of the hits collection created
     /// by this sensitive detector. This will be used by the
     /// persistency manager to select the collection.
@@ -66,8 +81,6 @@ namespace nexus {
 
     G4bool ProcessHits(G4Step*, G4TouchableHistory*);
 
-    G4int FindPmtID(const G4VTouchable*);
-
     G4int naming_order_; ///< Order of the naming scheme
     G4int sensor_depth_; ///< Depth of the SD in the geometry tree
     G4int mother_depth_; ///< Depth of the SD's mother in the geometry tree
@@ -77,6 +90,10 @@ namespace nexus {
     G4OpBoundaryProcess* boundary_; ///< Pointer to the optical boundary process
 
     PmtHitsCollection* HC_; ///< Pointer to the collection of hits
+
+    /// Hit of each sensor in the current event, so that detected
+    /// photons find it in constant time
+    std::unordered_map<G4int, PmtHit*> hits_;
   };
 
   // INLINE METHODS //////////////////////////////////////////////////
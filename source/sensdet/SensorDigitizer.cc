@@ -0,0 +1,324 @@
+// ----------------------------------------------------------------------------
+// nexus | SensorDigitizer.cc
+//
+// This class turns the photons detected by a photosensor into the
+// waveform sampled by its electronics.
+//
+// The NEXT Collaboration
+// ----------------------------------------------------------------------------
+
+#include "SensorDigitizer.h"
+
+#include <G4GenericMessenger.hh>
+#include <G4UIcommand.hh>
+#include <G4Poisson.hh>
+#include <Randomize.hh>
+
+#include <sstream>
+#include <cmath>
+#include <algorithm>
+
+
+using namespace nexus;
+
+
+namespace {
+  /// Largest number of samples of a waveform
+  const size_t MAX_SAMPLES = 1 << 24;
+  /// Largest ADC count
+  const long MAX_ADC = 0xFFFF;
+  /// Length of a pulse, in rise plus decay times
+  const double PULSE_LENGTH = 10.;
+}
+
+
+
+SensorDigitizer::SensorDigitizer():
+  msg_(0), store_photons_(true)
+{
+  Parameters defaults = {false, 0., 0., 1., 0., 0., 0., 0., 0., 0., 0.};
+  params_["all"] = defaults;
+
+  msg_ = new G4GenericMessenger(this, "/nexus/digitization/",
+                                "Control commands of the sensor digitization.");
+
+  msg_->DeclareMethod("sensor", &SensorDigitizer::SetSensor,
+                      "Digitize the sensors of a sensitive detector "
+                      "(or all of them): <sdname|all>.");
+  msg_->DeclareMethod("spe_rise_time", &SensorDigitizer::SetRiseTime,
+                      "Rise time of the single-photoelectron response: "
+                      "<sdname|all> <time> <unit>.");
+  msg_->DeclareMethod("spe_decay_time", &SensorDigitizer::SetDecayTime,
+                      "Decay time of the single-photoelectron response "
+                      "(0, with no rise time, puts all the charge in one "
+                      "sample): <sdname|all> <time> <unit>.");
+  msg_->DeclareMethod("gain", &SensorDigitizer::SetGain,
+                      "ADC counts per photoelectron: <sdname|all> <gain>.");
+  msg_->DeclareMethod("gain_spread", &SensorDigitizer::SetGainSpread,
+                      "Relative spread of the gain: <sdname|all> <spread>.");
+  msg_->DeclareMethod("dark_rate", &SensorDigitizer::SetDarkRate,
+                      "Rate of dark counts: <sdname|all> <rate> <unit>.");
+  msg_->DeclareMethod("baseline", &SensorDigitizer::SetBaseline,
+                      "ADC counts without signal: <sdname|all> <counts>.");
+  msg_->DeclareMethod("noise", &SensorDigitizer::SetNoise,
+                      "Rms of the baseline in ADC counts: <sdname|all> <rms>.");
+  msg_->DeclareMethod("sampling_period", &SensorDigitizer::SetPeriod,
+                      "Sampling period (0: the time binning of the sensor): "
+                      "<sdname|all> <time> <unit>.");
+  msg_->DeclareMethod("window", &SensorDigitizer::SetWindow,
+                      "Readout window from time zero (0: only the samples "
+                      "of the pulses): <sdname|all> <time> <unit>.");
+  msg_->DeclareMethod("threshold", &SensorDigitizer::SetThreshold,
+                      "Store only the samples this number of ADC counts "
+                      "above the baseline (0: all of them): <sdname|all> <counts>.");
+  msg_->DeclareProperty("store_photons", store_photons_,
+                        "Store the detected photons of the digitized "
+                        "sensors as well.");
+}
+
+
+
+SensorDigitizer::~SensorDigitizer()
+{
+  delete msg_;
+}
+
+
+
+G4bool SensorDigitizer::IsEnabled() const
+{
+  std::map<G4String, Parameters>::const_iterator it;
+  for (it = params_.begin(); it != params_.end(); ++it)
+    if (it->second.enabled) return true;
+  return false;
+}
+
+
+
+G4bool SensorDigitizer::IsEnabled(const G4String& sdname) const
+{
+  return Get(sdname).enabled;
+}
+
+
+
+const SensorDigitizer::Parameters& SensorDigitizer::Get(const G4String& sdname) const
+{
+  std::map<G4String, Parameters>::const_iterator it = params_.find(sdname);
+  if (it == params_.end()) it = params_.find("all");
+  return it->second;
+}
+
+
+
+void SensorDigitizer::SetSensor(G4String sdname)
+{
+  // Sensitive detectors set on their own start with the settings of all
+  if (params_.find(sdname) == params_.end())
+    params_[sdname] = params_["all"];
+
+  params_[sdname].enabled = true;
+
+  if (sdname == "all") {
+    std::map<G4String, Parameters>::iterator it;
+    for (it = params_.begin(); it != params_.end(); ++it)
+      it->second.enabled = true;
+  }
+}
+
+
+
+void SensorDigitizer::Set(G4String args, G4double Parameters::* member,
+                          G4bool dimensioned, const char* method)
+{
+  std::istringstream iss(args);
+  G4String sdname, value;
+  iss >> sdname;
+  std::getline(iss, value);
+
+  G4double v = dimensioned ?
+    G4UIcommand::ConvertToDimensionedDouble(value) :
+    G4UIcommand::ConvertToDouble(value);
+  if (v < 0.) {
+    G4Exception("[SensorDigitizer]", method, JustWarning,
+                "Digitization parameters cannot be negative.");
+    return;
+  }
+
+  if (params_.find(sdname) == params_.end())
+    params_[sdname] = params_["all"];
+
+  params_[sdname].*member = v;
+
+  if (sdname == "all") {
+    std::map<G4String, Parameters>::iterator it;
+    for (it = params_.begin(); it != params_.end(); ++it)
+      it->second.*member = v;
+  }
+}
+
+
+
+void SensorDigitizer::SetRiseTime(G4String args)
+{ Set(args, &Parameters::rise_time, true, "SetRiseTime()"); }
+
+void SensorDigitizer::SetDecayTime(G4String args)
+{ Set(args, &Parameters::decay_time, true, "SetDecayTime()"); }
+
+void SensorDigitizer::SetGain(G4String args)
+{ Set(args, &Parameters::gain, false, "SetGain()"); }
+
+void SensorDigitizer::SetGainSpread(G4String args)
+{ Set(args, &Parameters::gain_spread, false, "SetGainSpread()"); }
+
+void SensorDigitizer::SetDarkRate(G4String args)
+{ Set(args, &Parameters::dark_rate, true, "SetDarkRate()"); }
+
+void SensorDigitizer::SetBaseline(G4String args)
+{ Set(args, &Parameters::baseline, false, "SetBaseline()"); }
+
+void SensorDigitizer::SetNoise(G4String args)
+{ Set(args, &Parameters::noise, false, "SetNoise()"); }
+
+void SensorDigitizer::SetPeriod(G4String args)
+{ Set(args, &Parameters::period, true, "SetPeriod()"); }
+
+void SensorDigitizer::SetWindow(G4String args)
+{ Set(args, &Parameters::window, true, "SetWindow()"); }
+
+void SensorDigitizer::SetThreshold(G4String args)
+{ Set(args, &Parameters::threshold, false, "SetThreshold()"); }
+
+
+
+G4double SensorDigitizer::PulseIntegral(const Parameters& p, G4double time) const
+{
+  if (time <= 0.) return 0.;
+
+  G4double rise  = p.rise_time;
+  G4double decay = p.decay_time;
+
+  if (rise <= 0. && decay <= 0.) return 1.;
+  if (rise  <= 0.) return 1. - std::exp(-time/decay);
+  if (decay <= 0.) return 1. - std::exp(-time/rise);
+
+  // Difference of exponentials, normalized to unit area,
+  // and its limit for equal rise and decay times
+  if (std::abs(decay - rise) < 1.e-6 * decay)
+    return 1. - (1. + time/decay) * std::exp(-time/decay);
+
+  return 1. - (decay * std::exp(-time/decay) - rise * std::exp(-time/rise)) /
+    (decay - rise);
+}
+
+
+
+void SensorDigitizer::AddPulse(const Parameters& p, G4double time,
+                               G4double charge, G4double period, size_t first)
+{
+  size_t sample = (size_t) (time / period);
+  if (sample < first || sample - first >= signal_.size()) return;
+
+  // Charge of the pulse within every sample, until it is all in
+  G4double previous = 0.;
+  for (; sample - first < signal_.size(); sample++) {
+    G4double integral = PulseIntegral(p, (sample + 1) * period - time);
+    signal_[sample - first] += charge * (integral - previous);
+    previous = integral;
+    if (integral > 1. - 1.e-6) break;
+  }
+}
+
+
+
+void SensorDigitizer::Sample(const Parameters& p, const G4String& sdname,
+                             size_t first_pulse, size_t last_pulse,
+                             size_t first, size_t last, G4double period,
+                             std::vector<std::pair<unsigned int, unsigned int> >& samples)
+{
+  if (last - first > MAX_SAMPLES) {
+    G4Exception("[SensorDigitizer]", "Digitize()", JustWarning,
+                ("The waveform of a sensor of " + sdname + " is cut at "
+                 + std::to_string(MAX_SAMPLES) + " samples.").c_str());
+    last = first + MAX_SAMPLES;
+  }
+  signal_.assign(last - first, 0.);
+
+  for (size_t i=first_pulse; i<last_pulse; i++)
+    AddPulse(p, pulses_[i].first, pulses_[i].second, period, first);
+
+  for (size_t i=0; i<signal_.size(); i++) {
+    G4double value = signal_[i] + p.baseline;
+    if (p.noise > 0.) value += p.noise * G4RandGauss::shoot();
+
+    long adc = std::min(std::max(std::lround(value), 0L), MAX_ADC);
+    if (p.threshold <= 0. || adc - p.baseline >= p.threshold)
+      samples.push_back(std::make_pair((unsigned int) (first + i),
+                                       (unsigned int) adc));
+  }
+}
+
+
+
+void SensorDigitizer::Digitize(const G4String& sdname,
+                               const std::vector<std::pair<unsigned int, unsigned int> >& bins,
+                               G4double bin_size,
+                               std::vector<std::pair<unsigned int, unsigned int> >& samples)
+{
+  samples.clear();
+
+  const Parameters& p = Get(sdname);
+
+  G4double period = (p.period > 0.) ? p.period : bin_size;
+  G4double length = PULSE_LENGTH * (p.rise_time + p.decay_time);
+
+  // Without a readout window, the waveform ends with the last pulse
+  G4double end = p.window;
+  if (end <= 0.) {
+    if (bins.empty()) return;
+    end = (bins.back().first + 1) * bin_size + length;
+  }
+
+  // Photoelectrons of every bin, at its centre. The gains of n of
+  // them add up to a gaussian of sqrt(n) times their spread.
+  pulses_.clear();
+  for (size_t i=0; i<bins.size(); i++) {
+    G4double time = (bins[i].first + 0.5) * bin_size;
+    G4double n = bins[i].second;
+    G4double charge = p.gain * (n + std::sqrt(n) * p.gain_spread * G4RandGauss::shoot());
+    pulses_.push_back(std::make_pair(time, std::max(charge, 0.)));
+  }
+
+  G4long ndark = G4Poisson(p.dark_rate * end);
+  for (G4long i=0; i<ndark; i++) {
+    G4double time = G4UniformRand() * end;
+    G4double charge = p.gain * (1. + p.gain_spread * G4RandGauss::shoot());
+    pulses_.push_back(std::make_pair(time, std::max(charge, 0.)));
+  }
+
+  if (p.window > 0.) {
+    Sample(p, sdname, 0, pulses_.size(), 0,
+           (size_t) std::ceil(end / period), period, samples);
+    return;
+  }
+
+  // Otherwise, only the samples of every group of overlapping pulses
+  // are digitized, so that the baseline between an early or late
+  // stray photon and the rest of the signal is not
+  std::sort(pulses_.begin(), pulses_.end());
+
+  size_t i = 0;
+  while (i < pulses_.size()) {
+    size_t first = (size_t) (pulses_[i].first / period);
+    size_t last  = first;
+    size_t j = i;
+    for (; j < pulses_.size(); j++) {
+      size_t start = (size_t) (pulses_[j].first / period);
+      if (j > i && start > last) break;
+      last = std::max(last, std::max(start + 1,
+             (size_t) std::ceil((pulses_[j].first + length) / period)));
+    }
+    Sample(p, sdname, i, j, first, last, period, samples);
+    i = j;
+  }
+}
@@ -0,0 +1,126 @@
+// ----------------------------------------------------------------------------
+// nexus | SensorDigitizer.h
+//
+// This class turns the photons detected by a photosensor into the
+// waveform sampled by its electronics.
+//
+// The NEXT Collaboration
+// ----------------------------------------------------------------------------
+
+#ifndef SENSOR_DIGITIZER_H
+#define SENSOR_DIGITIZER_H
+
+#include <G4String.hh>
+#include <map>
+#include <vector>
+
+class G4GenericMessenger;
+
+
+namespace nexus {
+
+  /// Digitizes the time histogram of the photoelectrons of a sensor:
+  /// every photoelectron (and dark count) gives a pulse of charge
+  /// gain * (1 + gain_spread * gauss), shaped by the single-photoelectron
+  /// response (rise and decay times; zero for all the charge in one
+  /// sample), which is integrated over sampling periods numbered from
+  /// time zero on. With a readout window every sample in it is
+  /// digitized; without, only the samples of each group of overlapping
+  /// pulses. The baseline and a gaussian noise are added to every sample,
+  /// which is rounded to ADC counts between 0 and 65535. Parameters are
+  /// set per sensitive detector, or for all of them, and only the
+  /// sensitive detectors enabled are digitized.
+
+  class SensorDigitizer
+  {
+  public:
+    /// Constructor
+    SensorDigitizer();
+    /// Destructor
+    ~SensorDigitizer();
+
+    /// Is any sensitive detector digitized?
+    G4bool IsEnabled() const;
+    /// Is the sensitive detector digitized?
+    G4bool IsEnabled(const G4String& sdname) const;
+    /// Are the photons of digitized sensors stored too?
+    G4bool StorePhotons() const;
+
+    /// Digitize the (time bin, photoelectrons) histogram of a sensor of
+    /// the sensitive detector, returning the (sample, ADC counts) pairs
+    /// of the samples above the zero-suppression threshold
+    void Digitize(const G4String& sdname,
+                  const std::vector<std::pair<unsigned int, unsigned int> >& bins,
+                  G4double bin_size,
+                  std::vector<std::pair<unsigned int, unsigned int> >& samples);
+
+  private:
+    /// Electronics of a sensitive detector
+    struct Parameters {
+      G4bool enabled;       ///< is it digitized?
+      G4double rise_time;   ///< rise time of the single-pe response
+      G4double decay_time;  ///< decay time of the single-pe response
+      G4double gain;        ///< ADC counts per photoelectron
+      G4double gain_spread; ///< relative spread of the gain
+      G4double dark_rate;   ///< rate of dark counts
+      G4double baseline;    ///< ADC counts without signal
+      G4double noise;       ///< rms of the baseline, in ADC counts
+      G4double period;      ///< sampling period (0: bin size of the sensor)
+      G4double window;      ///< readout window (0: until the end of the signal)
+      G4double threshold;   ///< ADC counts above baseline of the samples
+                            ///< written (0: all of them)
+    };
+
+    /// Messenger commands, with the sensitive detector name
+    /// (or 'all') followed by the value
+    void SetSensor(G4String);
+    void SetRiseTime(G4String);
+    void SetDecayTime(G4String);
+    void SetGain(G4String);
+    void SetGainSpread(G4String);
+    void SetDarkRate(G4String);
+    void SetBaseline(G4String);
+    void SetNoise(G4String);
+    void SetPeriod(G4String);
+    void SetWindow(G4String);
+    void SetThreshold(G4String);
+
+    /// Set a parameter of a sensitive detector, or of all of them
+    void Set(G4String args, G4double Parameters::* member,
+             G4bool dimensioned, const char* method);
+
+    /// Parameters of a sensitive detector
+    const Parameters& Get(const G4String& sdname) const;
+
+    /// Fraction of the charge of a pulse within a time after its start
+    G4double PulseIntegral(const Parameters&, G4double time) const;
+
+    /// Add the charge of a pulse starting at a time to the
+    /// samples, the first of them being sample number first
+    void AddPulse(const Parameters&, G4double time, G4double charge,
+                  G4double period, size_t first);
+
+    /// Digitize the samples [first, last) with a range of the pulses
+    void Sample(const Parameters&, const G4String& sdname,
+                size_t first_pulse, size_t last_pulse,
+                size_t first, size_t last, G4double period,
+                std::vector<std::pair<unsigned int, unsigned int> >& samples);
+
+  private:
+    G4GenericMessenger* msg_;
+
+    G4bool store_photons_; ///< store the photons of digitized sensors?
+
+    std::map<G4String, Parameters> params_; ///< by sensitive detector
+
+    std::vector<std::pair<G4double, G4double> > pulses_; ///< (time, charge)
+    std::vector<G4double> signal_; ///< charge of every sample
+  };
+
+  // INLINE DEFINITIONS //////////////////////////////////////////////
+
+  inline G4bool SensorDigitizer::StorePhotons() const { return store_photons_; }
+
+} // end namespace nexus
+
+#endif
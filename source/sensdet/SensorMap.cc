@@ -0,0 +1,126 @@
+// ----------------------------------------------------------------------------
+// nexus | SensorMap.cc
+//
+// This class finds the photosensors of the geometry.
+//
+// The NEXT Collaboration
+// ----------------------------------------------------------------------------
+
+#include "SensorMap.h"
+
+#include "PmtSD.h"
+
+#include <G4TransportationManager.hh>
+#include <G4Navigator.hh>
+#include <G4NavigationHistory.hh>
+#include <G4TouchableHistory.hh>
+#include <G4ReplicaNavigation.hh>
+#include <G4VPVParameterisation.hh>
+#include <G4LogicalVolume.hh>
+
+
+namespace nexus {
+
+
+  namespace {
+    /// Largest sensor id for the array indexed by id
+    const G4int MAX_INDEXED_ID = 1 << 20;
+  }
+
+
+
+  SensorMap::SensorMap(): G4VStateDependent(), version_(0)
+  {
+  }
+
+
+
+  SensorMap::~SensorMap()
+  {
+  }
+
+
+
+  G4bool SensorMap::Notify(G4ApplicationState previous,
+                           G4ApplicationState requested)
+  {
+    // The run manager of every thread closes the geometry
+    // when a run starts, before its first event
+    if (previous == G4State_Idle && requested == G4State_GeomClosed)
+      Build();
+    return true;
+  }
+
+
+
+  G4bool SensorMap::Build()
+  {
+    sensors_.clear();
+    by_id_.clear();
+    version_++;
+
+    G4VPhysicalVolume* world = G4TransportationManager::GetTransportationManager()->
+      GetNavigatorForTracking()->GetWorldVolume();
+    if (!world) return false;
+
+    G4NavigationHistory history;
+    history.SetFirstEntry(world);
+    Build(history);
+
+    // Sensor ids are usually small and non-negative: an array
+    // indexed by id makes finding a sensor a single read
+    if (!sensors_.empty() && sensors_.begin()->first >= 0 &&
+        sensors_.rbegin()->first < MAX_INDEXED_ID) {
+      by_id_.assign(sensors_.rbegin()->first + 1, 0);
+      std::map<G4int, Sensor>::const_iterator it;
+      for (it = sensors_.begin(); it != sensors_.end(); ++it)
+        by_id_[it->first] = &it->second;
+    }
+
+    return true;
+  }
+
+
+
+  void SensorMap::Build(G4NavigationHistory& history)
+  {
+    G4LogicalVolume* logic = history.GetTopVolume()->GetLogicalVolume();
+
+    // The sensor id is built from the copy numbers of the
+    // touchable, as for the photons detected by the PmtSD
+    PmtSD* sd = dynamic_cast<PmtSD*>(logic->GetSensitiveDetector());
+    if (sd) {
+      G4TouchableHistory touchable(history);
+      Sensor sensor = {sd, touchable.GetTranslation()};
+      sensors_[sd->FindPmtID(&touchable)] = sensor;
+    }
+
+    G4ReplicaNavigation replica_nav;
+
+    for (size_t i=0; i<logic->GetNoDaughters(); i++) {
+      G4VPhysicalVolume* daughter = logic->GetDaughter(i);
+
+      if (!daughter->IsReplicated()) {
+        history.NewLevel(daughter, kNormal, daughter->GetCopyNo());
+        Build(history);
+        history.BackLevel();
+        continue;
+      }
+
+      // Every copy of a replicated volume is placed in turn
+      EVolume type = daughter->VolumeType();
+      if (type == kExternal) continue;
+      for (G4int copy=0; copy<daughter->GetMultiplicity(); copy++) {
+        if (type == kParameterised)
+          daughter->GetParameterisation()->ComputeTransformation(copy, daughter);
+        else
+          replica_nav.ComputeTransformation(copy, daughter);
+        history.NewLevel(daughter, type, copy);
+        Build(history);
+        history.BackLevel();
+      }
+    }
+  }
+
+
+} // end namespace nexus
@@ -0,0 +1,95 @@
+// ----------------------------------------------------------------------------
+// nexus | SensorMap.h
+//
+// This class finds the photosensors of the geometry.
+//
+// The NEXT Collaboration
+// ----------------------------------------------------------------------------
+
+#ifndef SENSOR_MAP_H
+#define SENSOR_MAP_H
+
+#include <G4ThreeVector.hh>
+#include <G4VStateDependent.hh>
+#include <map>
+#include <vector>
+
+class G4NavigationHistory;
+
+
+namespace nexus {
+
+  class PmtSD;
+
+  /// Position and sensitive detector of every photosensor of the
+  /// geometry, by sensor id. The geometry is walked down from the world
+  /// volume, placing every copy of replicated and parameterised volumes,
+  /// and the id of each sensor is built from its touchable as PmtSD does
+  /// for the photons it detects. Parametrized simulations of the light
+  /// use it to fill the hits of the sensors directly.
+  ///
+  /// Placing the copies of replicated volumes changes their state, so
+  /// the map is built at the start of every run of its thread, once the
+  /// geometry is closed, and never while tracking.
+
+  class SensorMap: public G4VStateDependent
+  {
+  public:
+    /// Sensor of the geometry
+    struct Sensor {
+      PmtSD* sd;
+      G4ThreeVector position;
+    };
+
+  public:
+    /// Constructor
+    SensorMap();
+    /// Destructor
+    ~SensorMap();
+
+    /// Find the sensors of the geometry of the current thread.
+    /// Returns false if there is no world volume yet.
+    G4bool Build();
+
+    /// Build the map at the start of a run
+    G4bool Notify(G4ApplicationState previous, G4ApplicationState requested);
+
+    /// Number of times the map has been built, for the users
+    /// that keep what they looked up in it
+    G4int GetVersion() const;
+
+    /// Return a sensor by id, or null if it is not in the geometry
+    const Sensor* Find(G4int sensor_id) const;
+
+    /// Number of sensors found
+    size_t GetSize() const;
+
+  private:
+    void Build(G4NavigationHistory&);
+
+  private:
+    std::map<G4int, Sensor> sensors_; ///< Sensors by id
+    std::vector<const Sensor*> by_id_; ///< Sensors indexed by id, when
+                                       ///< the ids are small enough
+    G4int version_; ///< Number of times the map has been built
+  };
+
+
+  // INLINE DEFINITIONS //////////////////////////////////////////////
+
+  inline const SensorMap::Sensor* SensorMap::Find(G4int sensor_id) const
+  {
+    if (sensor_id >= 0 && (size_t) sensor_id < by_id_.size())
+      return by_id_[sensor_id];
+    if (!by_id_.empty()) return 0;
+    std::map<G4int, Sensor>::const_iterator it = sensors_.find(sensor_id);
+    return (it != sensors_.end()) ? &it->second : 0;
+  }
+
+  inline size_t SensorMap::GetSize() const { return sensors_.size(); }
+
+  inline G4int SensorMap::GetVersion() const { return version_; }
+
+} // end namespace nexus
+
+#endif
@@ -0,0 +1,206 @@
+#include <HDF5Writer.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <catch.hpp>
+
+
+namespace {
+
+  /// Write an event with two hits and a particle
+  void WriteEvent(nexus::HDF5Writer& writer, int event)
+  {
+    writer.WriteHitInfo(event, 1, 0, 0., 0., 0., 0., 1., "ACTIVE");
+    writer.WriteHitInfo(event, 1, 1, 0., 0., 1., 0., 1., "ACTIVE");
+    writer.WriteParticleInfo(event, 1, "e-", 1, 0,
+                             0., 0., 0., 0., 0., 0., 1., 0., "ACTIVE", "ACTIVE",
+                             0., 0., 1., 0., 0., 0., 1., 1., "none", "eIoni");
+    writer.WriteEventIndex(event);
+  }
+
+  /// Number of rows of a table of a file, or -1 if the
+  /// file cannot be opened
+  long long CountRows(const std::string& filename, const char* table)
+  {
+    hid_t file;
+    H5E_BEGIN_TRY {
+      file = H5Fopen(filename.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
+    } H5E_END_TRY;
+    if (file < 0) return -1;
+
+    hid_t dataset = H5Dopen2(file, table, H5P_DEFAULT);
+    long long rows = numRows(dataset);
+    H5Dclose(dataset);
+    H5Fclose(file);
+    return rows;
+  }
+
+} // namespace
+
+
+
+TEST_CASE("HDF5Writer file of a process") {
+
+  // The processes of a job leave with _exit() once their file is
+  // closed, so the HDF5 library never gets to clean up at exit:
+  // the file must be complete as soon as it is closed.
+
+  std::string filename = "HDF5WriterTests_process.h5";
+
+  pid_t pid = fork();
+  REQUIRE(pid >= 0);
+
+  if (pid == 0) {
+    nexus::HDF5Writer writer;
+    writer.Open(filename, false);
+    writer.WriteRunInfo("num_events", "2");
+    WriteEvent(writer, 0);
+    WriteEvent(writer, 1);
+    writer.Close();
+    _exit(EXIT_SUCCESS);
+  }
+
+  int status;
+  REQUIRE(waitpid(pid, &status, 0) == pid);
+  REQUIRE(WIFEXITED(status));
+
+  REQUIRE(CountRows(filename, "/MC/hits")          == 4);
+  REQUIRE(CountRows(filename, "/MC/particles")     == 2);
+  REQUIRE(CountRows(filename, "/MC/event_index")   == 2);
+  REQUIRE(CountRows(filename, "/MC/configuration") == 1);
+
+  std::remove(filename.c_str());
+}
+
+
+
+TEST_CASE("HDF5Writer rollover") {
+
+  // A file that has been rolled over must be complete, and readable
+  // by anyone, while the writer goes on with the next one. No HDF5
+  // object of the old file may be left open.
+
+  bool swmr = false;
+
+  SECTION("Default access") {}
+
+#if H5_VERSION_GE(1,10,0)
+  SECTION("SWMR access") { swmr = true; }
+#endif
+
+  std::string first  = "HDF5WriterTests_0000.h5";
+  std::string second = "HDF5WriterTests_0001.h5";
+
+  nexus::HDF5Writer writer;
+  REQUIRE(writer.SetSwmr(swmr));
+  writer.Open(first, false);
+  writer.WriteSensorPosInfo(0, "PmtR11410", 0., 0., 0.);
+  WriteEvent(writer, 0);
+  WriteEvent(writer, 1);
+  writer.Close();
+
+  REQUIRE(H5Fget_obj_count(H5F_OBJ_ALL, H5F_OBJ_ALL) == 0);
+
+  writer.Open(second, false);
+  WriteEvent(writer, 2);
+  writer.Flush();
+
+  REQUIRE(CountRows(first, "/MC/hits")          == 4);
+  REQUIRE(CountRows(first, "/MC/event_index")   == 2);
+  REQUIRE(CountRows(first, "/MC/sns_positions") == 1);
+
+  writer.Close();
+
+  // The sensor positions are repeated in every file
+  REQUIRE(CountRows(second, "/MC/hits")          == 2);
+  REQUIRE(CountRows(second, "/MC/sns_positions") == 1);
+
+  std::remove(first.c_str());
+  std::remove(second.c_str());
+}
+
+
+
+TEST_CASE("HDF5Writer event index of the digitized response") {
+
+  // With the digitized sensor response, the event index has the
+  // row range of every event in sns_digits as well
+
+  std::string filename = "HDF5WriterTests_digits.h5";
+
+  nexus::HDF5Writer writer;
+  writer.SetDigitizedSensorResponse(true);
+  writer.Open(filename, false);
+
+  const int ndigits[] = {3, 0, 2};
+  for (int event=0; event<3; event++) {
+    std::vector<std::pair<unsigned int, unsigned int> > digits;
+    for (int i=0; i<ndigits[event]; i++)
+      digits.push_back(std::make_pair(i, 100));
+    writer.WriteSensorDigits(event, 0, digits);
+    WriteEvent(writer, event);
+  }
+  writer.Close();
+
+  REQUIRE(CountRows(filename, "/MC/sns_digits") == 5);
+
+  hid_t file    = H5Fopen(filename.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
+  hid_t dataset = H5Dopen2(file, "/MC/event_index", H5P_DEFAULT);
+  hid_t memtype = createEventIndexDigitsType();
+  std::vector<event_index_digits_t> index(3);
+  REQUIRE(H5Dread(dataset, memtype, H5S_ALL, H5S_ALL, H5P_DEFAULT,
+                  index.data()) >= 0);
+  H5Tclose(memtype);
+  H5Dclose(dataset);
+  H5Fclose(file);
+
+  const uint64_t first[] = {0, 3, 3};
+  const uint64_t last[]  = {3, 3, 5};
+  for (int event=0; event<3; event++) {
+    REQUIRE(index[event].event_id         == event);
+    REQUIRE(index[event].hits_first       == 2u * event);
+    REQUIRE(index[event].hits_last        == 2u * event + 2);
+    REQUIRE(index[event].sns_digits_first == first[event]);
+    REQUIRE(index[event].sns_digits_last  == last[event]);
+  }
+
+  std::remove(filename.c_str());
+}
+
+
+
+TEST_CASE("HDF5Writer string table") {
+
+  // Strings longer than the column are cut, always terminated
+
+  std::string filename = "HDF5WriterTests_strings.h5";
+  std::string value(2 * STRLEN, 'x');
+
+  nexus::HDF5Writer writer;
+  writer.Open(filename, false, true);
+  writer.WriteString(0, "ACTIVE");
+  writer.WriteString(1, value.c_str());
+  writer.Close();
+
+  hid_t file    = H5Fopen(filename.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
+  hid_t dataset = H5Dopen2(file, "/MC/string_table", H5P_DEFAULT);
+  hid_t memtype = createStringType();
+  std::vector<string_info_t> rows(2);
+  REQUIRE(H5Dread(dataset, memtype, H5S_ALL, H5S_ALL, H5P_DEFAULT,
+                  rows.data()) >= 0);
+  H5Tclose(memtype);
+  H5Dclose(dataset);
+  H5Fclose(file);
+
+  REQUIRE(std::string(rows[0].value) == "ACTIVE");
+  REQUIRE(rows[1].id == 1);
+  REQUIRE(std::string(rows[1].value) == value.substr(0, STRLEN - 1));
+
+  std::remove(filename.c_str());
+}
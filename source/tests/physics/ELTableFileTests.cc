@@ -0,0 +1,164 @@
+#include <ELTableFile.h>
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include <catch.hpp>
+using Catch::Matchers::Contains;
+
+
+namespace {
+
+  /// Write a text file with the given contents
+  void WriteText(const std::string& filename, const std::string& text)
+  {
+    std::ofstream file(filename);
+    file << text;
+  }
+
+  /// A small table in the text format, with three time bins and
+  /// the points out of order
+  const std::string TEXT_TABLE =
+    "* EL lookup table\n"
+    "* point_id sensor_id probabilities\n"
+    "3 1000 0.1 0.2 0.3\n"
+    "0 12 0.01 0.02 0.03\n"
+    "0 1001 0.5 0.25 0.125\n"
+    "\n"
+    "7 4 1e-6 0 2e-6\n";
+
+} // namespace
+
+
+
+TEST_CASE("ELTableFile text to binary round trip") {
+
+  // A table read from text, written in the binary format and mapped
+  // back must have the same grid, entries and probabilities
+
+  std::string text   = "ELTableFileTests.txt";
+  std::string binary = "ELTableFileTests.bin";
+  WriteText(text, TEXT_TABLE);
+
+  nexus::ELTableFile table;
+  REQUIRE(table.ReadText(text, 92.5, 5.));
+  REQUIRE(table.GetNumberOfEntries() == 4);
+  REQUIRE(table.GetNumberOfTimeBins() == 3);
+  REQUIRE(table.GetNumberOfPoints() == 8);
+  REQUIRE(table.Write(binary));
+
+  REQUIRE(nexus::ELTableFile::IsBinary(binary));
+  REQUIRE(!nexus::ELTableFile::IsBinary(text));
+
+  nexus::ELTableFile mapped;
+  REQUIRE(mapped.Map(binary));
+
+  REQUIRE(mapped.GetRadius()  == 92.5);
+  REQUIRE(mapped.GetBinning() == 5.);
+  REQUIRE(mapped.GetNumberOfGridPoints() == table.GetNumberOfGridPoints());
+  REQUIRE(mapped.GetNumberOfPoints()     == table.GetNumberOfPoints());
+  REQUIRE(mapped.GetNumberOfEntries()    == table.GetNumberOfEntries());
+  REQUIRE(mapped.GetNumberOfTimeBins()   == table.GetNumberOfTimeBins());
+
+  for (uint64_t p=0; p<=mapped.GetNumberOfPoints(); p++)
+    REQUIRE(mapped.GetOffsets()[p] == table.GetOffsets()[p]);
+
+  // The entries are sorted by point, in the order of the file
+  const int32_t expected_ids[] = {12, 1001, 1000, 4};
+  for (uint64_t e=0; e<mapped.GetNumberOfEntries(); e++)
+    REQUIRE(mapped.GetSensorIDs()[e] == expected_ids[e]);
+
+  REQUIRE(mapped.GetOffsets()[3] == 2);
+  REQUIRE(mapped.GetOffsets()[4] == 3);
+  REQUIRE(mapped.GetProbabilities()[3] == 0.5f);
+  REQUIRE(mapped.GetProbabilities()[5] == 0.125f);
+  REQUIRE(mapped.GetProbabilities()[11] == 2e-6f);
+
+  for (double x=-100.; x<=100.; x+=2.5)
+    for (double y=-100.; y<=100.; y+=2.5)
+      REQUIRE(mapped.FindPoint(x, y) == table.FindPoint(x, y));
+
+  std::remove(text.c_str());
+  std::remove(binary.c_str());
+}
+
+
+
+TEST_CASE("ELTableFile rejects corrupt binary files") {
+
+  std::string text   = "ELTableFileTests_corrupt.txt";
+  std::string binary = "ELTableFileTests_corrupt.bin";
+  WriteText(text, TEXT_TABLE);
+
+  nexus::ELTableFile table;
+  REQUIRE(table.ReadText(text, 92.5, 5.));
+  REQUIRE(table.Write(binary));
+
+  nexus::ELTableFile mapped;
+
+  SECTION("Truncated file") {
+    std::ifstream in(binary, std::ios::binary | std::ios::ate);
+    off_t size = in.tellg();
+    REQUIRE(truncate(binary.c_str(), size - 4) == 0);
+    REQUIRE(!mapped.Map(binary));
+    REQUIRE_THAT(mapped.Error(), Contains("truncated or corrupt"));
+  }
+
+  SECTION("Bin count not matching the contents") {
+    std::fstream file(binary, std::ios::binary | std::ios::in | std::ios::out);
+    nexus::ELTableFile::Header header;
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+    header.nbins_t = 5;
+    file.seekp(0);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.close();
+    REQUIRE(!mapped.Map(binary));
+    REQUIRE_THAT(mapped.Error(), Contains("truncated or corrupt"));
+  }
+
+  SECTION("Not a table") {
+    REQUIRE(!mapped.Map(text));
+    REQUIRE_THAT(mapped.Error(), Contains("is not an EL table"));
+  }
+
+  std::remove(text.c_str());
+  std::remove(binary.c_str());
+}
+
+
+
+TEST_CASE("ELTableFile rejects malformed text files") {
+
+  std::string text = "ELTableFileTests_malformed.txt";
+  nexus::ELTableFile table;
+
+  SECTION("Different number of time bins") {
+    WriteText(text, "* header\n0 1 0.1 0.2 0.3\n1 1 0.1 0.2\n");
+    REQUIRE(!table.ReadText(text, 92.5, 5.));
+    REQUIRE_THAT(table.Error(), Contains(":3: all the entries must have"));
+  }
+
+  SECTION("Malformed line") {
+    WriteText(text, "* header\n0 1 0.1 0.2 0.3\n1 1 0.1 O.2 0.3\n");
+    REQUIRE(!table.ReadText(text, 92.5, 5.));
+    REQUIRE_THAT(table.Error(), Contains(":3: malformed line"));
+  }
+
+  SECTION("Line without probabilities") {
+    WriteText(text, "* header\n0 1\n");
+    REQUIRE(!table.ReadText(text, 92.5, 5.));
+    REQUIRE_THAT(table.Error(), Contains(":2: malformed line"));
+  }
+
+  SECTION("Negative point id") {
+    WriteText(text, "* header\n-1 1 0.1\n");
+    REQUIRE(!table.ReadText(text, 92.5, 5.));
+    REQUIRE_THAT(table.Error(), Contains(":2: negative point id"));
+  }
+
+  std::remove(text.c_str());
+}
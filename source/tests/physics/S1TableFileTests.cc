@@ -0,0 +1,172 @@
+#include <S1TableFile.h>
+#include <S1TableBuilder.h>
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+
+#include <unistd.h>
+
+#include <catch.hpp>
+using Catch::Matchers::Contains;
+
+
+namespace {
+
+  const double   ORIGIN[3]  = {-10., -20., 0.};
+  const double   VOXEL[3]   = {  5.,  10., 2.};
+  const uint32_t NVOXELS[3] = {  4,    4,  3 };
+
+} // namespace
+
+
+
+TEST_CASE("S1TableFile voxels") {
+
+  nexus::S1TableFile table;
+
+  // No box of voxels yet
+  REQUIRE(table.FindVoxel(0., 0., 0.) == -1);
+
+  REQUIRE(table.Reset(ORIGIN, VOXEL, NVOXELS));
+  REQUIRE(table.GetNumberOfVoxels() == 48);
+
+  SECTION("Numbering, x first") {
+    REQUIRE(table.FindVoxel(-10.,  -20., 0.) ==  0);
+    REQUIRE(table.FindVoxel( -5.,  -20., 0.) ==  1);
+    REQUIRE(table.FindVoxel(-10.,  -10., 0.) ==  4);
+    REQUIRE(table.FindVoxel(-10.,  -20., 2.) == 16);
+    REQUIRE(table.FindVoxel( -2.5,   5., 3.) ==  1*1 + 2*4 + 1*16);
+  }
+
+  SECTION("Edges of the box") {
+    // The lower edges belong to the box, the upper ones do not
+    REQUIRE(table.FindVoxel(  9.999, 19.999, 5.999) == 47);
+    REQUIRE(table.FindVoxel( 10.,     0.,    1.)    == -1);
+    REQUIRE(table.FindVoxel(  0.,    20.,    1.)    == -1);
+    REQUIRE(table.FindVoxel(  0.,     0.,    6.)    == -1);
+    REQUIRE(table.FindVoxel(-10.001,  0.,    1.)    == -1);
+    REQUIRE(table.FindVoxel(  0.,   -20.001, 1.)    == -1);
+    REQUIRE(table.FindVoxel(  0.,     0.,   -0.001) == -1);
+  }
+
+  SECTION("Empty box") {
+    const uint32_t none[3] = {4, 0, 3};
+    REQUIRE(!table.Reset(ORIGIN, VOXEL, none));
+    REQUIRE(table.FindVoxel(0., 0., 0.) == -1);
+  }
+}
+
+
+
+TEST_CASE("S1TableFile write and map round trip") {
+
+  std::string filename = "S1TableFileTests.bin";
+
+  nexus::S1TableFile table;
+  REQUIRE(table.Reset(ORIGIN, VOXEL, NVOXELS));
+
+  // Entries are added in any order of voxels
+  REQUIRE(table.AddEntry(47, 3, 0.5f));
+  REQUIRE(table.AddEntry( 2, 1, 0.25f));
+  REQUIRE(table.AddEntry( 2, 7, 0.125f));
+  REQUIRE(table.AddEntry(16, 1, 1e-6f));
+  REQUIRE(!table.AddEntry(48, 1, 0.1f));
+  table.Finish();
+  REQUIRE(table.Write(filename));
+
+  nexus::S1TableFile mapped;
+
+  SECTION("Round trip") {
+    REQUIRE(mapped.Map(filename));
+    REQUIRE(mapped.GetNumberOfVoxels()  == 48);
+    REQUIRE(mapped.GetNumberOfEntries() == 4);
+
+    for (int64_t v=0; v<48; v++) {
+      REQUIRE(mapped.GetFirstEntry(v) == table.GetFirstEntry(v));
+      REQUIRE(mapped.GetLastEntry(v)  == table.GetLastEntry(v));
+    }
+
+    REQUIRE(mapped.GetLastEntry(2) - mapped.GetFirstEntry(2) == 2);
+    uint64_t e = mapped.GetFirstEntry(2);
+    REQUIRE(mapped.GetSensorID(e)      == 1);
+    REQUIRE(mapped.GetProbability(e)   == 0.25f);
+    REQUIRE(mapped.GetSensorID(e+1)    == 7);
+    REQUIRE(mapped.GetProbability(e+1) == 0.125f);
+    REQUIRE(mapped.GetProbability(mapped.GetFirstEntry(47)) == 0.5f);
+    REQUIRE(mapped.GetProbability(mapped.GetFirstEntry(16)) == 1e-6f);
+
+    // Voxels out of the box have no entries
+    REQUIRE(mapped.GetFirstEntry(-1) == mapped.GetLastEntry(-1));
+    REQUIRE(mapped.GetFirstEntry(48) == mapped.GetLastEntry(48));
+
+    for (double x=-12.; x<12.; x+=1.5)
+      for (double y=-22.; y<22.; y+=2.5)
+        for (double z=-1.; z<7.; z+=0.5)
+          REQUIRE(mapped.FindVoxel(x, y, z) == table.FindVoxel(x, y, z));
+  }
+
+  SECTION("Truncated file") {
+    std::ifstream in(filename, std::ios::binary | std::ios::ate);
+    off_t size = in.tellg();
+    REQUIRE(truncate(filename.c_str(), size - 4) == 0);
+    REQUIRE(!mapped.Map(filename));
+    REQUIRE_THAT(mapped.Error(), Contains("truncated or corrupt"));
+  }
+
+  std::remove(filename.c_str());
+}
+
+
+
+TEST_CASE("S1TableBuilder probabilities") {
+
+  // The probability of a sensor for a voxel is its charge over
+  // the photons generated in the voxel by all its events
+
+  nexus::S1TableFile table;
+  REQUIRE(table.Reset(ORIGIN, VOXEL, NVOXELS));
+
+  nexus::S1TableBuilder builder(table.GetNumberOfVoxels());
+  const double photons = 1000.;
+
+  builder.AddEvent(0);
+  builder.AddCharge(0, 5, 100.);
+  builder.AddEvent(0);
+  builder.AddCharge(0, 5, 300.);
+  builder.AddCharge(0, 6,  20.);
+
+  builder.AddEvent(3);
+  builder.AddCharge(3, 5, 50.);
+
+  // Events out of the box are not counted
+  builder.AddEvent(-1);
+  builder.AddCharge(-1, 5, 1000.);
+
+  REQUIRE(builder.EmptyVoxels() == 46);
+
+  SECTION("Normalization") {
+    REQUIRE(builder.Fill(table, photons));
+    REQUIRE(table.GetNumberOfEntries() == 3);
+
+    uint64_t e = table.GetFirstEntry(0);
+    REQUIRE(table.GetSensorID(e)      == 5);
+    REQUIRE(table.GetProbability(e)   == Approx(400. / (photons * 2)));
+    REQUIRE(table.GetSensorID(e+1)    == 6);
+    REQUIRE(table.GetProbability(e+1) == Approx( 20. / (photons * 2)));
+
+    e = table.GetFirstEntry(3);
+    REQUIRE(table.GetSensorID(e)      == 5);
+    REQUIRE(table.GetProbability(e)   == Approx( 50. / photons));
+  }
+
+  SECTION("Charge without events") {
+    builder.AddCharge(7, 5, 10.);
+    REQUIRE(!builder.Fill(table, photons));
+    REQUIRE_THAT(builder.Error(), Contains("voxel 7 has charge but no events"));
+  }
+
+  SECTION("No photons") {
+    REQUIRE(!builder.Fill(table, 0.));
+  }
+}
@@ -0,0 +1,101 @@
+#include <PmtHit.h>
+
+#include <cmath>
+#include <map>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include <catch.hpp>
+
+
+namespace {
+
+  typedef std::vector<std::pair<unsigned int, unsigned int> > Histogram;
+
+  /// Fill a hit and a map of (time bin, counts) with the same photons,
+  /// and check that the histogram of the hit is that of the map
+  void CheckHistogram(const std::vector<double>& times, double bin_size)
+  {
+    nexus::PmtHit hit(0, G4ThreeVector(), bin_size);
+    std::map<long, unsigned int> reference;
+
+    for (size_t i=0; i<times.size(); i++) {
+      G4int counts = 1 + i % 3;
+      hit.Fill(times[i], counts);
+      reference[(long) std::floor(times[i] / bin_size)] += counts;
+    }
+
+    Histogram expected;
+    std::map<long, unsigned int>::const_iterator it;
+    for (it = reference.begin(); it != reference.end(); ++it)
+      expected.push_back(std::make_pair((unsigned int) it->first, it->second));
+
+    Histogram bins;
+    hit.GetHistogram(bins);
+    REQUIRE(bins == expected);
+
+    // Copies have the same histogram
+    nexus::PmtHit copy(hit);
+    copy.GetHistogram(bins);
+    REQUIRE(bins == expected);
+  }
+
+} // namespace
+
+
+
+TEST_CASE("PmtHit histogram") {
+
+  // However they are filled, the bins with counts of a PmtHit,
+  // dense or kept apart, must be those of a plain map
+
+  std::vector<double> times;
+  const double bin_size = 25.;
+
+  SECTION("Empty") {
+    CheckHistogram(times, bin_size);
+  }
+
+  SECTION("Random times") {
+    std::mt19937 gen(1234);
+    std::uniform_real_distribution<double> signal(1.e5, 2.e5);
+    std::uniform_real_distribution<double> anytime(0., 1.e9);
+    for (int i=0; i<20000; i++)
+      times.push_back(i % 50 ? signal(gen) : anytime(gen));
+    CheckHistogram(times, bin_size);
+    CheckHistogram(times, 1.);
+  }
+
+  SECTION("An early photon") {
+    times.push_back(0.);
+    for (int i=0; i<5000; i++)
+      times.push_back(1.e6 + 10. * i);
+    CheckHistogram(times, bin_size);
+  }
+
+  SECTION("A very late stray photon") {
+    for (int i=0; i<5000; i++)
+      times.push_back(1.e5 + 10. * i);
+    times.push_back(1.e10);
+    for (int i=0; i<5000; i++)
+      times.push_back(1.e5 + 10. * i + 5.);
+    CheckHistogram(times, bin_size);
+  }
+
+  SECTION("Filling backwards in time") {
+    for (int i=20000; i>=0; i--)
+      times.push_back(7. * i);
+    CheckHistogram(times, bin_size);
+  }
+
+  SECTION("Sparse bins filled backwards") {
+    // Bins far apart from each other, so that they cannot
+    // all be kept dense, and then the bins in between
+    for (int i=1000; i>=0; i--)
+      times.push_back(bin_size * 100 * i);
+    for (int i=0; i<100000; i+=7)
+      times.push_back(bin_size * i);
+    CheckHistogram(times, bin_size);
+  }
+}
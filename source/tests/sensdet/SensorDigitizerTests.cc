@@ -0,0 +1,153 @@
+#include <SensorDigitizer.h>
+
+#include <G4UImanager.hh>
+
+#include <cmath>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <catch.hpp>
+
+
+namespace {
+
+  typedef std::vector<std::pair<unsigned int, unsigned int> > Histogram;
+
+  /// Apply a command of the digitizer
+  void Apply(const std::string& command)
+  {
+    std::string path = "/nexus/digitization/" + command;
+    REQUIRE(G4UImanager::GetUIpointer()->ApplyCommand(path) == 0);
+  }
+
+} // namespace
+
+
+
+TEST_CASE("SensorDigitizer pulse integration and threshold") {
+
+  // Without gain spread, noise and dark counts the digitization is
+  // deterministic: every photoelectron gives gain ADC counts, spread
+  // over the samples as the integral of the single-pe response
+
+  nexus::SensorDigitizer digitizer;
+
+  Apply("sensor PmtSD");
+  Apply("gain all 10");
+  Apply("baseline all 100");
+
+  REQUIRE( digitizer.IsEnabled());
+  REQUIRE( digitizer.IsEnabled("PmtSD"));
+  REQUIRE(!digitizer.IsEnabled("SiPMSD"));
+
+  Histogram bins, samples;
+  const double bin_size = 25.;
+
+  SECTION("All the charge in one sample") {
+    bins = {{2, 3}, {4, 1}};
+    digitizer.Digitize("PmtSD", bins, bin_size, samples);
+
+    // Without a readout window, only the samples of the pulses
+    REQUIRE(samples.size() == 2);
+    REQUIRE(samples[0] == std::make_pair(2u, 130u));
+    REQUIRE(samples[1] == std::make_pair(4u, 110u));
+
+    Apply("window all 125 ns");
+    digitizer.Digitize("PmtSD", bins, bin_size, samples);
+
+    const unsigned int adc[] = {100, 100, 130, 100, 110};
+    REQUIRE(samples.size() == 5);
+    for (unsigned int i=0; i<samples.size(); i++) {
+      REQUIRE(samples[i].first  == i);
+      REQUIRE(samples[i].second == adc[i]);
+    }
+  }
+
+  SECTION("A late stray photon") {
+    Apply("spe_decay_time all 10 ns");
+    Apply("sampling_period all 10 ns");
+
+    // The baseline between the pulses is not digitized
+    bins = {{0, 100}, {1000000, 1}};
+    digitizer.Digitize("PmtSD", bins, 10., samples);
+    REQUIRE(samples.size() == 22);
+    REQUIRE(samples[10].first == 10);
+    REQUIRE(samples[11].first == 1000000);
+    REQUIRE(samples[21].first == 1000010);
+  }
+
+  SECTION("Exponential decay") {
+    Apply("spe_decay_time all 10 ns");
+    Apply("sampling_period all 10 ns");
+    Apply("gain all 1");
+    Apply("baseline all 0");
+
+    // 100 photoelectrons at the centre of the first 10-ns bin, until
+    // 10 decay times after the end of the bin
+    bins = {{0, 100}};
+    digitizer.Digitize("PmtSD", bins, 10., samples);
+    REQUIRE(samples.size() == 11);
+
+    double total = 0.;
+    for (unsigned int i=0; i<samples.size(); i++) {
+      double start = std::max(i * 10. - 5., 0.);
+      double end   = i * 10. + 5.;
+      double charge = 100. * (std::exp(-start/10.) - std::exp(-end/10.));
+      REQUIRE((long) samples[i].second == std::lround(charge));
+      total += samples[i].second;
+    }
+    REQUIRE(total == Approx(100.).margin(samples.size() / 2.));
+  }
+
+  SECTION("Equal rise and decay times") {
+    Apply("spe_rise_time all 10 ns");
+    Apply("spe_decay_time all 10 ns");
+    Apply("sampling_period all 10 ns");
+    Apply("gain all 1");
+    Apply("baseline all 0");
+
+    bins = {{0, 1000}};
+    digitizer.Digitize("PmtSD", bins, 10., samples);
+
+    // Integral 1 - (1 + t/tau) exp(-t/tau) of the response
+    double previous = 0.;
+    for (unsigned int i=0; i<samples.size(); i++) {
+      double t = i * 10. + 5.;
+      double integral = 1. - (1. + t/10.) * std::exp(-t/10.);
+      REQUIRE((long) samples[i].second == std::lround(1000. * (integral - previous)));
+      previous = integral;
+    }
+  }
+
+  SECTION("Readout window and saturation") {
+    Apply("window all 50 ns");
+    bins = {{0, 10000}, {3, 1}};
+    digitizer.Digitize("PmtSD", bins, bin_size, samples);
+
+    // Two samples of 25 ns, the second pulse is out of the window
+    REQUIRE(samples.size() == 2);
+    REQUIRE(samples[0].second == 65535);
+    REQUIRE(samples[1].second == 100);
+  }
+
+  SECTION("Zero-suppression threshold") {
+    bins = {{2, 3}, {4, 1}};
+
+    Apply("threshold all 10");
+    digitizer.Digitize("PmtSD", bins, bin_size, samples);
+    REQUIRE(samples.size() == 2);
+    REQUIRE(samples[0] == std::make_pair(2u, 130u));
+    REQUIRE(samples[1] == std::make_pair(4u, 110u));
+
+    Apply("threshold all 11");
+    digitizer.Digitize("PmtSD", bins, bin_size, samples);
+    REQUIRE(samples.size() == 1);
+    REQUIRE(samples[0] == std::make_pair(2u, 130u));
+  }
+
+  SECTION("No photons") {
+    digitizer.Digitize("PmtSD", bins, bin_size, samples);
+    REQUIRE(samples.empty());
+  }
+}
@@ -5,6 +5,7 @@
 #include <catch.hpp>
 #include <iostream>
 #include <cmath>
+#include <vector>
 using namespace std;
 
 TEST_CASE("Direction Function") {
@@ -41,3 +42,36 @@ TEST_CASE("Direction Function") {
   }
 
 }
+
+
+
+TEST_CASE("Event seeds") {
+
+  // This test checks that the random numbers of an event depend only
+  // on the run seed and the event number, and not on the numbers drawn
+  // before the engine is reseeded.
+
+  long seeds[3];
+
+  nexus::EventSeeds(12345, 42, seeds);
+  CLHEP::HepRandom::setTheSeeds(seeds);
+  std::vector<G4double> first;
+  for (G4int i=0; i<10; i++) first.push_back(G4UniformRand());
+
+  for (G4int i=0; i<1000; i++) G4UniformRand();
+
+  nexus::EventSeeds(12345, 42, seeds);
+  CLHEP::HepRandom::setTheSeeds(seeds);
+  for (G4int i=0; i<10; i++) REQUIRE(G4UniformRand() == first[i]);
+
+  REQUIRE(seeds[0] > 0);
+  REQUIRE(seeds[1] > 0);
+  REQUIRE(seeds[2] == 0);
+
+  // Neighbouring events and runs get different seeds
+  long other[3];
+  nexus::EventSeeds(12345, 43, other);
+  REQUIRE(other[0] != seeds[0]);
+  nexus::EventSeeds(12346, 42, other);
+  REQUIRE(other[0] != seeds[0]);
+}
@@ -10,6 +10,7 @@
 #include <Randomize.hh>
 #include <G4ThreeVector.hh>
 #include "CLHEP/Units/SystemOfUnits.h"
+#include <cstdint>
 
 
 #ifndef RAND_U_H
@@ -42,6 +43,33 @@ namespace nexus {
      }
     }
 
+
+  /// Mixing function of the splitmix64 generator: consecutive inputs
+  /// give statistically independent outputs
+  inline uint64_t SplitMix64(uint64_t x)
+  {
+    x += 0x9E3779B97F4A7C15ULL;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+  }
+
+  /// Seeds of the random engine for an event, derived only from the
+  /// seed of the run and the absolute number of the event. They are
+  /// positive 31-bit values, as taken by every CLHEP engine, and the
+  /// array is terminated by a zero, as expected by setTheSeeds().
+  inline void EventSeeds(long run_seed, long event_number, long seeds[3])
+  {
+    uint64_t state = SplitMix64(SplitMix64((uint64_t) run_seed) ^
+                                (uint64_t) event_number);
+    for (int i=0; i<2; i++) {
+      state = SplitMix64(state);
+      seeds[i] = (long) (state & 0x7FFFFFFF);
+      if (seeds[i] == 0) seeds[i] = 1;
+    }
+    seeds[2] = 0;
+  }
+
 }  // end namespace nexus
 
 #endif
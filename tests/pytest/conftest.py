@@ -1,6 +1,29 @@
 import pytest
 import os
 
+import numpy  as np
+import pandas as pd
+
+
+def check_event_index_row_ranges(filename, tables):
+    """
+    Check that the row ranges of the event index select exactly
+    the rows of each event in the given event tables.
+    """
+    index = pd.read_hdf(filename, 'MC/event_index')
+
+    for table in tables:
+        rows = pd.read_hdf(filename, 'MC/' + table)
+
+        first = index[table + '_first'].values
+        last  = index[table + '_last' ].values
+        assert np.all(first[1:] == last[:-1])
+        assert last[-1] == len(rows)
+
+        for evt, f, l in zip(index.event_id.values, first, last):
+            assert np.all(rows.event_id.values[f:l] == evt)
+
+
 @pytest.fixture(scope = 'session')
 def NEXUSDIR():
     return os.environ['NEXUSDIR']
@@ -0,0 +1,171 @@
+import pytest
+
+import os
+import subprocess
+
+import numpy  as np
+import pandas as pd
+import tables as tb
+
+from conftest import check_event_index_row_ranges
+
+
+# Layout of the tables of nexus files written with string ids
+# (see source/persistency/hdf5_functions.cc)
+config_dtype = np.dtype([('param_key', 'S300'), ('param_value', 'S300')])
+
+string_dtype = np.dtype([('id', '<i4'), ('value', 'S100')])
+
+hit_dtype = np.dtype([('event_id', '<i4'), ('x', '<f4'), ('y', '<f4'), ('z', '<f4'),
+                      ('time', '<f4'), ('energy', '<f4'), ('label', '<i4'),
+                      ('particle_id', '<i4'), ('hit_id', '<i4')])
+
+particle_dtype = np.dtype([('event_id', '<i4'), ('particle_id', '<i4'),
+                           ('particle_name', '<i4'), ('primary', 'i1'),
+                           ('mother_id', '<i4'), ('initial_volume', '<i4'),
+                           ('final_volume', '<i4'), ('creator_proc', '<i4'),
+                           ('final_proc', '<i4')])
+
+sns_response_dtype = np.dtype([('event_id', '<i4'), ('sensor_id', '<u4'),
+                               ('time_bin', '<u8'), ('charge', '<u4')])
+
+sns_pos_dtype = np.dtype([('sensor_id', '<u4'), ('sensor_name', '<i4'),
+                          ('x', '<f4'), ('y', '<f4'), ('z', '<f4')])
+
+event_index_dtype = np.dtype([('event_id', '<i4'),
+                              ('hits_first', '<u8'), ('hits_last', '<u8'),
+                              ('particles_first', '<u8'), ('particles_last', '<u8'),
+                              ('sns_response_first', '<u8'), ('sns_response_last', '<u8')])
+
+
+def write_nexus_file(filename, strings, events, sensors, num_events, seed):
+    """
+    Write a small nexus file with string ids. The strings are given in
+    the order of their ids in the file; events are lists of (number of
+    hits, number of particles, number of sensor samples) and sensors
+    are (sensor id, name) pairs.
+    """
+    ids = {value: i for i, value in enumerate(strings)}
+
+    config = [('/Geometry/NextDemo/config', 'run7'),
+              ('/nexus/random_seed'       , str(seed)),
+              ('num_events'               , str(num_events)),
+              ('saved_events'             , str(len(events))),
+              ('interacting_events'       , str(len(events)))]
+
+    hits, particles, samples, index = [], [], [], []
+    for evt, (nhits, nparticles, nsamples) in enumerate(events):
+        first = (len(hits), len(particles), len(samples))
+        for i in range(nhits):
+            hits.append((evt, 0, 0, i, 0, 1, ids['ACTIVE'], 1, i))
+        for i in range(nparticles):
+            particles.append((evt, i+1, ids['e-'], i == 0, 0,
+                              ids['ACTIVE'], ids['ACTIVE'], ids['none'], ids['eIoni']))
+        for i in range(nsamples):
+            samples.append((evt, sensors[i % len(sensors)][0], i, 1))
+        index.append((evt, first[0], len(hits), first[1], len(particles),
+                      first[2], len(samples)))
+
+    positions = [(sensor_id, ids[name], sensor_id, 0, 0) for sensor_id, name in sensors]
+
+    with tb.open_file(filename, 'w') as h5out:
+        group = h5out.create_group('/', 'MC')
+        h5out.create_table(group, 'configuration', obj=np.array(config   , dtype=config_dtype))
+        h5out.create_table(group, 'string_table' , obj=np.array(list(enumerate(strings)),
+                                                                dtype=string_dtype))
+        h5out.create_table(group, 'hits'         , obj=np.array(hits     , dtype=hit_dtype))
+        h5out.create_table(group, 'particles'    , obj=np.array(particles, dtype=particle_dtype))
+        h5out.create_table(group, 'sns_response' , obj=np.array(samples  , dtype=sns_response_dtype))
+        h5out.create_table(group, 'sns_positions', obj=np.array(positions, dtype=sns_pos_dtype))
+        h5out.create_table(group, 'event_index'  , obj=np.array(index    , dtype=event_index_dtype))
+
+
+def decoded(filename, table, column):
+    """Strings of a column of a table written with string ids."""
+    strings = pd.read_hdf(filename, 'MC/string_table').set_index('id').value
+    ids     = pd.read_hdf(filename, 'MC/' + table)[column].values
+    return [strings[i] for i in ids]
+
+
+@pytest.fixture(scope = 'module')
+def merged_file(output_tmpdir, NEXUSDIR):
+    # The same strings get different ids in each file, and the
+    # second file has a string and a sensor the first one has not
+    first  = os.path.join(output_tmpdir, 'merge_input_0.h5')
+    second = os.path.join(output_tmpdir, 'merge_input_1.h5')
+    merged = os.path.join(output_tmpdir, 'merge_output.h5')
+
+    write_nexus_file(first,
+                     ['ACTIVE', 'e-', 'none', 'eIoni', 'PmtR11410'],
+                     [(3, 1, 2), (1, 2, 0)],
+                     [(0, 'PmtR11410'), (1, 'PmtR11410')],
+                     num_events = 2, seed = 1)
+
+    write_nexus_file(second,
+                     ['e-', 'SiPM', 'PmtR11410', 'none', 'ACTIVE', 'eIoni'],
+                     [(2, 1, 3), (0, 1, 1), (4, 3, 2)],
+                     [(0, 'PmtR11410'), (1, 'PmtR11410'), (1040, 'SiPM')],
+                     num_events = 5, seed = 2)
+
+    nexus_merge = NEXUSDIR + '/bin/nexus-merge'
+    command     = [nexus_merge, '-r', '-o', merged, first, second]
+    subprocess.run(command, check=True, env=os.environ)
+
+    return merged, first, second
+
+
+def test_merge_event_index(merged_file):
+    """
+    Check that the event ids are re-based and the row ranges of the
+    event index point to the rows of each event in the merged tables.
+    """
+    merged, _, _ = merged_file
+
+    index = pd.read_hdf(merged, 'MC/event_index')
+    assert np.all(index.event_id.values == np.arange(5))
+
+    check_event_index_row_ranges(merged, ['hits', 'particles', 'sns_response'])
+
+
+def test_merge_string_ids(merged_file):
+    """
+    Check that every string is stored once in the merged string table
+    and the string ids of the rows are translated to it.
+    """
+    merged, first, second = merged_file
+
+    strings = pd.read_hdf(merged, 'MC/string_table')
+    assert len(strings.value.unique()) == len(strings)
+    assert np.all(strings.id.values == np.arange(len(strings)))
+
+    columns = {'hits'     : ['label'],
+               'particles': ['particle_name', 'initial_volume', 'final_volume',
+                             'creator_proc', 'final_proc']}
+    for table in columns:
+        for column in columns[table]:
+            expected = decoded(first, table, column) + decoded(second, table, column)
+            assert decoded(merged, table, column) == expected
+
+
+def test_merge_sensor_positions(merged_file):
+    """Check that every sensor position is written once."""
+    merged, _, _ = merged_file
+
+    positions = pd.read_hdf(merged, 'MC/sns_positions')
+    assert np.all(positions.sensor_id.values == [0, 1, 1040])
+    assert decoded(merged, 'sns_positions', 'sensor_name') == ['PmtR11410', 'PmtR11410', 'SiPM']
+
+
+def test_merge_configuration(merged_file):
+    """
+    Check that the event counters are summed up and the
+    rest of the configuration is that of the first file.
+    """
+    merged, _, _ = merged_file
+
+    conf = pd.read_hdf(merged, 'MC/configuration').set_index('param_key')
+    assert int(conf.param_value['num_events'        ]) == 7
+    assert int(conf.param_value['saved_events'      ]) == 5
+    assert int(conf.param_value['interacting_events']) == 5
+    assert conf.param_value['/nexus/random_seed'       ] == '1'
+    assert conf.param_value['/Geometry/NextDemo/config'] == 'run7'
@@ -2,6 +2,8 @@ import pandas as pd
 import tables as tb
 import numpy as np
 
+from conftest import check_event_index_row_ranges
+
 
 def test_hdf5_structure(detectors):
     """Check that the hdf5 table structure is the correct one."""
@@ -143,3 +145,14 @@ def test_sensor_names_are_the_same_across_tables(detectors):
 
     for p in sns_bin_conf:
         assert p[:-8] in pos_labels
+
+
+
+def test_event_index_row_ranges(detectors):
+    """
+    Check that the row ranges of the event index select exactly
+    the rows of each event in the event tables.
+    """
+    filename, _, _, _, _ = detectors
+
+    check_event_index_row_ranges(filename, ['hits', 'particles', 'sns_response'])
@@ -0,0 +1,83 @@
+import pytest
+
+import os
+import glob
+import subprocess
+
+import numpy  as np
+import pandas as pd
+
+from conftest import check_event_index_row_ranges
+
+
+def test_rollover_merge_output(config_tmpdir, output_tmpdir, NEXUSDIR):
+    """
+    Roll the output of a run over into several files and check that,
+    once merged, the event counters are those of the whole run.
+    """
+    base_name = 'DEMOPP_rollover'
+
+    init_text = f"""
+/PhysicsList/RegisterPhysics G4EmStandardPhysics_option4
+/PhysicsList/RegisterPhysics G4DecayPhysics
+/PhysicsList/RegisterPhysics G4RadioactiveDecayPhysics
+/PhysicsList/RegisterPhysics NexusPhysics
+/PhysicsList/RegisterPhysics G4StepLimiterPhysics
+
+/Geometry/RegisterGeometry NEXT_DEMO
+
+/Generator/RegisterGenerator SINGLE_PARTICLE
+
+/Actions/RegisterTrackingAction DEFAULT
+/Actions/RegisterEventAction DEFAULT
+/Actions/RegisterRunAction DEFAULT
+
+/nexus/RegisterMacro {config_tmpdir}/{base_name}.config.mac
+"""
+    init_path = os.path.join(config_tmpdir, base_name+'.init.mac')
+    with open(init_path, 'w') as init_file:
+        init_file.write(init_text)
+
+    config_text = f"""
+/Geometry/NextDemo/config run7
+/Geometry/NextDemo/max_step_size 1. mm
+/Geometry/NextDemo/pressure 10. bar
+
+/Generator/SingleParticle/particle e-
+/Generator/SingleParticle/min_energy 100. keV
+/Generator/SingleParticle/max_energy 100. keV
+/Generator/SingleParticle/region ACTIVE
+
+/nexus/persistency/max_events_per_file 2
+/nexus/persistency/outputFile {output_tmpdir}/{base_name}
+/nexus/random_seed 21051817
+"""
+    config_path = os.path.join(config_tmpdir, base_name+'.config.mac')
+    with open(config_path, 'w') as config_file:
+        config_file.write(config_text)
+
+    nevents   = 5
+    nexus_exe = NEXUSDIR + '/bin/nexus'
+    command   = [nexus_exe, '-b', '-n', str(nevents), init_path]
+    subprocess.run(command, check=True, env=os.environ)
+
+    parts = sorted(glob.glob(os.path.join(output_tmpdir, base_name + '_*.h5')))
+    assert len(parts) == 3
+
+    # Every file counts its own events
+    for part in parts:
+        conf = pd.read_hdf(part, 'MC/configuration').set_index('param_key')
+        assert int(conf.param_value['num_events']) <= 2
+
+    merged = os.path.join(output_tmpdir, base_name + '.h5')
+    nexus_merge = NEXUSDIR + '/bin/nexus-merge'
+    subprocess.run([nexus_merge, '-o', merged] + parts, check=True, env=os.environ)
+
+    conf = pd.read_hdf(merged, 'MC/configuration').set_index('param_key')
+    assert int(conf.param_value['num_events'  ]) == nevents
+    assert int(conf.param_value['saved_events']) == nevents
+
+    index = pd.read_hdf(merged, 'MC/event_index')
+    assert np.all(index.event_id.values == np.arange(nevents))
+
+    check_event_index_row_ranges(merged, ['hits', 'particles'])